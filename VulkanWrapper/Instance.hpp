@@ -51,22 +51,29 @@ class Instance {
 private:
   VkInstance m_Instance{nullptr};
   VkDebugUtilsMessengerEXT m_Debugger{VK_NULL_HANDLE};
+  // 无窗口模式不需要glfw的surface扩展，CI机器上没有验证层时也照常运行
+  bool m_Headless{false};
+  bool m_ValidationEnabled{true};
 
 public:
   using Ptr = std::shared_ptr<Instance>;
-  static Ptr Create() { return std::make_shared<Instance>(); }
-  Instance();
+  static Ptr Create(bool headless = false) {
+    return std::make_shared<Instance>(headless);
+  }
+  Instance(bool headless = false);
 
   ~Instance();
   [[nodiscard]] auto GetInstance() const { return m_Instance; }
+  [[nodiscard]] auto IsHeadless() const { return m_Headless; }
   bool CheckValidationLayerSupport();
   std::vector<const char *> GetRequiredExtensions();
   void PrintAvailableExtensions();
   void SetupDebugger();
 };
 
-inline Instance::Instance() {
-  if (!CheckValidationLayerSupport()) {
+inline Instance::Instance(bool headless) : m_Headless(headless) {
+  m_ValidationEnabled = CheckValidationLayerSupport();
+  if (!m_ValidationEnabled && !m_Headless) {
     throw std::runtime_error("Error: validation layer is not supported");
   }
 
@@ -79,7 +86,8 @@ inline Instance::Instance() {
   app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   app_info.pEngineName = "No ENGINE";
   app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  app_info.apiVersion = VK_API_VERSION_1_0;
+  // descriptor update template 需要1.1，descriptor indexing(bindless)需要1.2
+  app_info.apiVersion = VK_API_VERSION_1_2;
 
   VkInstanceCreateInfo create_info{};
 
@@ -88,17 +96,23 @@ inline Instance::Instance() {
   create_info.ppEnabledExtensionNames = extensions.data();
   create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
   create_info.pApplicationInfo = &app_info;
-  create_info.enabledLayerCount =
-      static_cast<uint32_t>(validationLayers.size());
-  create_info.ppEnabledLayerNames = validationLayers.data();
+  if (m_ValidationEnabled) {
+    create_info.enabledLayerCount =
+        static_cast<uint32_t>(validationLayers.size());
+    create_info.ppEnabledLayerNames = validationLayers.data();
+  }
 
   if (vkCreateInstance(&create_info, nullptr, &m_Instance) != VK_SUCCESS) {
     throw std::runtime_error("create Instance failed");
   }
-  SetupDebugger();
+  if (m_ValidationEnabled) {
+    SetupDebugger();
+  }
 }
 Instance::~Instance() {
-  DestroyDebugUtilsMessengerEXT(m_Instance, m_Debugger, nullptr);
+  if (m_Debugger != VK_NULL_HANDLE) {
+    DestroyDebugUtilsMessengerEXT(m_Instance, m_Debugger, nullptr);
+  }
 
  
   vkDestroyInstance(m_Instance, nullptr);
@@ -152,15 +166,19 @@ void Instance::SetupDebugger() {
 }
 
 std::vector<const char *> Instance::GetRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
+  std::vector<const char *> extensions{};
+  if (!m_Headless) {
+    uint32_t glfwExtensionCount = 0;
 
-  const char **glfwExtensions =
-      glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char **glfwExtensions =
+        glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-  std::vector<const char *> extensions(glfwExtensions,
-                                       glfwExtensions + glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
-  extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  if (m_ValidationEnabled) {
+    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  }
 
   return extensions;
 }
@@ -11,16 +11,29 @@ private:
   VkDeviceMemory mBufferMemory{VK_NULL_HANDLE};
   Device::Ptr mDevice{nullptr};
   VkDescriptorBufferInfo m_BufferInfo{};
+  VkDeviceSize mSize{0};
+  // 持久映射的地址，Map之后一直有效直到Unmap或析构
+  void *mMappedData{nullptr};
+  // 实际分配到的内存类型，非coherent时cpu读之前要Invalidate
+  VkMemoryPropertyFlags mMemoryProperties{0};
+  // 显存统计用，实际分配的大小可能比mSize大
+  MemoryCategory mCategory{MemoryCategory::Buffer};
+  uint32_t mMemoryTypeIndex{0};
+  VkDeviceSize mAllocationSize{0};
 
 public:
   using Ptr = std::shared_ptr<Buffer>;
+  // preferred不可用时只用properties，category在分配时就记到对应的统计里
   static Ptr Create(const Device::Ptr &device, VkDeviceSize size,
-                    VkBufferUsageFlags usage,
-                    VkMemoryPropertyFlags properties) {
-    return std::make_shared<Buffer>(device, size, usage, properties);
+                    VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                    VkMemoryPropertyFlags preferred = 0,
+                    MemoryCategory category = MemoryCategory::Buffer) {
+    return std::make_shared<Buffer>(device, size, usage, properties, preferred,
+                                    category);
   }
   Buffer(const Device::Ptr &device, VkDeviceSize size, VkBufferUsageFlags usage,
-         VkMemoryPropertyFlags properties);
+         VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred = 0,
+         MemoryCategory category = MemoryCategory::Buffer);
 
   ~Buffer();
 
@@ -33,9 +46,19 @@ public:
                                  void *pData = nullptr);
   static Ptr CreateStageBuffer(const Device::Ptr &device, VkDeviceSize size,
                                void *pData = nullptr);
+  // gpu写cpu读，优先HOST_CACHED，cpu逐字节读uncached内存非常慢
+  static Ptr CreateReadbackBuffer(const Device::Ptr &device,
+                                  VkDeviceSize size);
 
   void UpdateBufferByMap(void *data, size_t size);
 
+  void *Map();
+
+  void Unmap();
+
+  // 让gpu写入的内容对cpu可见，coherent内存什么都不做
+  void Invalidate();
+
   void UpdateBufferByStage(void *data, size_t size);
 
   void CopyBuffer(const VkBuffer &srcBuffer, const VkBuffer &dstBuffer,
@@ -43,15 +66,24 @@ public:
 
   [[nodiscard]] auto getBuffer() const { return mBuffer; }
   [[nodiscard]] auto &GetBufferInfo() { return m_BufferInfo; }
+  [[nodiscard]] auto GetSize() const { return mSize; }
+  [[nodiscard]] auto GetMappedData() const { return mMappedData; }
+  [[nodiscard]] auto GetMemoryProperties() const { return mMemoryProperties; }
+  [[nodiscard]] auto GetCategory() const { return mCategory; }
 
 private:
+  bool tryFindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties,
+                         uint32_t &typeIndex);
   uint32_t findMemoryType(uint32_t typeFilter,
                           VkMemoryPropertyFlags properties);
 };
 
 Buffer::Buffer(const Device::Ptr &device, VkDeviceSize size,
-               VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+               VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+               VkMemoryPropertyFlags preferred, MemoryCategory category) {
   mDevice = device;
+  mSize = size;
+  mCategory = category;
 
   VkBufferCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -71,12 +103,25 @@ Buffer::Buffer(const Device::Ptr &device, VkDeviceSize size,
   allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
   allocInfo.allocationSize = memReq.size;
   // memoryTypeBits里存放了所有可用的memoryType
-  allocInfo.memoryTypeIndex = findMemoryType(memReq.memoryTypeBits, properties);
+  if (preferred == 0 ||
+      !tryFindMemoryType(memReq.memoryTypeBits, properties | preferred,
+                         allocInfo.memoryTypeIndex)) {
+    allocInfo.memoryTypeIndex =
+        findMemoryType(memReq.memoryTypeBits, properties);
+  }
+  VkPhysicalDeviceMemoryProperties memProps;
+  vkGetPhysicalDeviceMemoryProperties(mDevice->GetPhysicalDevice(), &memProps);
+  mMemoryProperties =
+      memProps.memoryTypes[allocInfo.memoryTypeIndex].propertyFlags;
 
   if (vkAllocateMemory(mDevice->GetDevice(), &allocInfo, nullptr,
                        &mBufferMemory) != VK_SUCCESS) {
     throw std::runtime_error("Error: failed to allocate memory");
   }
+  mMemoryTypeIndex = allocInfo.memoryTypeIndex;
+  mAllocationSize = allocInfo.allocationSize;
+  mDevice->GetMemoryTracker()->Allocate(mCategory, mMemoryTypeIndex,
+                                        mAllocationSize);
 
   vkBindBufferMemory(mDevice->GetDevice(), mBuffer, mBufferMemory, 0);
   m_BufferInfo.buffer = mBuffer;
@@ -84,16 +129,22 @@ Buffer::Buffer(const Device::Ptr &device, VkDeviceSize size,
   m_BufferInfo.range = size;
 }
 Buffer::~Buffer() {
+  Unmap();
+
   if (mBuffer != VK_NULL_HANDLE) {
     vkDestroyBuffer(mDevice->GetDevice(), mBuffer, nullptr);
   }
 
   if (mBufferMemory != VK_NULL_HANDLE) {
     vkFreeMemory(mDevice->GetDevice(), mBufferMemory, nullptr);
+    mDevice->GetMemoryTracker()->Free(mCategory, mMemoryTypeIndex,
+                                      mAllocationSize);
   }
 }
-uint32_t Buffer::findMemoryType(uint32_t typeFilter,
-                                VkMemoryPropertyFlags properties) {
+
+bool Buffer::tryFindMemoryType(uint32_t typeFilter,
+                               VkMemoryPropertyFlags properties,
+                               uint32_t &typeIndex) {
   VkPhysicalDeviceMemoryProperties memProps;
   vkGetPhysicalDeviceMemoryProperties(mDevice->GetPhysicalDevice(), &memProps);
 
@@ -101,14 +152,29 @@ uint32_t Buffer::findMemoryType(uint32_t typeFilter,
     // 该type可用&&该type符合要求
     if ((typeFilter & (1 << i)) &&
         ((memProps.memoryTypes[i].propertyFlags & properties) == properties)) {
-      return i;
+      typeIndex = i;
+      return true;
     }
   }
+  return false;
+}
+
+uint32_t Buffer::findMemoryType(uint32_t typeFilter,
+                                VkMemoryPropertyFlags properties) {
+  uint32_t typeIndex = 0;
+  if (tryFindMemoryType(typeFilter, properties, typeIndex)) {
+    return typeIndex;
+  }
 
   throw std::runtime_error("Error: cannot find the property memory type!");
 }
 // 从cpu端写入到GPU显存
 void Buffer::UpdateBufferByMap(void *data, size_t size) {
+  if (mMappedData != nullptr) {
+    memcpy(mMappedData, data, size);
+    return;
+  }
+
   void *memPtr = nullptr;
 
   vkMapMemory(mDevice->GetDevice(), mBufferMemory, 0, size, 0, &memPtr);
@@ -116,11 +182,43 @@ void Buffer::UpdateBufferByMap(void *data, size_t size) {
   vkUnmapMemory(mDevice->GetDevice(), mBufferMemory);
 }
 
+// 整块内存常驻映射，适合每帧都要写入的HOST_VISIBLE buffer
+void *Buffer::Map() {
+  if (mMappedData == nullptr) {
+    if (vkMapMemory(mDevice->GetDevice(), mBufferMemory, 0, VK_WHOLE_SIZE, 0,
+                    &mMappedData) != VK_SUCCESS) {
+      throw std::runtime_error("Error: failed to map buffer memory");
+    }
+  }
+
+  return mMappedData;
+}
+
+void Buffer::Unmap() {
+  if (mMappedData != nullptr) {
+    vkUnmapMemory(mDevice->GetDevice(), mBufferMemory);
+    mMappedData = nullptr;
+  }
+}
+
+void Buffer::Invalidate() {
+  if (mMemoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+    return;
+  }
+  VkMappedMemoryRange range{};
+  range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory = mBufferMemory;
+  range.offset = 0;
+  range.size = VK_WHOLE_SIZE;
+  vkInvalidateMappedMemoryRanges(mDevice->GetDevice(), 1, &range);
+}
+
 void Buffer::UpdateBufferByStage(void *data, size_t size) {
   auto stageBuffer =
       Buffer::Create(mDevice, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     0, MemoryCategory::Staging);
 
   stageBuffer->UpdateBufferByMap(data, size);
 
@@ -149,7 +247,8 @@ Buffer::Ptr Buffer::CreateVertexBuffer(const Device::Ptr &device,
   auto buffer = Buffer::Create(device, size,
                                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
                                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                               MemoryCategory::Model);
 
   buffer->UpdateBufferByStage(pData, size);
 
@@ -160,7 +259,8 @@ Buffer::Ptr Buffer::CreateIndexBuffer(const Device::Ptr &device,
   auto buffer = Buffer::Create(device, size,
                                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
                                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                               MemoryCategory::Model);
 
   buffer->UpdateBufferByStage(pData, size);
 
@@ -171,7 +271,8 @@ Buffer::Ptr Buffer::CreateUniformBuffer(const Device::Ptr &device,
                                         VkDeviceSize size, void *pData) {
   auto buffer = Buffer::Create(device, size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                               0, MemoryCategory::Uniform);
 
   if (pData != nullptr) {
     buffer->UpdateBufferByStage(pData, size);
@@ -185,7 +286,8 @@ Buffer::Ptr Buffer::CreateStageBuffer(const Device::Ptr &device,
                                       VkDeviceSize size, void *pData) {
   auto buffer = Buffer::Create(device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                               0, MemoryCategory::Staging);
 
   if (pData != nullptr) {
     buffer->UpdateBufferByMap(pData, size);
@@ -193,4 +295,13 @@ Buffer::Ptr Buffer::CreateStageBuffer(const Device::Ptr &device,
 
   return buffer;
 }
+
+Buffer::Ptr Buffer::CreateReadbackBuffer(const Device::Ptr &device,
+                                         VkDeviceSize size) {
+  auto buffer = Buffer::Create(device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                               VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                               MemoryCategory::Readback);
+  return buffer;
+}
 } // namespace VK::Wrapper
\ No newline at end of file
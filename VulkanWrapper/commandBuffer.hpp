@@ -6,11 +6,23 @@
 
 
 namespace VK::Wrapper {
+// 录制时的计数，每次Begin清零
+struct CommandBufferStats {
+  uint32_t mDrawCalls{0};
+  uint64_t mVertices{0};
+  uint64_t mIndices{0};
+  uint32_t mPipelineBinds{0};
+  uint32_t mDescriptorBinds{0};
+  // buffer之间的拷贝自动统计，拷到image的由调用方用AddUploadedBytes补上
+  VkDeviceSize mBytesUploaded{0};
+};
+
 class CommandBuffer {
 private:
   VkCommandBuffer mCommandBuffer{VK_NULL_HANDLE};
   Device::Ptr mDevice{nullptr};
   CommandPool::Ptr mCommandPool{nullptr};
+  CommandBufferStats mStats{};
 
 public:
   using Ptr = std::shared_ptr<CommandBuffer>;
@@ -23,12 +35,15 @@ public:
                 bool asSecondary = false);
   ~CommandBuffer();
   [[nodiscard]] auto GetCommandBuffer() const { return mCommandBuffer; }
+  [[nodiscard]] auto &GetStats() const { return mStats; }
+  void AddUploadedBytes(VkDeviceSize bytes) { mStats.mBytesUploaded += bytes; }
   void Begin(VkCommandBufferUsageFlags flag = 0,
              const VkCommandBufferInheritanceInfo &inheritance = {}) {
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = flag;
     beginInfo.pInheritanceInfo = &inheritance;
+    mStats = {};
 
     if (vkBeginCommandBuffer(mCommandBuffer, &beginInfo) != VK_SUCCESS) {
       throw std::runtime_error("Error:failed to begin commandBuffer");
@@ -42,13 +57,31 @@ public:
   }
 
   void BindGraphicPipeline(const VkPipeline &pipeline) {
+    ++mStats.mPipelineBinds;
     vkCmdBindPipeline(mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                       pipeline);
   }
   void BindDescriptorSet(const VkPipelineLayout layout,
-                         const VkDescriptorSet &descriptorSet) {
+                         const VkDescriptorSet &descriptorSet,
+                         const std::vector<uint32_t> &dynamicOffsets = {},
+                         uint32_t firstSet = 0) {
+    ++mStats.mDescriptorBinds;
     vkCmdBindDescriptorSets(mCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            layout, 0, 1, &descriptorSet, 0, nullptr);
+                            layout, firstSet, 1, &descriptorSet,
+                            static_cast<uint32_t>(dynamicOffsets.size()),
+                            dynamicOffsets.data());
+  }
+  void PushConstants(const VkPipelineLayout layout,
+                     VkShaderStageFlags stageFlags, uint32_t offset,
+                     uint32_t size, const void *pValues) {
+    vkCmdPushConstants(mCommandBuffer, layout, stageFlags, offset, size,
+                       pValues);
+  }
+  void SetViewport(const VkViewport &viewport) {
+    vkCmdSetViewport(mCommandBuffer, 0, 1, &viewport);
+  }
+  void SetScissor(const VkRect2D &scissor) {
+    vkCmdSetScissor(mCommandBuffer, 0, 1, &scissor);
   }
   void BindVertexBuffer(const std::vector<VkBuffer> &buffers) {
     std::vector<VkDeviceSize> offsets(buffers.size(), 0);
@@ -62,10 +95,14 @@ public:
   }
 
   void Draw(size_t vertexCount) {
+    ++mStats.mDrawCalls;
+    mStats.mVertices += vertexCount;
     vkCmdDraw(mCommandBuffer, vertexCount, 1, 0, 0);
   }
 
   void DrawIndex(size_t indexCount) {
+    ++mStats.mDrawCalls;
+    mStats.mIndices += indexCount;
     vkCmdDrawIndexed(mCommandBuffer, indexCount, 1, 0, 0, 0);
   }
 
@@ -79,19 +116,22 @@ public:
   void CopyBufferToBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
                           uint32_t copyInfoCount,
                           const std::vector<VkBufferCopy> &copyInfos) {
+    for (uint32_t i = 0; i < copyInfoCount; ++i) {
+      mStats.mBytesUploaded += copyInfos[i].size;
+    }
     vkCmdCopyBuffer(mCommandBuffer, srcBuffer, dstBuffer, copyInfoCount,
                     copyInfos.data());
   }
   void CopyBufferToImage(VkBuffer srcBuffer, VkImage dstImage,
                          VkImageLayout dstImageLayout, uint32_t width,
-                         uint32_t height) {
+                         uint32_t height, uint32_t mipLevel = 0) {
     VkBufferImageCopy region{};
     
     region.bufferOffset = 0;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.mipLevel = mipLevel;
     region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
     region.imageOffset = {0, 0, 0};
@@ -101,7 +141,50 @@ public:
                            1, &region);
   }
 
+  // 一次拷贝多个区域，比如一张纹理的所有mip
+  void CopyBufferToImage(VkBuffer srcBuffer, VkImage dstImage,
+                         VkImageLayout dstImageLayout,
+                         const std::vector<VkBufferImageCopy> &regions) {
+    vkCmdCopyBufferToImage(mCommandBuffer, srcBuffer, dstImage, dstImageLayout,
+                           static_cast<uint32_t>(regions.size()),
+                           regions.data());
+  }
+
+  // 回读用，把image拷到host可见的buffer
+  void CopyImageToBuffer(VkImage srcImage, VkImageLayout srcImageLayout,
+                         VkBuffer dstBuffer,
+                         const std::vector<VkBufferImageCopy> &regions) {
+    vkCmdCopyImageToBuffer(mCommandBuffer, srcImage, srcImageLayout, dstBuffer,
+                           static_cast<uint32_t>(regions.size()),
+                           regions.data());
+  }
+
+  void BlitImage(VkImage srcImage, VkImageLayout srcImageLayout,
+                 VkImage dstImage, VkImageLayout dstImageLayout,
+                 const VkImageBlit &region, VkFilter filter) {
+    vkCmdBlitImage(mCommandBuffer, srcImage, srcImageLayout, dstImage,
+                   dstImageLayout, 1, &region, filter);
+  }
+
+  // query要先reset才能写，reset必须在renderPass外面
+  void ResetQueryPool(VkQueryPool queryPool, uint32_t firstQuery,
+                      uint32_t queryCount) {
+    vkCmdResetQueryPool(mCommandBuffer, queryPool, firstQuery, queryCount);
+  }
+  void WriteTimestamp(VkPipelineStageFlagBits stage, VkQueryPool queryPool,
+                      uint32_t query) {
+    vkCmdWriteTimestamp(mCommandBuffer, stage, queryPool, query);
+  }
+  void BeginQuery(VkQueryPool queryPool, uint32_t query) {
+    vkCmdBeginQuery(mCommandBuffer, queryPool, query, 0);
+  }
+  void EndQuery(VkQueryPool queryPool, uint32_t query) {
+    vkCmdEndQuery(mCommandBuffer, queryPool, query);
+  }
+
   void SubmitSync(VkQueue queue, VkFence fence = VK_NULL_HANDLE);
+  // 不等待队列空闲，完成情况通过fence查询
+  void Submit(VkQueue queue, VkFence fence);
   void TransferImageLayout(VkImageMemoryBarrier &imageMemoryBarrier,
                            VkPipelineStageFlags srcStageMask,
                            VkPipelineStageFlags dstStageMask) {
@@ -110,6 +193,28 @@ public:
                          0, nullptr, // BufferMemoryBarrier
                          1, &imageMemoryBarrier);
   }
+  void PipelineBarrier(VkPipelineStageFlags srcStageMask,
+                       VkPipelineStageFlags dstStageMask,
+                       const std::vector<VkBufferMemoryBarrier> &bufferBarriers,
+                       const std::vector<VkImageMemoryBarrier> &imageBarriers) {
+    vkCmdPipelineBarrier(mCommandBuffer, srcStageMask, dstStageMask, 0, 0,
+                         nullptr, static_cast<uint32_t>(bufferBarriers.size()),
+                         bufferBarriers.data(),
+                         static_cast<uint32_t>(imageBarriers.size()),
+                         imageBarriers.data());
+  }
+  // 多张image的barrier合成一次vkCmdPipelineBarrier
+  void TransferImageLayouts(const std::vector<VkImageMemoryBarrier> &barriers,
+                            VkPipelineStageFlags srcStageMask,
+                            VkPipelineStageFlags dstStageMask) {
+    if (barriers.empty()) {
+      return;
+    }
+    vkCmdPipelineBarrier(mCommandBuffer, srcStageMask, dstStageMask, 0, 0,
+                         nullptr, 0, nullptr,
+                         static_cast<uint32_t>(barriers.size()),
+                         barriers.data());
+  }
 };
 CommandBuffer::CommandBuffer(const Device::Ptr &device,
                              const CommandPool::Ptr &commandPool,
@@ -146,4 +251,15 @@ void CommandBuffer::SubmitSync(VkQueue queue, VkFence fence) {
 
   vkQueueWaitIdle(queue);
 }
+
+void CommandBuffer::Submit(VkQueue queue, VkFence fence) {
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &mCommandBuffer;
+
+  if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+    throw std::runtime_error("Error: failed to submit command buffer");
+  }
+}
 } // namespace VK::Wrapper
\ No newline at end of file
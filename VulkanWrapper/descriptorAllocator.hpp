@@ -0,0 +1,154 @@
+#pragma once
+#include "../base.h"
+#include <algorithm>
+#include "descriptorPool.hpp"
+#include "descriptorSetLayout.hpp"
+#include "device.hpp"
+#include "vulkan/vulkan_core.h"
+
+namespace VK::Wrapper {
+
+struct DescriptorAllocatorStats {
+  // 一共创建过多少个pool
+  uint32_t m_PoolCount{0};
+  // 所有pool的maxSets之和
+  uint64_t m_SetCapacity{0};
+  // 总共分配过的set数量
+  uint64_t m_AllocatedSets{0};
+};
+
+// 可增长的descriptor分配器
+// 当前pool耗尽(VK_ERROR_OUT_OF_POOL_MEMORY)时自动挂上一个新的pool，新pool容量翻倍
+// 分配出去的set和分配器同生命周期，不单独回收
+class DescriptorAllocator {
+private:
+  Device::Ptr m_Device{nullptr};
+  // 每个set平均需要多少个该类型的descriptor
+  std::vector<std::pair<VkDescriptorType, float>> m_PoolRatios{};
+  VkDescriptorPoolCreateFlags m_PoolFlags{0};
+  uint32_t m_SetsPerPool{0};
+
+  DescriptorPool::Ptr m_CurrentPool{nullptr};
+  std::vector<DescriptorPool::Ptr> m_UsedPools{};
+
+  DescriptorAllocatorStats m_Stats{};
+
+  static constexpr uint32_t MAX_SETS_PER_POOL{4096};
+
+public:
+  using Ptr = std::shared_ptr<DescriptorAllocator>;
+  static Ptr Create(const Device::Ptr &device, uint32_t initialSetsPerPool = 64,
+                    VkDescriptorPoolCreateFlags flags = 0) {
+    return std::make_shared<DescriptorAllocator>(device, initialSetsPerPool,
+                                                 flags);
+  }
+
+  DescriptorAllocator(const Device::Ptr &device, uint32_t initialSetsPerPool,
+                      VkDescriptorPoolCreateFlags flags);
+  ~DescriptorAllocator() = default;
+
+  void SetPoolRatios(
+      const std::vector<std::pair<VkDescriptorType, float>> &ratios) {
+    m_PoolRatios = ratios;
+  }
+
+  // 按比例建的pool装不下这个layout时，按layout实际的descriptor数量再建一个
+  VkDescriptorSet Allocate(const DescriptorSetLayout::Ptr &layout);
+
+  [[nodiscard]] auto &GetStats() const { return m_Stats; }
+
+private:
+  DescriptorPool::Ptr CreatePool(const DescriptorSetLayout::Ptr &layout);
+};
+
+DescriptorAllocator::DescriptorAllocator(const Device::Ptr &device,
+                                         uint32_t initialSetsPerPool,
+                                         VkDescriptorPoolCreateFlags flags) {
+  m_Device = device;
+  m_SetsPerPool = initialSetsPerPool;
+  m_PoolFlags = flags;
+  m_PoolRatios = {
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2.0f},
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+      {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f},
+      {VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f},
+  };
+}
+
+// layout为空时只按比例，否则每种类型至少够m_SetsPerPool个这样的set
+DescriptorPool::Ptr
+DescriptorAllocator::CreatePool(const DescriptorSetLayout::Ptr &layout) {
+  std::vector<VkDescriptorPoolSize> poolSizes{};
+  auto addSize = [&](VkDescriptorType type, uint32_t count) {
+    for (auto &poolSize : poolSizes) {
+      if (poolSize.type == type) {
+        poolSize.descriptorCount = std::max(poolSize.descriptorCount, count);
+        return;
+      }
+    }
+    poolSizes.push_back({type, count});
+  };
+
+  for (const auto &ratio : m_PoolRatios) {
+    addSize(ratio.first,
+            std::max(1u, static_cast<uint32_t>(ratio.second * m_SetsPerPool)));
+  }
+  if (layout != nullptr) {
+    std::vector<VkDescriptorPoolSize> layoutSizes{};
+    for (const auto &param : layout->GetParams()) {
+      auto found = std::find_if(
+          layoutSizes.begin(), layoutSizes.end(),
+          [&](const VkDescriptorPoolSize &size) {
+            return size.type == param->mDescriptorType;
+          });
+      if (found == layoutSizes.end()) {
+        layoutSizes.push_back({param->mDescriptorType, param->mCount});
+      } else {
+        found->descriptorCount += param->mCount;
+      }
+    }
+    for (const auto &size : layoutSizes) {
+      addSize(size.type, size.descriptorCount * m_SetsPerPool);
+    }
+  }
+
+  auto pool = DescriptorPool::Create(m_Device);
+  pool->Build(poolSizes, m_SetsPerPool, m_PoolFlags);
+
+  m_Stats.m_PoolCount++;
+  m_Stats.m_SetCapacity += m_SetsPerPool;
+  // 下一次需要新pool时容量翻倍，减少链上pool的数量
+  m_SetsPerPool = std::min(m_SetsPerPool * 2, MAX_SETS_PER_POOL);
+  return pool;
+}
+
+VkDescriptorSet
+DescriptorAllocator::Allocate(const DescriptorSetLayout::Ptr &layout) {
+  if (m_CurrentPool == nullptr) {
+    m_CurrentPool = CreatePool(nullptr);
+  }
+
+  VkDescriptorSet set{VK_NULL_HANDLE};
+  auto result = m_CurrentPool->Allocate(layout->GetLayout(), set);
+
+  // 第一次重试用按比例的新pool，还不够说明layout超出了比例，按layout的数量建
+  for (int attempt = 0; attempt < 2 &&
+                        (result == VK_ERROR_OUT_OF_POOL_MEMORY ||
+                         result == VK_ERROR_FRAGMENTED_POOL);
+       ++attempt) {
+    m_UsedPools.push_back(m_CurrentPool);
+    m_CurrentPool = CreatePool(attempt == 0 ? nullptr : layout);
+    result = m_CurrentPool->Allocate(layout->GetLayout(), set);
+  }
+
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("Error: failed to allocate descriptor set");
+  }
+
+  m_Stats.m_AllocatedSets++;
+  return set;
+}
+
+} // namespace VK::Wrapper
@@ -10,6 +10,8 @@ class DescriptorPool {
 private:
   VkDescriptorPool m_Pool{VK_NULL_HANDLE};
   Device::Ptr m_Device{nullptr};
+  uint32_t m_MaxSets{0};
+  uint32_t m_AllocatedSets{0};
 
 public:
   using Ptr = std::shared_ptr<DescriptorPool>;
@@ -19,56 +21,75 @@ public:
   DescriptorPool(const Device::Ptr &device);
   ~DescriptorPool();
 
-  void Build(std::vector<UniformParameter::Ptr> &params, const int &frameCount);
+  // descriptorCount为0的类型会被跳过
+  void Build(const std::vector<VkDescriptorPoolSize> &poolSizes,
+             uint32_t maxSets, VkDescriptorPoolCreateFlags flags = 0);
+
+  // 池子耗尽时返回VK_ERROR_OUT_OF_POOL_MEMORY / VK_ERROR_FRAGMENTED_POOL，而不是抛异常
+  VkResult Allocate(VkDescriptorSetLayout layout, VkDescriptorSet &set);
+
   [[nodiscard]] auto GetPool() const { return m_Pool; }
+  [[nodiscard]] auto GetMaxSets() const { return m_MaxSets; }
+  [[nodiscard]] auto GetAllocatedSets() const { return m_AllocatedSets; }
 };
 DescriptorPool::DescriptorPool(const Device::Ptr &device) { m_Device = device; }
 DescriptorPool::~DescriptorPool() {
   if (m_Pool != VK_NULL_HANDLE) {
     vkDestroyDescriptorPool(m_Device->GetDevice(), m_Pool, nullptr);
+    m_Device->GetMemoryTracker()->Free(MemoryCategory::DescriptorPool,
+                                       MemoryTracker::NO_MEMORY_TYPE, 0);
   }
 }
 
-void DescriptorPool::Build(std::vector<UniformParameter::Ptr> &params,
-                           const int &frameCount) {
-  // 统计下有多少个uniformBuffer
-  int uniformBufferCount = 0;
+void DescriptorPool::Build(const std::vector<VkDescriptorPoolSize> &poolSizes,
+                           uint32_t maxSets,
+                           VkDescriptorPoolCreateFlags flags) {
+  if (m_Pool != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(m_Device->GetDevice(), m_Pool, nullptr);
+    m_Pool = VK_NULL_HANDLE;
+    m_Device->GetMemoryTracker()->Free(MemoryCategory::DescriptorPool,
+                                       MemoryTracker::NO_MEMORY_TYPE, 0);
+  }
 
-  int textureCount = 0;
-  for (const auto &param : params) {
-    if (param->mDescriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
-      uniformBufferCount++;
+  // descriptorCount必须大于0
+  std::vector<VkDescriptorPoolSize> sizes{};
+  for (const auto &poolSize : poolSizes) {
+    if (poolSize.descriptorCount > 0) {
+      sizes.push_back(poolSize);
     }
-    if (param->mDescriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
-      textureCount++;
-    // TODO
   }
-  // 描述每一种uniform都有多少个
-  // 即一个DescriptorSet有几个buffer，几个Texture
-  std::vector<VkDescriptorPoolSize> poolSizes{};
-  VkDescriptorPoolSize uniformBufferSize{};
-  uniformBufferSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  uniformBufferSize.descriptorCount = uniformBufferCount * frameCount;
-  poolSizes.push_back(uniformBufferSize);
-
-  VkDescriptorPoolSize textureSize{};
-  textureSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  textureSize.descriptorCount =
-      textureCount * frameCount; // 这边的size是指，有多少个descriptor
-  poolSizes.push_back(textureSize);
 
   // 创建pool
   VkDescriptorPoolCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  createInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-  createInfo.pPoolSizes = poolSizes.data();
-  // 每一帧都有自己单独的descriptorSet,不然无法支持并行
-  createInfo.maxSets = static_cast<uint32_t>(frameCount);
+  createInfo.flags = flags;
+  createInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+  createInfo.pPoolSizes = sizes.data();
+  createInfo.maxSets = maxSets;
 
   if (vkCreateDescriptorPool(m_Device->GetDevice(), &createInfo, nullptr,
                              &m_Pool) != VK_SUCCESS) {
     throw std::runtime_error("Error: failed to create Descriptor pool");
   }
+  m_Device->GetMemoryTracker()->Allocate(MemoryCategory::DescriptorPool,
+                                         MemoryTracker::NO_MEMORY_TYPE, 0);
+  m_MaxSets = maxSets;
+  m_AllocatedSets = 0;
+}
+
+VkResult DescriptorPool::Allocate(VkDescriptorSetLayout layout,
+                                  VkDescriptorSet &set) {
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = m_Pool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &layout;
+
+  auto result = vkAllocateDescriptorSets(m_Device->GetDevice(), &allocInfo, &set);
+  if (result == VK_SUCCESS) {
+    m_AllocatedSets++;
+  }
+  return result;
 }
 
 } // namespace VK::Wrapper
\ No newline at end of file
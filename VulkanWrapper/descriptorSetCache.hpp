@@ -0,0 +1,143 @@
+#pragma once
+#include "../base.h"
+#include "descriptorAllocator.hpp"
+#include "descriptorSetLayout.hpp"
+#include "descriptorUpdateTemplate.hpp"
+#include "device.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+namespace VK::Wrapper {
+
+struct DescriptorSetCacheStats {
+  uint64_t m_Hits{0};
+  uint64_t m_Misses{0};
+  size_t m_CachedSets{0};
+};
+
+// 以 layout + 绑定内容(buffer/image/sampler句柄) 为key缓存descriptorSet
+// 内容相同的请求直接返回已有的set，不再分配也不再写入
+// set从cache自己的分配器里分配，和外面共用的分配器互不影响
+class DescriptorSetCache {
+private:
+  struct Key {
+    VkDescriptorSetLayout m_Layout{VK_NULL_HANDLE};
+    std::vector<DescriptorData> m_Data{};
+    size_t m_Hash{0};
+
+    bool operator==(const Key &other) const {
+      return m_Layout == other.m_Layout &&
+             m_Data.size() == other.m_Data.size() &&
+             memcmp(m_Data.data(), other.m_Data.data(),
+                    m_Data.size() * sizeof(DescriptorData)) == 0;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const { return key.m_Hash; }
+  };
+
+  Device::Ptr m_Device{nullptr};
+  DescriptorAllocator::Ptr m_Allocator{nullptr};
+  std::unordered_map<Key, VkDescriptorSet, KeyHash> m_Sets{};
+  std::unordered_map<VkDescriptorSetLayout, DescriptorUpdateTemplate::Ptr>
+      m_Templates{};
+  DescriptorSetCacheStats m_Stats{};
+
+public:
+  using Ptr = std::shared_ptr<DescriptorSetCache>;
+  static Ptr Create(const Device::Ptr &device) {
+    return std::make_shared<DescriptorSetCache>(device);
+  }
+
+  DescriptorSetCache(const Device::Ptr &device);
+  ~DescriptorSetCache() = default;
+
+  VkDescriptorSet GetOrCreate(const DescriptorSetLayout::Ptr &layout,
+                              const std::vector<DescriptorData> &data);
+
+  // 绑定的资源被销毁之前需要清掉，否则新资源复用旧句柄时会命中失效的set
+  // 只丢掉缓存项，已经返回出去的set(比如每帧的uniform set)仍然有效，
+  // 它们占的pool空间随cache一起释放
+  void Clear();
+
+  // 只丢掉引用这个imageView的缓存项，image被替换或销毁之前调用
+  // 以后同样内容的请求会重新分配一个set，旧的set不改写，还在执行的帧可以继续用
+  void Invalidate(VkImageView imageView);
+
+  [[nodiscard]] DescriptorSetCacheStats GetStats() const {
+    auto stats = m_Stats;
+    stats.m_CachedSets = m_Sets.size();
+    return stats;
+  }
+
+  // 查找用的key哈希，纯cpu
+  static size_t HashKey(VkDescriptorSetLayout layout,
+                        const std::vector<DescriptorData> &data) {
+    return HashBytes(data.data(), data.size() * sizeof(DescriptorData),
+                     reinterpret_cast<size_t>(layout));
+  }
+
+private:
+  static size_t HashBytes(const void *data, size_t size, size_t seed);
+};
+
+DescriptorSetCache::DescriptorSetCache(const Device::Ptr &device) {
+  m_Device = device;
+  m_Allocator = DescriptorAllocator::Create(device);
+}
+
+// FNV-1a
+size_t DescriptorSetCache::HashBytes(const void *data, size_t size,
+                                     size_t seed) {
+  auto bytes = static_cast<const uint8_t *>(data);
+  uint64_t hash = 14695981039346656037ull ^ seed;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return static_cast<size_t>(hash);
+}
+
+VkDescriptorSet
+DescriptorSetCache::GetOrCreate(const DescriptorSetLayout::Ptr &layout,
+                                const std::vector<DescriptorData> &data) {
+  Key key{};
+  key.m_Layout = layout->GetLayout();
+  key.m_Data = data;
+  key.m_Hash = HashKey(key.m_Layout, data);
+
+  auto found = m_Sets.find(key);
+  if (found != m_Sets.end()) {
+    m_Stats.m_Hits++;
+    return found->second;
+  }
+  m_Stats.m_Misses++;
+
+  auto &updateTemplate = m_Templates[key.m_Layout];
+  if (updateTemplate == nullptr) {
+    updateTemplate = DescriptorUpdateTemplate::Create(m_Device, layout);
+  }
+
+  auto set = m_Allocator->Allocate(layout);
+  updateTemplate->Update(set, data);
+
+  m_Sets.emplace(std::move(key), set);
+  return set;
+}
+
+void DescriptorSetCache::Clear() { m_Sets.clear(); }
+
+void DescriptorSetCache::Invalidate(VkImageView imageView) {
+  // 槽位是union，buffer槽的offset恰好等于句柄值时会多丢一项，只是多一次未命中
+  for (auto it = m_Sets.begin(); it != m_Sets.end();) {
+    const auto &data = it->first.m_Data;
+    const bool found =
+        std::any_of(data.begin(), data.end(), [&](const DescriptorData &slot) {
+          return slot.m_ImageInfo.imageView == imageView;
+        });
+    it = found ? m_Sets.erase(it) : std::next(it);
+  }
+}
+
+} // namespace VK::Wrapper
@@ -23,6 +23,7 @@ public:
   ~DescriptorSetLayout();
   void Build(std::vector<UniformParameter::Ptr> params);
   [[nodiscard]] auto  &GetLayout() const { return m_Layout; }
+  [[nodiscard]] auto &GetParams() const { return m_Params; }
 };
 
 DescriptorSetLayout::DescriptorSetLayout(const Device::Ptr &device) {
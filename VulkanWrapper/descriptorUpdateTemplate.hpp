@@ -0,0 +1,116 @@
+#pragma once
+#include "../base.h"
+#include "description.h"
+#include "descriptorSetLayout.hpp"
+#include "device.hpp"
+#include "vulkan/vulkan_core.h"
+
+namespace VK::Wrapper {
+
+// 模板更新用的数据槽，每个descriptor占一个槽
+// 使用前需要整体清零，cache会按字节比较内容
+union DescriptorData {
+  VkDescriptorImageInfo m_ImageInfo;
+  VkDescriptorBufferInfo m_BufferInfo;
+};
+
+// 按params的顺序把第frame帧要写入的buffer/image信息排成一排
+inline void BuildDescriptorData(const std::vector<UniformParameter::Ptr> &params,
+                                int frame, std::vector<DescriptorData> &data) {
+  size_t slotCount = 0;
+  for (const auto &param : params) {
+    slotCount += param->mCount;
+  }
+  data.resize(slotCount);
+  memset(data.data(), 0, data.size() * sizeof(DescriptorData));
+
+  size_t slot = 0;
+  for (const auto &param : params) {
+    for (uint32_t i = 0; i < param->mCount; ++i, ++slot) {
+      switch (param->mDescriptorType) {
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        data[slot].m_BufferInfo = param->m_Buffers[frame]->GetBufferInfo();
+        break;
+      // dynamic uniform 只描述一个元素的大小，真正的位置在bind时由dynamic offset给出
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+        data[slot].m_BufferInfo.buffer = param->m_Buffers[frame]->getBuffer();
+        data[slot].m_BufferInfo.offset = 0;
+        data[slot].m_BufferInfo.range = param->mSize;
+        break;
+      case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+        data[slot].m_ImageInfo = param->mTexture->GetImageInfo();
+        break;
+      default:
+        break;
+      }
+    }
+  }
+}
+
+// 对应某个descriptorSetLayout的更新模板
+// 一次vkUpdateDescriptorSetWithTemplate就能写完整个set，不需要逐个组装VkWriteDescriptorSet
+class DescriptorUpdateTemplate {
+private:
+  VkDescriptorUpdateTemplate m_Template{VK_NULL_HANDLE};
+  Device::Ptr m_Device{nullptr};
+
+public:
+  using Ptr = std::shared_ptr<DescriptorUpdateTemplate>;
+  static Ptr Create(const Device::Ptr &device,
+                    const DescriptorSetLayout::Ptr &layout) {
+    return std::make_shared<DescriptorUpdateTemplate>(device, layout);
+  }
+
+  DescriptorUpdateTemplate(const Device::Ptr &device,
+                           const DescriptorSetLayout::Ptr &layout);
+  ~DescriptorUpdateTemplate();
+
+  void Update(VkDescriptorSet set, const std::vector<DescriptorData> &data) {
+    vkUpdateDescriptorSetWithTemplate(m_Device->GetDevice(), set, m_Template,
+                                      data.data());
+  }
+
+  [[nodiscard]] auto GetTemplate() const { return m_Template; }
+};
+
+DescriptorUpdateTemplate::DescriptorUpdateTemplate(
+    const Device::Ptr &device, const DescriptorSetLayout::Ptr &layout) {
+  m_Device = device;
+
+  std::vector<VkDescriptorUpdateTemplateEntry> entries{};
+  size_t slot = 0;
+  for (const auto &param : layout->GetParams()) {
+    VkDescriptorUpdateTemplateEntry entry{};
+    entry.dstBinding = param->mBinding;
+    entry.dstArrayElement = 0;
+    entry.descriptorCount = param->mCount;
+    entry.descriptorType = param->mDescriptorType;
+    entry.offset = slot * sizeof(DescriptorData);
+    entry.stride = sizeof(DescriptorData);
+    entries.push_back(entry);
+
+    slot += param->mCount;
+  }
+
+  VkDescriptorUpdateTemplateCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+  createInfo.descriptorUpdateEntryCount =
+      static_cast<uint32_t>(entries.size());
+  createInfo.pDescriptorUpdateEntries = entries.data();
+  createInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+  createInfo.descriptorSetLayout = layout->GetLayout();
+
+  if (vkCreateDescriptorUpdateTemplate(m_Device->GetDevice(), &createInfo,
+                                       nullptr, &m_Template) != VK_SUCCESS) {
+    throw std::runtime_error("Error: failed to create descriptor update template");
+  }
+}
+
+DescriptorUpdateTemplate::~DescriptorUpdateTemplate() {
+  if (m_Template != VK_NULL_HANDLE) {
+    vkDestroyDescriptorUpdateTemplate(m_Device->GetDevice(), m_Template,
+                                      nullptr);
+  }
+}
+
+} // namespace VK::Wrapper
@@ -1,6 +1,7 @@
 #pragma once
 #include "../base.h"
 #include "Instance.hpp"
+#include "memoryTracker.hpp"
 #include "vulkan/vulkan_core.h"
 #include "windowSurface.hpp"
 #include <iostream>
@@ -14,21 +15,38 @@ namespace VK::Wrapper {
 const std::vector<const char *> deviceRequiredExtensions{
     VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
+// 所有DEVICE_LOCAL堆加起来的预算和已用量
+struct DeviceMemoryBudget {
+  VkDeviceSize m_Budget{0};
+  VkDeviceSize m_Usage{0};
+};
+
 class Device {
 private:
   Instance::Ptr m_Instance;
   VkDevice m_Device;
   WindowSurface::Ptr m_Surface{nullptr};
   VkPhysicalDevice m_PhysicalDevice{VK_NULL_HANDLE};
+  VkPhysicalDeviceProperties m_Properties{};
+  // 实际打开的特性，压缩纹理格式要看这里
+  VkPhysicalDeviceFeatures m_EnabledFeatures{};
+  // bindless纹理需要的descriptor indexing能力
+  bool m_BindlessSupported{false};
+  VkPhysicalDeviceDescriptorIndexingProperties m_DescriptorIndexingProperties{};
+  // VK_EXT_memory_budget可用时能拿到驱动给出的实时预算，否则只能用堆大小估计
+  bool m_MemoryBudgetSupported{false};
   // 渲染队列
   std::optional<uint32_t> m_GraphicQueueFamily;
   VkQueue m_GraphicQueue{VK_NULL_HANDLE};
   // 显示队列
   std::optional<uint32_t> m_PresentQueueFamily;
   VkQueue m_PresentQueue{VK_NULL_HANDLE};
+  // Buffer/Image等分配显存时记到这里
+  MemoryTracker::Ptr m_MemoryTracker{nullptr};
 
 public:
   using Ptr = std::shared_ptr<Device>;
+  // surface为nullptr时是无窗口模式，不创建显示队列
   static Ptr Create(Instance::Ptr instance, WindowSurface::Ptr surface) {
     return std::make_shared<Device>(instance, surface);
   }
@@ -41,9 +59,31 @@ public:
   bool IsDeviceSuitable(VkPhysicalDevice device);
   void InitQueueFamilies(VkPhysicalDevice device);
   void CreateLogicalDevice();
+  void QueryDescriptorIndexingSupport();
   VkSampleCountFlagBits getMaxUsableSampleCount();
+  // 不超过requested的最大可用采样数，颜色和深度都要支持
+  VkSampleCountFlagBits GetSupportedSampleCount(VkSampleCountFlagBits requested);
+  [[nodiscard]] bool IsSampleRateShadingSupported() const {
+    return m_EnabledFeatures.sampleRateShading == VK_TRUE;
+  }
+  [[nodiscard]] bool IsPipelineStatisticsSupported() const {
+    return m_EnabledFeatures.pipelineStatisticsQuery == VK_TRUE;
+  }
   [[nodiscard]] auto GetDevice() const { return m_Device; }
   [[nodiscard]] auto GetPhysicalDevice() const { return m_PhysicalDevice; }
+  [[nodiscard]] auto &GetProperties() const { return m_Properties; }
+  [[nodiscard]] auto &GetEnabledFeatures() const { return m_EnabledFeatures; }
+  bool IsFormatSupported(VkFormat format, VkFormatFeatureFlags features) const;
+  bool IsExtensionSupported(const char *extensionName) const;
+  [[nodiscard]] auto IsMemoryBudgetSupported() const {
+    return m_MemoryBudgetSupported;
+  }
+  DeviceMemoryBudget QueryMemoryBudget() const;
+  [[nodiscard]] auto &GetMemoryTracker() const { return m_MemoryTracker; }
+  [[nodiscard]] auto IsBindlessSupported() const { return m_BindlessSupported; }
+  [[nodiscard]] auto &GetDescriptorIndexingProperties() const {
+    return m_DescriptorIndexingProperties;
+  }
 
   [[nodiscard]] auto GetGraphicQueueFamily() const {
     return m_GraphicQueueFamily;
@@ -60,6 +100,8 @@ Device::Device(Instance::Ptr instance, WindowSurface::Ptr surface) {
   m_Instance = instance;
   m_Surface = surface;
   PickPhysicalDevice();
+  m_MemoryTracker = MemoryTracker::Create(m_PhysicalDevice);
+  QueryDescriptorIndexingSupport();
   InitQueueFamilies(m_PhysicalDevice);
   CreateLogicalDevice();
 }
@@ -88,6 +130,7 @@ void Device::PickPhysicalDevice() {
     break;
   }
   IsDeviceSuitable(m_PhysicalDevice);
+  vkGetPhysicalDeviceProperties(m_PhysicalDevice, &m_Properties);
 
   // auto physicalSupport = IsDeviceSuitable(m_PhysicalDevice);
   // std::cout << "vaild : " << physicalSupport << std::endl;
@@ -126,8 +169,10 @@ inline void Device::CreateLogicalDevice() {
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
-  std::set<uint32_t> queueFamilies = {m_GraphicQueueFamily.value(),
-                                      m_PresentQueueFamily.value()};
+  std::set<uint32_t> queueFamilies = {m_GraphicQueueFamily.value()};
+  if (m_PresentQueueFamily.has_value()) {
+    queueFamilies.insert(m_PresentQueueFamily.value());
+  }
   // queueFamilies.insert(m_GraphicQueueFamily.value());
   // queueFamilies.insert(m_PresentQueueFamily.value() );
 
@@ -144,18 +189,59 @@ inline void Device::CreateLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures{};
+  vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &supportedFeatures);
+
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  // 压缩格式按设备能力打开，桌面一般是BC，移动端是ETC2/ASTC
+  deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+  deviceFeatures.textureCompressionETC2 =
+      supportedFeatures.textureCompressionETC2;
+  deviceFeatures.textureCompressionASTC_LDR =
+      supportedFeatures.textureCompressionASTC_LDR;
+  // 逐采样着色，开不开由pipeline决定
+  deviceFeatures.sampleRateShading = supportedFeatures.sampleRateShading;
+  // profiler的pipeline statistics查询
+  deviceFeatures.pipelineStatisticsQuery =
+      supportedFeatures.pipelineStatisticsQuery;
+  m_EnabledFeatures = deviceFeatures;
+
+  // 只打开bindless用得到的那几项
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+  indexingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+  indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+  indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+
+  VkPhysicalDeviceFeatures2 deviceFeatures2{};
+  deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  deviceFeatures2.features = deviceFeatures;
+  deviceFeatures2.pNext = m_BindlessSupported ? &indexingFeatures : nullptr;
 
   VkDeviceCreateInfo deviceCreateInfo = {};
   deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  deviceCreateInfo.pNext = &deviceFeatures2;
   deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
   deviceCreateInfo.queueCreateInfoCount =
       static_cast<uint32_t>(queueCreateInfos.size());
-  deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
+  deviceCreateInfo.pEnabledFeatures = nullptr;
+  // 无窗口模式没有surface，也就不需要swapchain扩展
+  std::vector<const char *> extensions{};
+  if (m_Surface) {
+    extensions = deviceRequiredExtensions;
+  }
+  m_MemoryBudgetSupported =
+      IsExtensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (m_MemoryBudgetSupported) {
+    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+
   deviceCreateInfo.enabledExtensionCount =
-      static_cast<uint32_t>(deviceRequiredExtensions.size());
-  deviceCreateInfo.ppEnabledExtensionNames = deviceRequiredExtensions.data();
+      static_cast<uint32_t>(extensions.size());
+  deviceCreateInfo.ppEnabledExtensionNames = extensions.data();
 
   //   // layer��
   //   if (mInstance->getEnableValidationLayer()) {
@@ -173,7 +259,90 @@ inline void Device::CreateLogicalDevice() {
   }
 
   vkGetDeviceQueue(m_Device, m_GraphicQueueFamily.value(), 0, &m_GraphicQueue);
-  vkGetDeviceQueue(m_Device, m_PresentQueueFamily.value(), 0, &m_PresentQueue);
+  if (m_PresentQueueFamily.has_value()) {
+    vkGetDeviceQueue(m_Device, m_PresentQueueFamily.value(), 0,
+                     &m_PresentQueue);
+  }
+}
+
+bool Device::IsFormatSupported(VkFormat format,
+                               VkFormatFeatureFlags features) const {
+  VkFormatProperties props{};
+  vkGetPhysicalDeviceFormatProperties(m_PhysicalDevice, format, &props);
+  return (props.optimalTilingFeatures & features) == features;
+}
+
+bool Device::IsExtensionSupported(const char *extensionName) const {
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr,
+                                       &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr,
+                                       &extensionCount, extensions.data());
+
+  for (const auto &extension : extensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+DeviceMemoryBudget Device::QueryMemoryBudget() const {
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps{};
+  budgetProps.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+  VkPhysicalDeviceMemoryProperties2 memProps2{};
+  memProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+  memProps2.pNext = m_MemoryBudgetSupported ? &budgetProps : nullptr;
+  vkGetPhysicalDeviceMemoryProperties2(m_PhysicalDevice, &memProps2);
+
+  DeviceMemoryBudget result{};
+  const auto &memProps = memProps2.memoryProperties;
+  for (uint32_t i = 0; i < memProps.memoryHeapCount; ++i) {
+    if (!(memProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+      continue;
+    }
+    if (m_MemoryBudgetSupported) {
+      result.m_Budget += budgetProps.heapBudget[i];
+      result.m_Usage += budgetProps.heapUsage[i];
+    } else {
+      result.m_Budget += memProps.memoryHeaps[i].size;
+    }
+  }
+  return result;
+}
+
+void Device::QueryDescriptorIndexingSupport() {
+  // descriptor indexing 在1.2进入核心
+  if (m_Properties.apiVersion < VK_API_VERSION_1_2) {
+    m_BindlessSupported = false;
+    return;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+  indexingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+  VkPhysicalDeviceFeatures2 features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features2.pNext = &indexingFeatures;
+  vkGetPhysicalDeviceFeatures2(m_PhysicalDevice, &features2);
+
+  m_BindlessSupported =
+      indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+      indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+      indexingFeatures.descriptorBindingPartiallyBound &&
+      indexingFeatures.runtimeDescriptorArray;
+
+  m_DescriptorIndexingProperties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+  VkPhysicalDeviceProperties2 properties2{};
+  properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties2.pNext = &m_DescriptorIndexingProperties;
+  vkGetPhysicalDeviceProperties2(m_PhysicalDevice, &properties2);
+  m_DescriptorIndexingProperties.pNext = nullptr;
 }
 
 void Device::InitQueueFamilies(VkPhysicalDevice device) {
@@ -192,8 +361,10 @@ void Device::InitQueueFamilies(VkPhysicalDevice device) {
     }
 
     VkBool32 presentSupport = VK_FALSE;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface->GetSurface(),
-                                         &presentSupport);
+    if (m_Surface) {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface->GetSurface(),
+                                           &presentSupport);
+    }
 
     if (presentSupport) {
       m_PresentQueueFamily = i;
@@ -209,15 +380,16 @@ void Device::InitQueueFamilies(VkPhysicalDevice device) {
 
 bool Device::IsQueueFamilyComplete() {
 
-  return m_GraphicQueueFamily.has_value() && m_PresentQueueFamily.has_value();
+  // 没有surface时只要渲染队列
+  return m_GraphicQueueFamily.has_value() &&
+         (m_PresentQueueFamily.has_value() || !m_Surface);
 }
 VkSampleCountFlagBits Device::getMaxUsableSampleCount() {
   VkPhysicalDeviceProperties props{};
   vkGetPhysicalDeviceProperties(m_PhysicalDevice, &props);
 
-  VkSampleCountFlags counts =
-      std::min(props.limits.framebufferColorSampleCounts,
-               props.limits.framebufferDepthSampleCounts);
+  VkSampleCountFlags counts = props.limits.framebufferColorSampleCounts &
+                              props.limits.framebufferDepthSampleCounts;
 
   if (counts & VK_SAMPLE_COUNT_64_BIT) {
     return VK_SAMPLE_COUNT_64_BIT;
@@ -240,4 +412,20 @@ VkSampleCountFlagBits Device::getMaxUsableSampleCount() {
 
   return VK_SAMPLE_COUNT_1_BIT;
 }
-} // namespace VK::Wrapper
\ No newline at end of file
+
+VkSampleCountFlagBits
+Device::GetSupportedSampleCount(VkSampleCountFlagBits requested) {
+  VkPhysicalDeviceProperties props{};
+  vkGetPhysicalDeviceProperties(m_PhysicalDevice, &props);
+
+  VkSampleCountFlags counts = props.limits.framebufferColorSampleCounts &
+                              props.limits.framebufferDepthSampleCounts;
+
+  for (uint32_t samples = requested; samples > 1; samples >>= 1) {
+    if (counts & samples) {
+      return static_cast<VkSampleCountFlagBits>(samples);
+    }
+  }
+  return VK_SAMPLE_COUNT_1_BIT;
+}
+} // namespace VK::Wrapper
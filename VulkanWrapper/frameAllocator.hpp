@@ -0,0 +1,127 @@
+#pragma once
+#include "../base.h"
+#include "buffer.hpp"
+#include "device.hpp"
+
+namespace VK::Wrapper {
+
+// 一次分配得到的切片，m_Offset 可直接作为dynamic offset或bind offset使用
+struct FrameAllocation {
+  VkBuffer m_Buffer{VK_NULL_HANDLE};
+  VkDeviceSize m_Offset{0};
+  VkDeviceSize m_Size{0};
+  void *m_Data{nullptr};
+};
+
+// 每帧的线性(bump)分配器
+// 一整块常驻映射的HOST_VISIBLE buffer，按帧切成frameCount段
+// 每段只在该帧的fence完成之后才会被BeginFrame重置，因此写入时GPU不会再读取它
+class FrameAllocator {
+private:
+  Device::Ptr m_Device{nullptr};
+  Buffer::Ptr m_Buffer{nullptr};
+  uint8_t *m_MappedData{nullptr};
+
+  VkDeviceSize m_FrameSize{0};
+  VkDeviceSize m_Alignment{1};
+  uint32_t m_FrameCount{0};
+  uint32_t m_CurrentFrame{0};
+  // 当前帧段内下一个可用的位置
+  VkDeviceSize m_Head{0};
+  VkDeviceSize m_PeakUsage{0};
+
+public:
+  using Ptr = std::shared_ptr<FrameAllocator>;
+  static Ptr Create(const Device::Ptr &device, VkDeviceSize frameSize,
+                    uint32_t frameCount) {
+    return std::make_shared<FrameAllocator>(device, frameSize, frameCount);
+  }
+
+  FrameAllocator(const Device::Ptr &device, VkDeviceSize frameSize,
+                 uint32_t frameCount);
+  ~FrameAllocator() = default;
+
+  // 调用前必须保证frameIndex对应的fence已经完成
+  void BeginFrame(uint32_t frameIndex);
+
+  // alignment为0时使用uniform buffer的最小对齐，否则必须是2的幂
+  FrameAllocation Allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+  template <typename T> FrameAllocation Push(const T &data) {
+    auto allocation = Allocate(sizeof(T));
+    memcpy(allocation.m_Data, &data, sizeof(T));
+    return allocation;
+  }
+
+  [[nodiscard]] auto &GetBuffer() const { return m_Buffer; }
+  [[nodiscard]] auto GetAlignment() const { return m_Alignment; }
+  [[nodiscard]] auto GetFrameSize() const { return m_FrameSize; }
+  [[nodiscard]] auto GetUsedBytes() const { return m_Head; }
+  [[nodiscard]] auto GetPeakUsage() const { return m_PeakUsage; }
+
+  // 创建之前估算每帧需要多大时用，和Allocate的默认对齐一致
+  static VkDeviceSize QueryAlignment(const Device::Ptr &device) {
+    const auto &limits = device->GetProperties().limits;
+    return std::max<VkDeviceSize>(
+        limits.minUniformBufferOffsetAlignment,
+        std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 16));
+  }
+  static VkDeviceSize GetAlignedSize(const Device::Ptr &device,
+                                     VkDeviceSize size) {
+    return AlignUp(size, QueryAlignment(device));
+  }
+
+private:
+  static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+  }
+};
+
+FrameAllocator::FrameAllocator(const Device::Ptr &device,
+                               VkDeviceSize frameSize, uint32_t frameCount) {
+  m_Device = device;
+  m_FrameCount = frameCount;
+
+  m_Alignment = QueryAlignment(m_Device);
+  // 每一段的起点也要满足对齐，否则dynamic offset会非法
+  m_FrameSize = AlignUp(frameSize, m_Alignment);
+
+  m_Buffer = Buffer::Create(
+      m_Device, m_FrameSize * m_FrameCount,
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+          VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+          VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      0, MemoryCategory::Uniform);
+  m_MappedData = static_cast<uint8_t *>(m_Buffer->Map());
+}
+
+void FrameAllocator::BeginFrame(uint32_t frameIndex) {
+  assert(frameIndex < m_FrameCount);
+  m_CurrentFrame = frameIndex;
+  m_Head = 0;
+}
+
+FrameAllocation FrameAllocator::Allocate(VkDeviceSize size,
+                                         VkDeviceSize alignment) {
+  if (alignment == 0) {
+    alignment = m_Alignment;
+  }
+
+  VkDeviceSize offset = AlignUp(m_Head, alignment);
+  if (offset + size > m_FrameSize) {
+    throw std::runtime_error("Error: frame allocator out of memory");
+  }
+  m_Head = offset + size;
+  m_PeakUsage = std::max(m_PeakUsage, m_Head);
+
+  FrameAllocation allocation{};
+  allocation.m_Buffer = m_Buffer->getBuffer();
+  allocation.m_Offset = m_CurrentFrame * m_FrameSize + offset;
+  allocation.m_Size = size;
+  allocation.m_Data = m_MappedData + allocation.m_Offset;
+  return allocation;
+}
+
+} // namespace VK::Wrapper
@@ -0,0 +1,353 @@
+#pragma once
+#include "../base.h"
+#include "../profiler.hpp"
+#include "commandBuffer.hpp"
+#include "commandPool.hpp"
+#include "device.hpp"
+#include "queryPool.hpp"
+
+namespace VK::Wrapper {
+
+// 一个pass的pipeline statistics，顺序和GpuProfiler::PIPELINE_STATISTICS的位顺序一致
+struct PipelineStatistics {
+  uint64_t m_InputPrimitives{0};
+  uint64_t m_VertexInvocations{0};
+  uint64_t m_ClippingInvocations{0};
+  uint64_t m_ClippingPrimitives{0};
+  uint64_t m_FragmentInvocations{0};
+};
+
+// gpu分段计时
+// 每个帧槽位一个timestamp query pool，scope的开始和结束各写一个timestamp
+// 等完这个槽位的fence再次BeginFrame时不等待地读回上一轮的结果，大约晚frames in
+// flight帧，换算成纳秒后对到cpu的时钟上，补录进Profiler的"gpu"轨道
+// 打开pipeline statistics后，要求统计的scope再用一个统计query包起来，
+// 同一时间只能有一个统计query，嵌套的scope不再统计
+class GpuProfiler {
+public:
+  static constexpr uint32_t MAX_SCOPES_PER_FRAME{64};
+  static constexpr VkQueryPipelineStatisticFlags PIPELINE_STATISTICS{
+      VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+      VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+      VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+      VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+      VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT};
+
+private:
+  struct ScopeRecord {
+    const char *m_Name{nullptr};
+    uint32_t m_Depth{0};
+    // 结束的query就是开始的下一个
+    uint32_t m_Query{0};
+    uint32_t m_StatisticsQuery{UINT32_MAX};
+  };
+
+  struct Slot {
+    QueryPool::Ptr m_QueryPool{nullptr};
+    QueryPool::Ptr m_StatisticsPool{nullptr};
+    uint32_t m_StatisticsCount{0};
+    std::vector<ScopeRecord> m_Scopes{};
+    uint64_t m_FrameId{0};
+    bool m_Pending{false};
+  };
+
+  Device::Ptr m_Device{nullptr};
+  std::vector<Slot> m_Slots{};
+  uint32_t m_Current{0};
+  uint32_t m_Depth{0};
+  uint32_t m_FrameScope{UINT32_MAX};
+  bool m_Supported{false};
+  bool m_StatisticsEnabled{false};
+  bool m_StatisticsActive{false};
+  // 一个tick多少纳秒，以及timestamp的有效位
+  double m_TimestampPeriod{1.0};
+  uint64_t m_TimestampMask{~0ull};
+  // gpu纳秒加上它就是Profiler::Now()的时间
+  int64_t m_ClockOffset{0};
+  uint32_t m_Track{0};
+  std::vector<uint64_t> m_Results{};
+  ProfilerFrameSummary m_LastFrame{};
+  std::vector<std::pair<const char *, PipelineStatistics>> m_LastStatistics{};
+  uint64_t m_DroppedFrames{0};
+
+  void Calibrate(const CommandPool::Ptr &commandPool);
+  void Resolve(Slot &slot);
+  uint64_t ToCpuTime(uint64_t ticks) const;
+
+public:
+  using Ptr = std::shared_ptr<GpuProfiler>;
+  static Ptr Create(const Device::Ptr &device,
+                    const CommandPool::Ptr &commandPool, uint32_t slotCount) {
+    return std::make_shared<GpuProfiler>(device, commandPool, slotCount);
+  }
+
+  GpuProfiler(const Device::Ptr &device, const CommandPool::Ptr &commandPool,
+              uint32_t slotCount);
+  ~GpuProfiler() = default;
+
+  // 图形队列不支持timestamp时所有调用都不做事
+  [[nodiscard]] auto IsSupported() const { return m_Supported; }
+
+  // 设备没有打开pipelineStatisticsQuery时返回false，在两帧之间调用
+  bool SetPipelineStatistics(bool enable);
+  [[nodiscard]] auto IsPipelineStatisticsEnabled() const {
+    return m_StatisticsEnabled;
+  }
+
+  // commandBuffer开始录制后调用，slot对应的fence必须已经等过
+  void BeginFrame(const CommandBuffer::Ptr &commandBuffer, uint32_t slot,
+                  uint64_t frameId);
+  void EndFrame(const CommandBuffer::Ptr &commandBuffer);
+
+  // 名字要一直有效，返回UINT32_MAX表示这一帧的scope已经用完
+  // statistics的scope不能在renderPass里开始、在外面结束
+  uint32_t BeginScope(const CommandBuffer::Ptr &commandBuffer,
+                      const char *name, bool statistics = false);
+  void EndScope(const CommandBuffer::Ptr &commandBuffer, uint32_t scope);
+
+  // 最近一次读回的帧，m_FrameMs是整帧的gpu时间
+  [[nodiscard]] const auto &GetLastFrame() const { return m_LastFrame; }
+  // 和GetLastFrame是同一帧，只有要求统计的scope
+  [[nodiscard]] const auto &GetLastStatistics() const {
+    return m_LastStatistics;
+  }
+  [[nodiscard]] auto GetDroppedFrames() const { return m_DroppedFrames; }
+
+  class Scope {
+  private:
+    GpuProfiler *m_Profiler{nullptr};
+    const CommandBuffer::Ptr &m_CommandBuffer;
+    uint32_t m_Scope{UINT32_MAX};
+
+  public:
+    // profiler可以为空
+    Scope(GpuProfiler *profiler, const CommandBuffer::Ptr &commandBuffer,
+          const char *name, bool statistics = false)
+        : m_Profiler(profiler), m_CommandBuffer(commandBuffer) {
+      if (m_Profiler) {
+        m_Scope = m_Profiler->BeginScope(m_CommandBuffer, name, statistics);
+      }
+    }
+    ~Scope() {
+      if (m_Profiler) {
+        m_Profiler->EndScope(m_CommandBuffer, m_Scope);
+      }
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+};
+
+GpuProfiler::GpuProfiler(const Device::Ptr &device,
+                         const CommandPool::Ptr &commandPool,
+                         uint32_t slotCount) {
+  m_Device = device;
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(m_Device->GetPhysicalDevice(),
+                                           &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(m_Device->GetPhysicalDevice(),
+                                           &familyCount, families.data());
+  const auto validBits =
+      families[m_Device->GetGraphicQueueFamily().value()].timestampValidBits;
+  m_Supported = validBits > 0;
+  if (!m_Supported) {
+    return;
+  }
+  m_TimestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+  m_TimestampPeriod = m_Device->GetProperties().limits.timestampPeriod;
+
+  m_Slots.resize(std::max(1u, slotCount));
+  for (auto &slot : m_Slots) {
+    slot.m_QueryPool = QueryPool::Create(m_Device, VK_QUERY_TYPE_TIMESTAMP,
+                                         MAX_SCOPES_PER_FRAME * 2);
+    slot.m_Scopes.reserve(MAX_SCOPES_PER_FRAME);
+  }
+
+  Calibrate(commandPool);
+  m_Track = Profiler::Get().CreateTrack("gpu");
+}
+
+// 提交一个只写timestamp的commandBuffer，取提交前后cpu时间的中点当作gpu写入的时刻
+// 只在创建时对一次，长时间运行时两个时钟会有少量漂移
+void GpuProfiler::Calibrate(const CommandPool::Ptr &commandPool) {
+  auto &queryPool = m_Slots[0].m_QueryPool;
+  auto commandBuffer = CommandBuffer::Create(m_Device, commandPool);
+  commandBuffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  commandBuffer->ResetQueryPool(queryPool->GetQueryPool(), 0, 1);
+  commandBuffer->WriteTimestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                queryPool->GetQueryPool(), 0);
+  commandBuffer->End();
+
+  const auto before = Profiler::Now();
+  commandBuffer->SubmitSync(m_Device->GetGraphicQueue());
+  const auto after = Profiler::Now();
+
+  if (!queryPool->GetResults(0, 1, m_Results)) {
+    throw std::runtime_error("Error: failed to calibrate gpu timestamps");
+  }
+  const auto gpuTime = static_cast<int64_t>(
+      (m_Results[0] & m_TimestampMask) * m_TimestampPeriod);
+  m_ClockOffset = static_cast<int64_t>(before + (after - before) / 2) - gpuTime;
+}
+
+bool GpuProfiler::SetPipelineStatistics(bool enable) {
+  if (enable && (!m_Supported || !m_Device->IsPipelineStatisticsSupported())) {
+    return false;
+  }
+  // 已经创建的pool不销毁，还在路上的帧可能在用
+  if (enable) {
+    for (auto &slot : m_Slots) {
+      if (!slot.m_StatisticsPool) {
+        slot.m_StatisticsPool =
+            QueryPool::Create(m_Device, VK_QUERY_TYPE_PIPELINE_STATISTICS,
+                              MAX_SCOPES_PER_FRAME, PIPELINE_STATISTICS);
+      }
+    }
+  }
+  m_StatisticsEnabled = enable;
+  return true;
+}
+
+uint64_t GpuProfiler::ToCpuTime(uint64_t ticks) const {
+  return static_cast<uint64_t>(
+      static_cast<int64_t>((ticks & m_TimestampMask) * m_TimestampPeriod) +
+      m_ClockOffset);
+}
+
+void GpuProfiler::BeginFrame(const CommandBuffer::Ptr &commandBuffer,
+                             uint32_t slot, uint64_t frameId) {
+  if (!m_Supported) {
+    return;
+  }
+  m_Current = slot % static_cast<uint32_t>(m_Slots.size());
+  auto &current = m_Slots[m_Current];
+  if (current.m_Pending) {
+    Resolve(current);
+  }
+
+  current.m_Scopes.clear();
+  current.m_StatisticsCount = 0;
+  current.m_FrameId = frameId;
+  current.m_Pending = true;
+  commandBuffer->ResetQueryPool(current.m_QueryPool->GetQueryPool(), 0,
+                                current.m_QueryPool->GetCount());
+  if (m_StatisticsEnabled) {
+    commandBuffer->ResetQueryPool(current.m_StatisticsPool->GetQueryPool(), 0,
+                                  current.m_StatisticsPool->GetCount());
+  }
+  m_Depth = 0;
+  m_StatisticsActive = false;
+  m_FrameScope = BeginScope(commandBuffer, "gpu frame");
+}
+
+void GpuProfiler::EndFrame(const CommandBuffer::Ptr &commandBuffer) {
+  if (!m_Supported) {
+    return;
+  }
+  EndScope(commandBuffer, m_FrameScope);
+  m_FrameScope = UINT32_MAX;
+}
+
+uint32_t GpuProfiler::BeginScope(const CommandBuffer::Ptr &commandBuffer,
+                                 const char *name, bool statistics) {
+  if (!m_Supported) {
+    return UINT32_MAX;
+  }
+  auto &slot = m_Slots[m_Current];
+  if (slot.m_Scopes.size() >= MAX_SCOPES_PER_FRAME) {
+    return UINT32_MAX;
+  }
+  ScopeRecord record{};
+  record.m_Name = name;
+  record.m_Depth = m_Depth++;
+  record.m_Query = static_cast<uint32_t>(slot.m_Scopes.size()) * 2;
+
+  commandBuffer->WriteTimestamp(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                slot.m_QueryPool->GetQueryPool(),
+                                record.m_Query);
+  if (statistics && m_StatisticsEnabled && !m_StatisticsActive) {
+    record.m_StatisticsQuery = slot.m_StatisticsCount++;
+    m_StatisticsActive = true;
+    commandBuffer->BeginQuery(slot.m_StatisticsPool->GetQueryPool(),
+                              record.m_StatisticsQuery);
+  }
+  slot.m_Scopes.push_back(record);
+  return static_cast<uint32_t>(slot.m_Scopes.size()) - 1;
+}
+
+void GpuProfiler::EndScope(const CommandBuffer::Ptr &commandBuffer,
+                           uint32_t scope) {
+  if (!m_Supported || scope == UINT32_MAX) {
+    return;
+  }
+  auto &slot = m_Slots[m_Current];
+  auto &record = slot.m_Scopes[scope];
+  m_Depth = record.m_Depth;
+  if (record.m_StatisticsQuery != UINT32_MAX) {
+    commandBuffer->EndQuery(slot.m_StatisticsPool->GetQueryPool(),
+                            record.m_StatisticsQuery);
+    m_StatisticsActive = false;
+  }
+  commandBuffer->WriteTimestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                slot.m_QueryPool->GetQueryPool(),
+                                record.m_Query + 1);
+}
+
+void GpuProfiler::Resolve(Slot &slot) {
+  slot.m_Pending = false;
+  const auto queryCount = static_cast<uint32_t>(slot.m_Scopes.size()) * 2;
+  // fence已经等过，正常都能拿到，拿不到(比如这一帧没提交)就丢掉
+  if (!slot.m_QueryPool->GetResults(0, queryCount, m_Results)) {
+    ++m_DroppedFrames;
+    return;
+  }
+
+  ProfilerFrameSummary summary{};
+  summary.m_Frame = slot.m_FrameId;
+  std::unordered_map<const char *, size_t> indices{};
+  for (auto &record : slot.m_Scopes) {
+    const auto start = ToCpuTime(m_Results[record.m_Query]);
+    auto end = ToCpuTime(m_Results[record.m_Query + 1]);
+    end = std::max(start, end);
+    Profiler::Get().AddZone(m_Track, record.m_Name, start, end, record.m_Depth,
+                            slot.m_FrameId);
+
+    const auto ms = (end - start) / 1e6;
+    if (record.m_Depth == 0) {
+      summary.m_FrameMs += ms;
+      continue;
+    }
+    auto found = indices.find(record.m_Name);
+    if (found == indices.end()) {
+      found = indices.emplace(record.m_Name, summary.m_ZoneMs.size()).first;
+      summary.m_ZoneMs.push_back({record.m_Name, 0.0});
+    }
+    summary.m_ZoneMs[found->second].second += ms;
+  }
+  m_LastFrame = std::move(summary);
+
+  m_LastStatistics.clear();
+  std::vector<uint64_t> statistics{};
+  if (slot.m_StatisticsCount == 0 ||
+      !slot.m_StatisticsPool->GetResults(0, slot.m_StatisticsCount,
+                                         statistics)) {
+    return;
+  }
+  const auto valueCount = slot.m_StatisticsPool->GetValuesPerQuery();
+  for (auto &record : slot.m_Scopes) {
+    if (record.m_StatisticsQuery == UINT32_MAX) {
+      continue;
+    }
+    const auto *values = &statistics[record.m_StatisticsQuery * valueCount];
+    PipelineStatistics passStatistics{};
+    passStatistics.m_InputPrimitives = values[0];
+    passStatistics.m_VertexInvocations = values[1];
+    passStatistics.m_ClippingInvocations = values[2];
+    passStatistics.m_ClippingPrimitives = values[3];
+    passStatistics.m_FragmentInvocations = values[4];
+    m_LastStatistics.push_back({record.m_Name, passStatistics});
+  }
+}
+} // namespace VK::Wrapper
@@ -16,8 +16,23 @@ private:
   VkDeviceMemory m_ImageMemory{VK_NULL_HANDLE};
   VkImageView m_ImageView{VK_NULL_HANDLE};
   VkFormat m_Format;
+  uint32_t m_MipLevels{1};
+  VkImageAspectFlags m_AspectFlags{0};
+  // 只覆盖部分mip的view，由CreateLevelView创建，析构时一起销毁
+  std::vector<VkImageView> m_LevelViews{};
 
   VkImageLayout m_Layout{VK_IMAGE_LAYOUT_UNDEFINED};
+  bool m_LazilyAllocated{false};
+  // 只统计自己分配的内存，BindMemory绑定外部内存的由调用方统计
+  MemoryCategory m_Category{MemoryCategory::Image};
+  uint32_t m_MemoryTypeIndex{0};
+  VkDeviceSize m_AllocationSize{0};
+  bool TryFindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties,
+                         uint32_t &typeIndex);
+  void CreateImage(const VkImageType &imageType, const VkImageTiling &tiling,
+                   const VkImageUsageFlags &usage,
+                   const VkSampleCountFlagBits &sample);
+  void CreateImageView(const VkImageType &imageType);
   uint32_t findMemoryType(uint32_t typeFilter,
                           VkMemoryPropertyFlags properties);
 
@@ -29,33 +44,98 @@ public:
                     const VkImageUsageFlags &usage,
                     const VkSampleCountFlagBits &sample,
                     const VkMemoryPropertyFlags &properties,
-                    const VkImageAspectFlags &aspectFlags) {
+                    const VkImageAspectFlags &aspectFlags,
+                    const uint32_t &mipLevels = 1,
+                    MemoryCategory category = MemoryCategory::Image) {
     return std::make_shared<Image>(device, width, height, format, imageType,
                                    tiling, usage, sample, properties,
-                                   aspectFlags);
+                                   aspectFlags, mipLevels, category);
   }
   Image(const Device::Ptr &device, const int &width, const int &height,
         const VkFormat &format, const VkImageType &imageType,
         const VkImageTiling &tiling, const VkImageUsageFlags &usage,
         const VkSampleCountFlagBits &sample,
         const VkMemoryPropertyFlags &properties,
+        const VkImageAspectFlags &aspectFlags, const uint32_t &mipLevels = 1,
+        MemoryCategory category = MemoryCategory::Image);
+
+  // 只创建VkImage不分配内存，由调用方(比如RenderGraph做内存复用)BindMemory
+  static Ptr CreateUnbound(const Device::Ptr &device, const int &width,
+                           const int &height, const VkFormat &format,
+                           const VkImageUsageFlags &usage,
+                           const VkSampleCountFlagBits &sample,
+                           const VkImageAspectFlags &aspectFlags) {
+    return std::make_shared<Image>(device, width, height, format, usage,
+                                   sample, aspectFlags);
+  }
+  Image(const Device::Ptr &device, const int &width, const int &height,
+        const VkFormat &format, const VkImageUsageFlags &usage,
+        const VkSampleCountFlagBits &sample,
         const VkImageAspectFlags &aspectFlags);
   ~Image();
 
+  [[nodiscard]] VkMemoryRequirements GetMemoryRequirements() const;
+  // 绑定外部内存并创建view，内存的释放由调用方负责
+  void BindMemory(VkDeviceMemory memory, VkDeviceSize offset);
+  // 给unbound的image分配自己的内存，preferred不可用时只用properties
+  void AllocateMemory(VkMemoryPropertyFlags properties,
+                      VkMemoryPropertyFlags preferred = 0);
+
   void SetImageLayout(VkImageLayout newLayout,
                       VkPipelineStageFlags srcStageMask,
                       VkPipelineStageFlags dstStageMask,
                       VkImageSubresourceRange subresrouceRange,
                       const CommandPool::Ptr &commandPool);
 
+  // 录制到调用方的commandBuffer里，多张image可以共用一次提交
+  void SetImageLayout(const CommandBuffer::Ptr &commandBuffer,
+                      VkImageLayout newLayout,
+                      VkPipelineStageFlags srcStageMask,
+                      VkPipelineStageFlags dstStageMask,
+                      const VkImageSubresourceRange &subresrouceRange);
+
+  // 只生成barrier并记下新layout，由调用方录制到自己的commandBuffer里
+  VkImageMemoryBarrier
+  MakeLayoutBarrier(VkImageLayout newLayout,
+                    const VkImageSubresourceRange &subresrouceRange);
+
   void FillImageData(size_t size, void *pData,
-                     const CommandPool::Ptr &commandPool);
+                     const CommandPool::Ptr &commandPool,
+                     uint32_t mipLevel = 0);
+
+  // 从buffer拷贝到image，image需要已经处于TRANSFER_DST
+  void CopyFromBuffer(const CommandBuffer::Ptr &commandBuffer, VkBuffer buffer,
+                      uint32_t mipLevel = 0, VkDeviceSize bufferOffset = 0);
+  void CopyFromBuffer(const CommandBuffer::Ptr &commandBuffer, VkBuffer buffer,
+                      const std::vector<VkBufferImageCopy> &regions);
+
+  // 格式是否支持用线性blit生成mip
+  bool SupportsBlitMipmaps() const;
+
+  // 所有mip需要处于TRANSFER_DST且第0级已经填好
+  // 格式不支持线性blit时返回false，由调用方在cpu端生成mip
+  bool GenerateMipmaps(const CommandPool::Ptr &commandPool);
+  void GenerateMipmaps(const CommandBuffer::Ptr &commandBuffer);
+
+  VkImageView CreateLevelView(uint32_t baseMipLevel, uint32_t levelCount);
   uint32_t FindMemoryType(uint32_t typeFilter,
                           VkMemoryPropertyFlags properties);
   bool hasStencilComponent(VkFormat format);
   [[nodiscard]] auto GetLayout() { return m_Layout; }
+  // barrier由外部(比如ResourceStateTracker)录制时，同步记录的layout
+  void SetLayout(VkImageLayout layout) { m_Layout = layout; }
+  [[nodiscard]] auto GetAspectFlags() const { return m_AspectFlags; }
   [[nodiscard]] auto GetImage() { return m_Image; }
   [[nodiscard]] auto GetImageView() { return m_ImageView; }
+  [[nodiscard]] auto GetMipLevels() const { return m_MipLevels; }
+  [[nodiscard]] auto GetFormat() const { return m_Format; }
+  [[nodiscard]] auto GetWidth() const { return m_Width; }
+  [[nodiscard]] auto GetHeight() const { return m_Height; }
+  // 内存是否为LAZILY_ALLOCATED(tile gpu上可能根本不占内存)
+  [[nodiscard]] auto IsLazilyAllocated() const { return m_LazilyAllocated; }
+  [[nodiscard]] auto GetCategory() const { return m_Category; }
+  // 只能在AllocateMemory之前调用，保证每次分配只按最终的类别统计一次
+  void SetCategory(MemoryCategory category);
 
 public:
   static Image::Ptr createDepthImage(const Device::Ptr &device,
@@ -64,8 +144,18 @@ public:
 
   static Image::Ptr createRenderTargetImage(const Device::Ptr &device,
                                             const int &width, const int &height,
-                                            VkFormat format);
+                                            VkFormat format,
+                                            VkSampleCountFlagBits samples);
+
+  // 只在一个renderPass内使用、不需要写回内存的attachment(多重采样颜色、深度)
+  // 带TRANSIENT_ATTACHMENT_BIT，设备支持时放在LAZILY_ALLOCATED内存里
+  static Image::Ptr createTransientAttachment(
+      const Device::Ptr &device, const int &width, const int &height,
+      VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples,
+      VkImageAspectFlags aspectFlags);
+  static bool isLazilyAllocatedMemorySupported(const Device::Ptr &device);
   static VkFormat findDepthFormat(const Device::Ptr &device);
+  static uint32_t CalculateMipLevels(uint32_t width, uint32_t height);
   static VkFormat findSupportedFormat(const Device::Ptr &device,
                                       const std::vector<VkFormat> &candidates,
                                       VkImageTiling tiling,
@@ -73,42 +163,133 @@ public:
 };
 uint32_t Image::FindMemoryType(uint32_t typeFilter,
                                VkMemoryPropertyFlags properties) {
+  uint32_t typeIndex = 0;
+  if (TryFindMemoryType(typeFilter, properties, typeIndex)) {
+    return typeIndex;
+  }
+
+  throw std::runtime_error("Error: cannot find the property memory type!");
+}
+
+Image::Image(const Device::Ptr &device, const int &width, const int &height,
+             const VkFormat &format, const VkImageType &imageType,
+             const VkImageTiling &tiling, const VkImageUsageFlags &usage,
+             const VkSampleCountFlagBits &sample,
+             const VkMemoryPropertyFlags &properties,
+             const VkImageAspectFlags &aspectFlags,
+             const uint32_t &mipLevels, MemoryCategory category) {
+  m_Device = device;
+  m_Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  m_Category = category;
+  m_Width = width;
+  m_Height = height;
+  m_Format = format;
+  m_MipLevels = mipLevels;
+  m_AspectFlags = aspectFlags;
+
+  CreateImage(imageType, tiling, usage, sample);
+
+  auto memReq = GetMemoryRequirements();
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memReq.size;
+
+  allocInfo.memoryTypeIndex = FindMemoryType(memReq.memoryTypeBits, properties);
+
+  if (vkAllocateMemory(m_Device->GetDevice(), &allocInfo, nullptr,
+                       &m_ImageMemory) != VK_SUCCESS) {
+    throw std::runtime_error("Error: failed to allocate memory");
+  }
+  m_MemoryTypeIndex = allocInfo.memoryTypeIndex;
+  m_AllocationSize = allocInfo.allocationSize;
+  m_Device->GetMemoryTracker()->Allocate(m_Category, m_MemoryTypeIndex,
+                                         m_AllocationSize);
+
+  vkBindImageMemory(m_Device->GetDevice(), m_Image, m_ImageMemory, 0);
+
+  CreateImageView(imageType);
+}
+
+bool Image::TryFindMemoryType(uint32_t typeFilter,
+                              VkMemoryPropertyFlags properties,
+                              uint32_t &typeIndex) {
   VkPhysicalDeviceMemoryProperties memProps;
   vkGetPhysicalDeviceMemoryProperties(m_Device->GetPhysicalDevice(), &memProps);
 
   for (uint32_t i = 0; i < memProps.memoryTypeCount; ++i) {
     if ((typeFilter & (1 << i)) &&
         ((memProps.memoryTypes[i].propertyFlags & properties) == properties)) {
-      return i;
+      typeIndex = i;
+      return true;
     }
   }
+  return false;
+}
 
-  throw std::runtime_error("Error: cannot find the property memory type!");
+void Image::AllocateMemory(VkMemoryPropertyFlags properties,
+                           VkMemoryPropertyFlags preferred) {
+  if (m_ImageView != VK_NULL_HANDLE) {
+    throw std::runtime_error("Error: image memory is already bound");
+  }
+  auto memReq = GetMemoryRequirements();
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memReq.size;
+
+  if (preferred != 0 &&
+      TryFindMemoryType(memReq.memoryTypeBits, properties | preferred,
+                        allocInfo.memoryTypeIndex)) {
+    m_LazilyAllocated =
+        (preferred & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+  } else {
+    allocInfo.memoryTypeIndex =
+        FindMemoryType(memReq.memoryTypeBits, properties);
+  }
+
+  if (vkAllocateMemory(m_Device->GetDevice(), &allocInfo, nullptr,
+                       &m_ImageMemory) != VK_SUCCESS) {
+    throw std::runtime_error("Error: failed to allocate memory");
+  }
+  m_MemoryTypeIndex = allocInfo.memoryTypeIndex;
+  m_AllocationSize = allocInfo.allocationSize;
+  m_Device->GetMemoryTracker()->Allocate(m_Category, m_MemoryTypeIndex,
+                                         m_AllocationSize);
+
+  BindMemory(m_ImageMemory, 0);
 }
 
 Image::Image(const Device::Ptr &device, const int &width, const int &height,
-             const VkFormat &format, const VkImageType &imageType,
-             const VkImageTiling &tiling, const VkImageUsageFlags &usage,
+             const VkFormat &format, const VkImageUsageFlags &usage,
              const VkSampleCountFlagBits &sample,
-             const VkMemoryPropertyFlags &properties,
              const VkImageAspectFlags &aspectFlags) {
   m_Device = device;
   m_Layout = VK_IMAGE_LAYOUT_UNDEFINED;
   m_Width = width;
   m_Height = height;
   m_Format = format;
+  m_MipLevels = 1;
+  m_AspectFlags = aspectFlags;
 
+  CreateImage(VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL, usage, sample);
+}
+
+void Image::CreateImage(const VkImageType &imageType,
+                        const VkImageTiling &tiling,
+                        const VkImageUsageFlags &usage,
+                        const VkSampleCountFlagBits &sample) {
   VkImageCreateInfo imageCreateInfo{};
   imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-  imageCreateInfo.extent.width = width;
-  imageCreateInfo.extent.height = height;
+  imageCreateInfo.extent.width = m_Width;
+  imageCreateInfo.extent.height = m_Height;
   imageCreateInfo.extent.depth = 1;
-  imageCreateInfo.format = format; // rgb rgba
+  imageCreateInfo.format = m_Format; // rgb rgba
   imageCreateInfo.imageType = imageType;
   imageCreateInfo.tiling = tiling;
   imageCreateInfo.usage = usage; // color depth?
   imageCreateInfo.samples = sample;
-  imageCreateInfo.mipLevels = 1;
+  imageCreateInfo.mipLevels = m_MipLevels;
   imageCreateInfo.arrayLayers = 1;
   imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
   imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -117,33 +298,19 @@ Image::Image(const Device::Ptr &device, const int &width, const int &height,
                     &m_Image) != VK_SUCCESS) {
     throw std::runtime_error("Error:failed to create image");
   }
+}
 
-  VkMemoryRequirements memReq{};
-  vkGetImageMemoryRequirements(m_Device->GetDevice(), m_Image, &memReq);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memReq.size;
-
-  allocInfo.memoryTypeIndex = FindMemoryType(memReq.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(m_Device->GetDevice(), &allocInfo, nullptr,
-                       &m_ImageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("Error: failed to allocate memory");
-  }
-
-  vkBindImageMemory(m_Device->GetDevice(), m_Image, m_ImageMemory, 0);
-
+void Image::CreateImageView(const VkImageType &imageType) {
   VkImageViewCreateInfo imageViewCreateInfo{};
   imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
   imageViewCreateInfo.viewType = imageType == VK_IMAGE_TYPE_2D
                                      ? VK_IMAGE_VIEW_TYPE_2D
                                      : VK_IMAGE_VIEW_TYPE_3D;
-  imageViewCreateInfo.format = format;
+  imageViewCreateInfo.format = m_Format;
   imageViewCreateInfo.image = m_Image;
-  imageViewCreateInfo.subresourceRange.aspectMask = aspectFlags;
+  imageViewCreateInfo.subresourceRange.aspectMask = m_AspectFlags;
   imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-  imageViewCreateInfo.subresourceRange.levelCount = 1;
+  imageViewCreateInfo.subresourceRange.levelCount = m_MipLevels;
   imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
   imageViewCreateInfo.subresourceRange.layerCount = 1;
 
@@ -152,13 +319,36 @@ Image::Image(const Device::Ptr &device, const int &width, const int &height,
     throw std::runtime_error("Error: failed to create image view");
   }
 }
+
+VkMemoryRequirements Image::GetMemoryRequirements() const {
+  VkMemoryRequirements memReq{};
+  vkGetImageMemoryRequirements(m_Device->GetDevice(), m_Image, &memReq);
+  return memReq;
+}
+
+void Image::BindMemory(VkDeviceMemory memory, VkDeviceSize offset) {
+  if (m_ImageView != VK_NULL_HANDLE) {
+    throw std::runtime_error("Error: image memory is already bound");
+  }
+  if (vkBindImageMemory(m_Device->GetDevice(), m_Image, memory, offset) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("Error: failed to bind image memory");
+  }
+  CreateImageView(VK_IMAGE_TYPE_2D);
+}
 Image::~Image() {
+  for (auto levelView : m_LevelViews) {
+    vkDestroyImageView(m_Device->GetDevice(), levelView, nullptr);
+  }
+
   if (m_ImageView != VK_NULL_HANDLE) {
     vkDestroyImageView(m_Device->GetDevice(), m_ImageView, nullptr);
   }
 
   if (m_ImageMemory != VK_NULL_HANDLE) {
     vkFreeMemory(m_Device->GetDevice(), m_ImageMemory, nullptr);
+    m_Device->GetMemoryTracker()->Free(m_Category, m_MemoryTypeIndex,
+                                       m_AllocationSize);
   }
 
   if (m_Image != VK_NULL_HANDLE) {
@@ -166,13 +356,42 @@ Image::~Image() {
   }
 }
 
+void Image::SetCategory(MemoryCategory category) {
+  if (m_ImageMemory != VK_NULL_HANDLE) {
+    throw std::runtime_error(
+        "Error: image memory category must be set before allocation");
+  }
+  m_Category = category;
+}
+
 // 使用barrier修改image格式
 void Image::SetImageLayout(VkImageLayout newLayout,
                            VkPipelineStageFlags srcStageMask,
                            VkPipelineStageFlags dstStageMask,
                            VkImageSubresourceRange subresrouceRange,
                            const CommandPool::Ptr &commandPool) {
+  auto commandBuffer = Wrapper::CommandBuffer::Create(m_Device, commandPool);
+  commandBuffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  SetImageLayout(commandBuffer, newLayout, srcStageMask, dstStageMask,
+                 subresrouceRange);
+  commandBuffer->End();
 
+  commandBuffer->SubmitSync(m_Device->GetGraphicQueue());
+}
+
+void Image::SetImageLayout(const CommandBuffer::Ptr &commandBuffer,
+                           VkImageLayout newLayout,
+                           VkPipelineStageFlags srcStageMask,
+                           VkPipelineStageFlags dstStageMask,
+                           const VkImageSubresourceRange &subresrouceRange) {
+  auto imageMemoryBarrier = MakeLayoutBarrier(newLayout, subresrouceRange);
+  commandBuffer->TransferImageLayout(imageMemoryBarrier, srcStageMask,
+                                     dstStageMask);
+}
+
+VkImageMemoryBarrier
+Image::MakeLayoutBarrier(VkImageLayout newLayout,
+                         const VkImageSubresourceRange &subresrouceRange) {
   VkImageMemoryBarrier imageMemoryBarrier{};
   imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
   imageMemoryBarrier.oldLayout = m_Layout;
@@ -218,31 +437,161 @@ void Image::SetImageLayout(VkImageLayout newLayout,
   }
 
   m_Layout = newLayout;
-
-  auto commandBuffer = Wrapper::CommandBuffer::Create(m_Device, commandPool);
-  commandBuffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-  commandBuffer->TransferImageLayout(imageMemoryBarrier, srcStageMask,
-                                     dstStageMask);
-  commandBuffer->End();
-
-  commandBuffer->SubmitSync(m_Device->GetGraphicQueue());
+  return imageMemoryBarrier;
 }
 // 填充该image内容
 void Image::FillImageData(size_t size, void *pData,
-                          const CommandPool::Ptr &commandPool) {
+                          const CommandPool::Ptr &commandPool,
+                          uint32_t mipLevel) {
   assert(pData);
   assert(size);
+  assert(mipLevel < m_MipLevels);
 
   auto stageBuffer = Buffer::CreateStageBuffer(m_Device, size, pData);
 
   auto commandBuffer = CommandBuffer::Create(m_Device, commandPool);
   commandBuffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-  commandBuffer->CopyBufferToImage(stageBuffer->getBuffer(), m_Image, m_Layout,
-                                   m_Width, m_Height);
+  CopyFromBuffer(commandBuffer, stageBuffer->getBuffer(), mipLevel);
   commandBuffer->End();
 
   commandBuffer->SubmitSync(m_Device->GetGraphicQueue());
 }
+
+void Image::CopyFromBuffer(const CommandBuffer::Ptr &commandBuffer,
+                           VkBuffer buffer, uint32_t mipLevel,
+                           VkDeviceSize bufferOffset) {
+  assert(mipLevel < m_MipLevels);
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = bufferOffset;
+  region.imageSubresource.aspectMask = m_AspectFlags;
+  region.imageSubresource.mipLevel = mipLevel;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {
+      std::max<uint32_t>(1, static_cast<uint32_t>(m_Width) >> mipLevel),
+      std::max<uint32_t>(1, static_cast<uint32_t>(m_Height) >> mipLevel), 1};
+
+  CopyFromBuffer(commandBuffer, buffer, {region});
+}
+
+void Image::CopyFromBuffer(const CommandBuffer::Ptr &commandBuffer,
+                           VkBuffer buffer,
+                           const std::vector<VkBufferImageCopy> &regions) {
+  assert(m_Layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  commandBuffer->CopyBufferToImage(buffer, m_Image, m_Layout, regions);
+}
+
+// 用vkCmdBlitImage逐级缩小：第i-1级转成TRANSFER_SRC，blit到第i级
+// 每一级用完后立即转成SHADER_READ_ONLY
+bool Image::SupportsBlitMipmaps() const {
+  return m_Device->IsFormatSupported(
+      m_Format, VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+}
+
+bool Image::GenerateMipmaps(const CommandPool::Ptr &commandPool) {
+  if (!SupportsBlitMipmaps()) {
+    return false;
+  }
+
+  auto commandBuffer = CommandBuffer::Create(m_Device, commandPool);
+  commandBuffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  GenerateMipmaps(commandBuffer);
+  commandBuffer->End();
+  commandBuffer->SubmitSync(m_Device->GetGraphicQueue());
+  return true;
+}
+
+void Image::GenerateMipmaps(const CommandBuffer::Ptr &commandBuffer) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.image = m_Image;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.subresourceRange.aspectMask = m_AspectFlags;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.subresourceRange.levelCount = 1;
+
+  int32_t mipWidth = static_cast<int32_t>(m_Width);
+  int32_t mipHeight = static_cast<int32_t>(m_Height);
+
+  for (uint32_t i = 1; i < m_MipLevels; ++i) {
+    // 上一级写完之后才能作为blit的源
+    barrier.subresourceRange.baseMipLevel = i - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    commandBuffer->TransferImageLayout(barrier, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                       VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    int32_t nextWidth = std::max(1, mipWidth / 2);
+    int32_t nextHeight = std::max(1, mipHeight / 2);
+
+    VkImageBlit blit{};
+    blit.srcOffsets[0] = {0, 0, 0};
+    blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+    blit.srcSubresource.aspectMask = m_AspectFlags;
+    blit.srcSubresource.mipLevel = i - 1;
+    blit.srcSubresource.baseArrayLayer = 0;
+    blit.srcSubresource.layerCount = 1;
+    blit.dstOffsets[0] = {0, 0, 0};
+    blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+    blit.dstSubresource.aspectMask = m_AspectFlags;
+    blit.dstSubresource.mipLevel = i;
+    blit.dstSubresource.baseArrayLayer = 0;
+    blit.dstSubresource.layerCount = 1;
+    commandBuffer->BlitImage(m_Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                             m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             blit, VK_FILTER_LINEAR);
+
+    // 上一级已经不会再被读写，可以交给shader了
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    commandBuffer->TransferImageLayout(barrier, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    mipWidth = nextWidth;
+    mipHeight = nextHeight;
+  }
+
+  // 最后一级只被写过
+  barrier.subresourceRange.baseMipLevel = m_MipLevels - 1;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  commandBuffer->TransferImageLayout(barrier, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+  m_Layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+VkImageView Image::CreateLevelView(uint32_t baseMipLevel,
+                                   uint32_t levelCount) {
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = m_Image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = m_Format;
+  viewInfo.subresourceRange.aspectMask = m_AspectFlags;
+  viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
+  viewInfo.subresourceRange.levelCount = levelCount;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  VkImageView levelView{VK_NULL_HANDLE};
+  if (vkCreateImageView(m_Device->GetDevice(), &viewInfo, nullptr,
+                        &levelView) != VK_SUCCESS) {
+    throw std::runtime_error("Error: failed to create image level view");
+  }
+  m_LevelViews.push_back(levelView);
+  return levelView;
+}
 Image::Ptr Image::createDepthImage(const Device::Ptr &device, const int &width,
                                    const int &height,
                                    VkSampleCountFlagBits samples) {
@@ -256,23 +605,56 @@ Image::Ptr Image::createDepthImage(const Device::Ptr &device, const int &width,
       findSupportedFormat(device, formats, VK_IMAGE_TILING_OPTIMAL,
                           VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 
-  return Image::Create(
+  auto image = Image::Create(
       device, width, height, resultFormat, VK_IMAGE_TYPE_2D,
       VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-      samples, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+      samples, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_ASPECT_DEPTH_BIT,
+      1, MemoryCategory::RenderTarget);
+  return image;
 }
 Image::Ptr Image::createRenderTargetImage(const Device::Ptr &device,
                                           const int &width, const int &height,
-                                          VkFormat format) {
-  return Image::Create(
+                                          VkFormat format,
+                                          VkSampleCountFlagBits samples) {
+  auto image = Image::Create(
 
       device, width, height, format, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL,
 
-      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, device->getMaxUsableSampleCount(),
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, samples,
 
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 
-      VK_IMAGE_ASPECT_COLOR_BIT);
+      VK_IMAGE_ASPECT_COLOR_BIT, 1, MemoryCategory::RenderTarget);
+  return image;
+}
+
+Image::Ptr Image::createTransientAttachment(
+    const Device::Ptr &device, const int &width, const int &height,
+    VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples,
+    VkImageAspectFlags aspectFlags) {
+  // transient image只能和attachment类的usage组合
+  usage &= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+           VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+           VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+  auto image = Image::CreateUnbound(
+      device, width, height, format,
+      usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, samples, aspectFlags);
+  image->SetCategory(MemoryCategory::RenderTarget);
+  image->AllocateMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+  return image;
+}
+
+bool Image::isLazilyAllocatedMemorySupported(const Device::Ptr &device) {
+  VkPhysicalDeviceMemoryProperties memProps;
+  vkGetPhysicalDeviceMemoryProperties(device->GetPhysicalDevice(), &memProps);
+  for (uint32_t i = 0; i < memProps.memoryTypeCount; ++i) {
+    if (memProps.memoryTypes[i].propertyFlags &
+        VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+      return true;
+    }
+  }
+  return false;
 }
 
 VkFormat Image::findDepthFormat(const Device::Ptr &device) {
@@ -285,6 +667,16 @@ VkFormat Image::findDepthFormat(const Device::Ptr &device) {
   return findSupportedFormat(device, formats, VK_IMAGE_TILING_OPTIMAL,
                              VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 }
+uint32_t Image::CalculateMipLevels(uint32_t width, uint32_t height) {
+  uint32_t levels = 1;
+  uint32_t size = std::max(width, height);
+  while (size > 1) {
+    size >>= 1;
+    levels++;
+  }
+  return levels;
+}
+
 VkFormat Image::findSupportedFormat(const Device::Ptr &device,
                                     const std::vector<VkFormat> &candidates,
                                     VkImageTiling tiling,
@@ -309,8 +701,8 @@ VkFormat Image::findSupportedFormat(const Device::Ptr &device,
   throw std::runtime_error("Error: can not find proper format");
 }
 bool Image::hasStencilComponent(VkFormat format) {
-  return m_Format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
-         m_Format == VK_FORMAT_D24_UNORM_S8_UINT;
+  return format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+         format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
 } // namespace VK::Wrapper
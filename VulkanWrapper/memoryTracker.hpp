@@ -0,0 +1,202 @@
+#pragma once
+#include "../base.h"
+#include <iostream>
+#include <mutex>
+#include <ostream>
+
+namespace VK::Wrapper {
+
+// 分配由谁发起，Buffer/Image创建时给默认值，上层(Texture、Model等)再改
+enum class MemoryCategory : uint32_t {
+  Buffer,
+  Model,
+  Uniform,
+  Staging,
+  Readback,
+  Image,
+  Texture,
+  RenderTarget,
+  // 驱动内部分配，大小拿不到，只记个数
+  DescriptorPool,
+  Count,
+};
+
+struct MemoryStats {
+  VkDeviceSize m_LiveBytes{0};
+  VkDeviceSize m_PeakBytes{0};
+  uint32_t m_Count{0};
+  uint32_t m_PeakCount{0};
+};
+
+// 引擎自己发起的显存分配按类别和堆统计，驱动和swapchain的不在里面
+// 多个线程都可能创建buffer，所有接口都加锁，分配本身不频繁
+class MemoryTracker {
+public:
+  // 不属于任何堆的分配(descriptorPool)
+  static constexpr uint32_t NO_MEMORY_TYPE = UINT32_MAX;
+
+private:
+  static constexpr size_t CATEGORY_COUNT =
+      static_cast<size_t>(MemoryCategory::Count);
+
+  mutable std::mutex m_Mutex{};
+  VkPhysicalDeviceMemoryProperties m_MemoryProperties{};
+  MemoryStats m_Categories[CATEGORY_COUNT]{};
+  MemoryStats m_Heaps[VK_MAX_MEMORY_HEAPS]{};
+  MemoryStats m_Total{};
+
+public:
+  using Ptr = std::shared_ptr<MemoryTracker>;
+  static Ptr Create(VkPhysicalDevice physicalDevice) {
+    return std::make_shared<MemoryTracker>(physicalDevice);
+  }
+
+  MemoryTracker(VkPhysicalDevice physicalDevice);
+  ~MemoryTracker() = default;
+
+  void Allocate(MemoryCategory category, uint32_t memoryTypeIndex,
+                VkDeviceSize size);
+  void Free(MemoryCategory category, uint32_t memoryTypeIndex,
+            VkDeviceSize size);
+
+  [[nodiscard]] MemoryStats GetCategoryStats(MemoryCategory category) const;
+  [[nodiscard]] MemoryStats GetHeapStats(uint32_t heapIndex) const;
+  [[nodiscard]] MemoryStats GetTotalStats() const;
+  [[nodiscard]] auto GetHeapCount() const {
+    return m_MemoryProperties.memoryHeapCount;
+  }
+
+  void WriteJson(std::ostream &out) const;
+
+  static const char *GetCategoryName(MemoryCategory category);
+
+private:
+  static void Add(MemoryStats &stats, VkDeviceSize size);
+  // 释放的比记录的多说明有分配没有登记或者释放了两次，报告之后按0截断
+  static void Remove(MemoryStats &stats, VkDeviceSize size,
+                     const std::string &where);
+  static void WriteStats(std::ostream &out, const MemoryStats &stats);
+};
+
+MemoryTracker::MemoryTracker(VkPhysicalDevice physicalDevice) {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+}
+
+void MemoryTracker::Add(MemoryStats &stats, VkDeviceSize size) {
+  stats.m_LiveBytes += size;
+  stats.m_Count++;
+  stats.m_PeakBytes = std::max(stats.m_PeakBytes, stats.m_LiveBytes);
+  stats.m_PeakCount = std::max(stats.m_PeakCount, stats.m_Count);
+}
+
+void MemoryTracker::Remove(MemoryStats &stats, VkDeviceSize size,
+                           const std::string &where) {
+  if (size > stats.m_LiveBytes || stats.m_Count == 0) {
+    std::cerr << "Error: memory tracker freed " << size << " bytes from "
+              << where << " but only " << stats.m_LiveBytes << " bytes in "
+              << stats.m_Count << " allocations are tracked" << std::endl;
+  }
+  stats.m_LiveBytes -= std::min(stats.m_LiveBytes, size);
+  stats.m_Count -= std::min(stats.m_Count, 1u);
+}
+
+void MemoryTracker::Allocate(MemoryCategory category, uint32_t memoryTypeIndex,
+                             VkDeviceSize size) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Add(m_Categories[static_cast<size_t>(category)], size);
+  if (memoryTypeIndex == NO_MEMORY_TYPE) {
+    return;
+  }
+  Add(m_Heaps[m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex],
+      size);
+  Add(m_Total, size);
+}
+
+void MemoryTracker::Free(MemoryCategory category, uint32_t memoryTypeIndex,
+                         VkDeviceSize size) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Remove(m_Categories[static_cast<size_t>(category)], size,
+         std::string("category ") + GetCategoryName(category));
+  if (memoryTypeIndex == NO_MEMORY_TYPE) {
+    return;
+  }
+  const uint32_t heapIndex =
+      m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+  Remove(m_Heaps[heapIndex], size,
+         "heap " + std::to_string(heapIndex) + " (memory type " +
+             std::to_string(memoryTypeIndex) + ")");
+  Remove(m_Total, size, "total");
+}
+
+MemoryStats MemoryTracker::GetCategoryStats(MemoryCategory category) const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Categories[static_cast<size_t>(category)];
+}
+
+MemoryStats MemoryTracker::GetHeapStats(uint32_t heapIndex) const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return heapIndex < VK_MAX_MEMORY_HEAPS ? m_Heaps[heapIndex] : MemoryStats{};
+}
+
+MemoryStats MemoryTracker::GetTotalStats() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Total;
+}
+
+const char *MemoryTracker::GetCategoryName(MemoryCategory category) {
+  switch (category) {
+  case MemoryCategory::Buffer:
+    return "buffer";
+  case MemoryCategory::Model:
+    return "model";
+  case MemoryCategory::Uniform:
+    return "uniform";
+  case MemoryCategory::Staging:
+    return "staging";
+  case MemoryCategory::Readback:
+    return "readback";
+  case MemoryCategory::Image:
+    return "image";
+  case MemoryCategory::Texture:
+    return "texture";
+  case MemoryCategory::RenderTarget:
+    return "render_target";
+  case MemoryCategory::DescriptorPool:
+    return "descriptor_pool";
+  default:
+    return "unknown";
+  }
+}
+
+void MemoryTracker::WriteStats(std::ostream &out, const MemoryStats &stats) {
+  out << "\"live_bytes\": " << stats.m_LiveBytes
+      << ", \"peak_bytes\": " << stats.m_PeakBytes
+      << ", \"count\": " << stats.m_Count
+      << ", \"peak_count\": " << stats.m_PeakCount;
+}
+
+void MemoryTracker::WriteJson(std::ostream &out) const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  out << "{\"total\": {";
+  WriteStats(out, m_Total);
+  out << "}, \"categories\": {";
+  for (size_t i = 0; i < CATEGORY_COUNT; ++i) {
+    out << (i ? ", " : "") << "\""
+        << GetCategoryName(static_cast<MemoryCategory>(i)) << "\": {";
+    WriteStats(out, m_Categories[i]);
+    out << "}";
+  }
+  out << "}, \"heaps\": [";
+  for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; ++i) {
+    const auto &heap = m_MemoryProperties.memoryHeaps[i];
+    out << (i ? ", " : "") << "{\"index\": " << i
+        << ", \"size\": " << heap.size << ", \"device_local\": "
+        << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false")
+        << ", ";
+    WriteStats(out, m_Heaps[i]);
+    out << "}";
+  }
+  out << "]}";
+}
+
+} // namespace VK::Wrapper
@@ -16,6 +16,12 @@ private:
 
   std::vector<VkViewport> m_Viewports{};
   std::vector<VkRect2D> m_Scissors{};
+  // 录制时再设置的状态，比如视口和裁剪，尺寸变化时不用重建pipeline
+  std::vector<VkDynamicState> m_DynamicStates{};
+
+  // 多个set以及push constant时，createInfo里的指针指向这里
+  std::vector<VkDescriptorSetLayout> m_SetLayouts{};
+  std::vector<VkPushConstantRange> m_PushConstantRanges{};
 
 public:
   using Ptr = std::shared_ptr<Pipeline>;
@@ -40,7 +46,11 @@ public:
 
   void Make_Raster_Info();
 
-  void Make_MultiSample_Info();
+  // 采样数要和renderPass的attachment一致
+  // sampleShading需要设备的sampleRateShading特性，不支持时忽略
+  void Make_MultiSample_Info(VkSampleCountFlagBits samples,
+                             bool sampleShading = false,
+                             float minSampleShading = 1.0f);
 
   void Make_BlendAttachment_Info();
 
@@ -50,6 +60,10 @@ public:
 
   void Make_LayoutCreate_Info(VkDescriptorSetLayout &layout);
 
+  void Make_LayoutCreate_Info(
+      const std::vector<VkDescriptorSetLayout> &layouts,
+      const std::vector<VkPushConstantRange> &pushConstantRanges);
+
   void SetShaderGroup(const std::vector<Shader::Ptr> &shaderGroup) {
     m_Shaders = shaderGroup;
   }
@@ -62,6 +76,11 @@ public:
     m_Scissors = scissors;
   }
 
+  // 动态视口/裁剪时SetViewports/SetScissors只用来确定个数
+  void SetDynamicStates(const std::vector<VkDynamicState> &dynamicStates) {
+    m_DynamicStates = dynamicStates;
+  }
+
   void PushBlendAttachment(
       const VkPipelineColorBlendAttachmentState &blendAttachment) {
     m_BlendAttachment.push_back(blendAttachment);
@@ -122,7 +141,9 @@ void Pipeline::Make_Raster_Info() {
   m_Rasterizer.depthBiasSlopeFactor = 0.0f;
 }
 
-void Pipeline::Make_MultiSample_Info() {
+void Pipeline::Make_MultiSample_Info(VkSampleCountFlagBits samples,
+                                     bool sampleShading,
+                                     float minSampleShading) {
   m_Multisampling.sType =
       VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
   // m_Multisampling.sampleShadingEnable = VK_FALSE;
@@ -132,9 +153,13 @@ void Pipeline::Make_MultiSample_Info() {
   // m_Multisampling.alphaToCoverageEnable = VK_FALSE;
   // m_Multisampling.alphaToOneEnable = VK_FALSE;
 
-  m_Multisampling.sampleShadingEnable = VK_FALSE;
-  m_Multisampling.rasterizationSamples = m_Device->getMaxUsableSampleCount();
-  m_Multisampling.minSampleShading = 1.0f;
+  const bool enableSampleShading = sampleShading &&
+                                   samples != VK_SAMPLE_COUNT_1_BIT &&
+                                   m_Device->IsSampleRateShadingSupported();
+  m_Multisampling.sampleShadingEnable =
+      enableSampleShading ? VK_TRUE : VK_FALSE;
+  m_Multisampling.rasterizationSamples = samples;
+  m_Multisampling.minSampleShading = minSampleShading;
   m_Multisampling.pSampleMask = nullptr;
   m_Multisampling.alphaToCoverageEnable = VK_FALSE;
   m_Multisampling.alphaToOneEnable = VK_FALSE;
@@ -182,6 +207,20 @@ void Pipeline::Make_LayoutCreate_Info(VkDescriptorSetLayout &layout) {
   m_LayoutState.pPushConstantRanges = nullptr;
 }
 
+void Pipeline::Make_LayoutCreate_Info(
+    const std::vector<VkDescriptorSetLayout> &layouts,
+    const std::vector<VkPushConstantRange> &pushConstantRanges) {
+  m_SetLayouts = layouts;
+  m_PushConstantRanges = pushConstantRanges;
+
+  m_LayoutState.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  m_LayoutState.setLayoutCount = static_cast<uint32_t>(m_SetLayouts.size());
+  m_LayoutState.pSetLayouts = m_SetLayouts.data();
+  m_LayoutState.pushConstantRangeCount =
+      static_cast<uint32_t>(m_PushConstantRanges.size());
+  m_LayoutState.pPushConstantRanges = m_PushConstantRanges.data();
+}
+
 Pipeline::Pipeline(const Device::Ptr &device,
                    const RenderPass::Ptr &renderPass) {
   m_Device = device;
@@ -235,6 +274,14 @@ void Pipeline::Build() {
   // stencil
   pipelineCreateInfo.pColorBlendState = &m_BlendState;
 
+  VkPipelineDynamicStateCreateInfo dynamicState{};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount =
+      static_cast<uint32_t>(m_DynamicStates.size());
+  dynamicState.pDynamicStates = m_DynamicStates.data();
+  pipelineCreateInfo.pDynamicState =
+      m_DynamicStates.empty() ? nullptr : &dynamicState;
+
   pipelineCreateInfo.layout = m_Layout;
   pipelineCreateInfo.renderPass = m_RenderPass->GetRenderPass();
   pipelineCreateInfo.subpass = 0;
@@ -0,0 +1,86 @@
+#pragma once
+#include "../base.h"
+#include "device.hpp"
+
+namespace VK::Wrapper {
+class QueryPool {
+private:
+  VkQueryPool m_QueryPool{VK_NULL_HANDLE};
+  Device::Ptr m_Device{nullptr};
+  VkQueryType m_Type{VK_QUERY_TYPE_TIMESTAMP};
+  uint32_t m_Count{0};
+  // 每个query返回几个值，pipeline statistics每打开一个统计项多一个
+  uint32_t m_ValuesPerQuery{1};
+
+public:
+  using Ptr = std::shared_ptr<QueryPool>;
+  static Ptr Create(const Device::Ptr &device, VkQueryType type,
+                    uint32_t count,
+                    VkQueryPipelineStatisticFlags statistics = 0) {
+    return std::make_shared<QueryPool>(device, type, count, statistics);
+  }
+
+  QueryPool(const Device::Ptr &device, VkQueryType type, uint32_t count,
+            VkQueryPipelineStatisticFlags statistics = 0);
+  ~QueryPool();
+
+  [[nodiscard]] auto GetQueryPool() const { return m_QueryPool; }
+  [[nodiscard]] auto GetType() const { return m_Type; }
+  [[nodiscard]] auto GetCount() const { return m_Count; }
+  [[nodiscard]] auto GetValuesPerQuery() const { return m_ValuesPerQuery; }
+
+  // 不等待，有query还没完成时返回false，results按query依次排列
+  bool GetResults(uint32_t first, uint32_t count,
+                  std::vector<uint64_t> &results) const;
+};
+
+QueryPool::QueryPool(const Device::Ptr &device, VkQueryType type,
+                     uint32_t count, VkQueryPipelineStatisticFlags statistics) {
+  m_Device = device;
+  m_Type = type;
+  m_Count = count;
+  if (type == VK_QUERY_TYPE_PIPELINE_STATISTICS) {
+    m_ValuesPerQuery = 0;
+    for (auto bits = statistics; bits != 0; bits &= bits - 1) {
+      ++m_ValuesPerQuery;
+    }
+  }
+
+  VkQueryPoolCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  createInfo.queryType = type;
+  createInfo.queryCount = count;
+  createInfo.pipelineStatistics = statistics;
+
+  if (vkCreateQueryPool(m_Device->GetDevice(), &createInfo, nullptr,
+                        &m_QueryPool) != VK_SUCCESS) {
+    throw std::runtime_error("Error: failed to create query pool");
+  }
+}
+
+QueryPool::~QueryPool() {
+  if (m_QueryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(m_Device->GetDevice(), m_QueryPool, nullptr);
+  }
+}
+
+bool QueryPool::GetResults(uint32_t first, uint32_t count,
+                           std::vector<uint64_t> &results) const {
+  results.resize(static_cast<size_t>(count) * m_ValuesPerQuery);
+  if (count == 0) {
+    return true;
+  }
+  const auto stride = sizeof(uint64_t) * m_ValuesPerQuery;
+  auto result = vkGetQueryPoolResults(
+      m_Device->GetDevice(), m_QueryPool, first, count,
+      results.size() * sizeof(uint64_t), results.data(), stride,
+      VK_QUERY_RESULT_64_BIT);
+  if (result == VK_NOT_READY) {
+    return false;
+  }
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("Error: failed to get query pool results");
+  }
+  return true;
+}
+} // namespace VK::Wrapper
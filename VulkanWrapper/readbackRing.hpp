@@ -0,0 +1,205 @@
+#pragma once
+#include "../base.h"
+#include "buffer.hpp"
+#include "commandBuffer.hpp"
+#include "device.hpp"
+#include "resourceStateTracker.hpp"
+#include <functional>
+
+namespace VK::Wrapper {
+
+// 交给回调的一帧像素，data只在回调期间有效
+struct ReadbackFrame {
+  uint64_t m_FrameId{0};
+  uint32_t m_Width{0};
+  uint32_t m_Height{0};
+  VkFormat m_Format{VK_FORMAT_UNDEFINED};
+  const void *m_Data{nullptr};
+  VkDeviceSize m_Size{0};
+};
+
+struct ReadbackRingStats {
+  uint64_t m_Recorded{0};
+  uint64_t m_Delivered{0};
+  // 环里所有槽位都还没完成时直接丢帧，不阻塞渲染
+  uint64_t m_Dropped{0};
+};
+
+// 帧回读环
+// 每个槽位一个HOST_CACHED的回读buffer，拷贝录制在这一帧自己的commandBuffer里，
+// 用这一帧提交时的fence判断完成，完成后按帧的顺序交给回调，大约晚slotCount帧
+// Poll要在等完这一帧的fence之后、ResetFence之前调用，否则槽位的fence可能先被重置
+class ReadbackRing {
+public:
+  using Callback = std::function<void(const ReadbackFrame &)>;
+
+private:
+  struct Slot {
+    Buffer::Ptr m_Buffer{nullptr};
+    VkFence m_Fence{VK_NULL_HANDLE};
+    uint64_t m_FrameId{0};
+    bool m_Pending{false};
+  };
+
+  Device::Ptr m_Device{nullptr};
+  uint32_t m_Width{0};
+  uint32_t m_Height{0};
+  VkFormat m_Format{VK_FORMAT_UNDEFINED};
+  VkDeviceSize m_FrameSize{0};
+  std::vector<Slot> m_Slots{};
+  // 下一次写入的槽位和最早还没交付的槽位
+  uint32_t m_Next{0};
+  uint32_t m_Oldest{0};
+  Callback m_Callback{};
+  ReadbackRingStats m_Stats{};
+
+  void Deliver(Slot &slot);
+
+public:
+  using Ptr = std::shared_ptr<ReadbackRing>;
+  static Ptr Create(const Device::Ptr &device, uint32_t width, uint32_t height,
+                    VkFormat format, uint32_t slotCount, Callback callback) {
+    return std::make_shared<ReadbackRing>(device, width, height, format,
+                                          slotCount, std::move(callback));
+  }
+
+  ReadbackRing(const Device::Ptr &device, uint32_t width, uint32_t height,
+               VkFormat format, uint32_t slotCount, Callback callback);
+  ~ReadbackRing() = default;
+
+  // 录制image到下一个槽位的拷贝，usage是image当前(也是拷贝之后恢复)的用途
+  // fence是这个commandBuffer提交时带的fence，返回false表示这一帧被丢掉
+  bool Record(const CommandBuffer::Ptr &commandBuffer, VkImage image,
+              ResourceUsage usage, VkFence fence, uint64_t frameId);
+
+  // 交付所有已经完成的帧，不等待
+  void Poll();
+
+  // 等待并交付所有还在路上的帧，退出前调用
+  void Drain();
+
+  [[nodiscard]] auto GetSlotCount() const {
+    return static_cast<uint32_t>(m_Slots.size());
+  }
+  [[nodiscard]] auto &GetStats() const { return m_Stats; }
+
+  static VkDeviceSize GetPixelSize(VkFormat format);
+};
+
+ReadbackRing::ReadbackRing(const Device::Ptr &device, uint32_t width,
+                           uint32_t height, VkFormat format,
+                           uint32_t slotCount, Callback callback) {
+  if (slotCount == 0) {
+    throw std::runtime_error("Error: readback ring needs at least one slot");
+  }
+  m_Device = device;
+  m_Width = width;
+  m_Height = height;
+  m_Format = format;
+  m_Callback = std::move(callback);
+  m_FrameSize = GetPixelSize(format) * width * height;
+
+  m_Slots.resize(slotCount);
+  for (auto &slot : m_Slots) {
+    slot.m_Buffer = Buffer::CreateReadbackBuffer(m_Device, m_FrameSize);
+    // 一直映射着，每帧不用重新map
+    slot.m_Buffer->Map();
+  }
+}
+
+VkDeviceSize ReadbackRing::GetPixelSize(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+  case VK_FORMAT_B8G8R8A8_UNORM:
+  case VK_FORMAT_B8G8R8A8_SRGB:
+  case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+    return 4;
+  case VK_FORMAT_R16G16B16A16_SFLOAT:
+    return 8;
+  case VK_FORMAT_R32G32B32A32_SFLOAT:
+    return 16;
+  default:
+    throw std::runtime_error("Error: unsupported readback format");
+  }
+}
+
+bool ReadbackRing::Record(const CommandBuffer::Ptr &commandBuffer,
+                          VkImage image, ResourceUsage usage, VkFence fence,
+                          uint64_t frameId) {
+  auto &slot = m_Slots[m_Next];
+  if (slot.m_Pending) {
+    Poll();
+  }
+  if (slot.m_Pending) {
+    ++m_Stats.m_Dropped;
+    return false;
+  }
+
+  ResourceStateTracker tracker{};
+  tracker.Import(image, VK_IMAGE_ASPECT_COLOR_BIT, 1,
+                 ResourceStateTracker::GetUsageState(usage));
+  tracker.Transition(image, ResourceUsage::TransferSrc);
+  // 上一次cpu读在提交之前就结束了，host操作和提交之间天然有序
+  tracker.Transition(slot.m_Buffer, ResourceUsage::TransferDst);
+  tracker.Flush(commandBuffer);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {m_Width, m_Height, 1};
+  commandBuffer->CopyImageToBuffer(image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                   slot.m_Buffer->getBuffer(), {region});
+
+  tracker.Transition(image, usage);
+  tracker.Transition(slot.m_Buffer, ResourceUsage::HostRead);
+  tracker.Flush(commandBuffer);
+
+  slot.m_Fence = fence;
+  slot.m_FrameId = frameId;
+  slot.m_Pending = true;
+  m_Next = (m_Next + 1) % GetSlotCount();
+  ++m_Stats.m_Recorded;
+  return true;
+}
+
+void ReadbackRing::Deliver(Slot &slot) {
+  slot.m_Buffer->Invalidate();
+
+  ReadbackFrame frame{};
+  frame.m_FrameId = slot.m_FrameId;
+  frame.m_Width = m_Width;
+  frame.m_Height = m_Height;
+  frame.m_Format = m_Format;
+  frame.m_Data = slot.m_Buffer->GetMappedData();
+  frame.m_Size = m_FrameSize;
+  if (m_Callback) {
+    m_Callback(frame);
+  }
+
+  slot.m_Pending = false;
+  slot.m_Fence = VK_NULL_HANDLE;
+  m_Oldest = (m_Oldest + 1) % GetSlotCount();
+  ++m_Stats.m_Delivered;
+}
+
+void ReadbackRing::Poll() {
+  // 同一个队列按提交顺序完成，最早的没好后面的也不用看
+  while (m_Slots[m_Oldest].m_Pending) {
+    auto &slot = m_Slots[m_Oldest];
+    if (vkGetFenceStatus(m_Device->GetDevice(), slot.m_Fence) != VK_SUCCESS) {
+      break;
+    }
+    Deliver(slot);
+  }
+}
+
+void ReadbackRing::Drain() {
+  while (m_Slots[m_Oldest].m_Pending) {
+    auto &slot = m_Slots[m_Oldest];
+    vkWaitForFences(m_Device->GetDevice(), 1, &slot.m_Fence, VK_TRUE,
+                    UINT64_MAX);
+    Deliver(slot);
+  }
+}
+} // namespace VK::Wrapper
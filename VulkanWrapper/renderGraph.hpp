@@ -0,0 +1,911 @@
+#pragma once
+#include "../base.h"
+#include "commandBuffer.hpp"
+#include "device.hpp"
+#include "gpuProfiler.hpp"
+#include "image.hpp"
+#include "renderPass.hpp"
+#include "resourceStateTracker.hpp"
+#include "subPass.hpp"
+#include "vulkan/vulkan_core.h"
+#include <functional>
+#include <map>
+#include <optional>
+#include <queue>
+#include <string>
+
+namespace VK::Wrapper {
+
+using RenderGraphResource = uint32_t;
+using RenderGraphPassHandle = uint32_t;
+
+struct RenderGraphImageDesc {
+  VkFormat m_Format{VK_FORMAT_UNDEFINED};
+  uint32_t m_Width{0};
+  uint32_t m_Height{0};
+  VkSampleCountFlagBits m_Samples{VK_SAMPLE_COUNT_1_BIT};
+};
+
+enum class RenderGraphPassType { Graphics, Compute };
+
+// pass在setup回调里声明自己读写哪些资源
+class RenderGraphPass {
+  friend class RenderGraph;
+
+private:
+  struct ColorOutput {
+    RenderGraphResource m_Resource{0};
+    std::optional<VkClearColorValue> m_Clear{};
+    std::optional<RenderGraphResource> m_Resolve{};
+  };
+
+  struct DepthOutput {
+    RenderGraphResource m_Resource{0};
+    std::optional<VkClearDepthStencilValue> m_Clear{};
+  };
+
+  struct Access {
+    RenderGraphResource m_Resource{0};
+    ResourceUsage m_Usage{ResourceUsage::Undefined};
+  };
+
+  std::string m_Name{};
+  RenderGraphPassType m_Type{RenderGraphPassType::Graphics};
+  std::vector<ColorOutput> m_ColorOutputs{};
+  std::optional<DepthOutput> m_DepthOutput{};
+  std::vector<Access> m_Reads{};
+  std::vector<Access> m_Writes{};
+  bool m_SideEffect{false};
+
+public:
+  // clear为空时保留之前pass写入的内容
+  void AddColorOutput(
+      RenderGraphResource resource,
+      const std::optional<VkClearColorValue> &clear = std::nullopt) {
+    m_ColorOutputs.push_back({resource, clear, std::nullopt});
+  }
+
+  // 给最近添加的颜色输出设置resolve目标
+  void SetResolveOutput(RenderGraphResource resource) {
+    if (m_ColorOutputs.empty()) {
+      throw std::runtime_error("Error: resolve output needs a color output");
+    }
+    m_ColorOutputs.back().m_Resolve = resource;
+  }
+
+  void SetDepthOutput(
+      RenderGraphResource resource,
+      const std::optional<VkClearDepthStencilValue> &clear = std::nullopt) {
+    m_DepthOutput = DepthOutput{resource, clear};
+  }
+
+  void ReadImage(RenderGraphResource resource,
+                 ResourceUsage usage = ResourceUsage::FragmentShaderRead) {
+    m_Reads.push_back({resource, usage});
+  }
+
+  void WriteImage(RenderGraphResource resource,
+                  ResourceUsage usage = ResourceUsage::ComputeShaderWrite) {
+    m_Writes.push_back({resource, usage});
+  }
+
+  // 输出不被任何pass读取也不会被剔除，比如回读或者调试输出
+  void SetSideEffect() { m_SideEffect = true; }
+};
+
+// 一帧的渲染图
+// pass声明读写的资源后由Compile完成：
+// - 剔除输出没有被用到的pass(沿读写关系从导入资源往回找)
+// - 按依赖排序，读取一个资源的pass排在所有写它的pass之后，写同一资源的pass保持声明顺序
+// - 每个graphics pass生成一个VkRenderPass，load/store按前后是否用到自动选择
+// - 生命周期不重叠的临时image共用同一块内存
+// - 只在一个pass里用作attachment的image带TRANSIENT_ATTACHMENT_BIT，支持时用lazy内存
+// Execute时由ResourceStateTracker在每个pass前生成barrier
+// 尺寸相关，swapchain重建时整个图重建
+class RenderGraph {
+private:
+  struct ResourceNode {
+    std::string m_Name{};
+    RenderGraphImageDesc m_Desc{};
+    VkImageAspectFlags m_Aspect{0};
+    VkImageUsageFlags m_Usage{0};
+    bool m_Imported{false};
+    // 导入资源每帧开始时的状态和结束时要转到的用法
+    ResourceState m_ImportState{};
+    ResourceUsage m_FinalUsage{ResourceUsage::Undefined};
+    VkImage m_ImportedImage{VK_NULL_HANDLE};
+    VkImageView m_ImportedView{VK_NULL_HANDLE};
+
+    // 每套attachment一个image
+    std::vector<Image::Ptr> m_Images{};
+    std::vector<RenderGraphPassHandle> m_Writers{};
+    std::vector<RenderGraphPassHandle> m_Readers{};
+    uint32_t m_RefCount{0};
+    // 在执行顺序中的第一次和最后一次使用
+    uint32_t m_FirstUse{UINT32_MAX};
+    uint32_t m_LastUse{0};
+    int32_t m_MemoryBlock{-1};
+  };
+
+  struct PassNode {
+    RenderGraphPass m_Pass{};
+    std::function<void(const CommandBuffer::Ptr &)> m_Execute{};
+    // gpu计时用，图重建后名字指针也要一直有效
+    const char *m_ProfileName{nullptr};
+    bool m_Culled{false};
+    uint32_t m_RefCount{0};
+    RenderPass::Ptr m_RenderPass{nullptr};
+    // attachment顺序：颜色、resolve、深度
+    std::vector<RenderGraphResource> m_Attachments{};
+    std::vector<VkClearValue> m_ClearValues{};
+    std::map<std::vector<VkImageView>, VkFramebuffer> m_FrameBuffers{};
+  };
+
+  // 每套attachment的分配方式相同，内存和状态各自一份
+  struct MemoryBlock {
+    std::vector<VkDeviceMemory> m_Memory{};
+    VkDeviceSize m_Size{0};
+    uint32_t m_MemoryTypeIndex{0};
+    std::vector<RenderGraphResource> m_Resources{};
+    // 上一个使用者最后的状态，下一个使用者从这里开始同步
+    std::vector<ResourceState> m_LastState{};
+  };
+
+  Device::Ptr m_Device{nullptr};
+  std::vector<ResourceNode> m_Resources{};
+  std::vector<PassNode> m_Passes{};
+  std::vector<RenderGraphPassHandle> m_Order{};
+  std::vector<MemoryBlock> m_MemoryBlocks{};
+  ResourceStateTracker m_Tracker{};
+  bool m_Compiled{false};
+  VkDeviceSize m_UnaliasedMemorySize{0};
+  // 临时attachment的套数，Execute轮流使用
+  uint32_t m_SetCount{1};
+  uint32_t m_CurrentSet{0};
+  uint32_t m_LazilyAllocatedCount{0};
+  GpuProfiler::Ptr m_GpuProfiler{nullptr};
+
+public:
+  using Ptr = std::shared_ptr<RenderGraph>;
+  // setCount为1时所有帧共用一套临时attachment，帧之间由barrier串行
+  // 按frames in flight设置可以让相邻帧的attachment读写重叠，内存成倍增加
+  static Ptr Create(const Device::Ptr &device, uint32_t setCount = 1) {
+    return std::make_shared<RenderGraph>(device, setCount);
+  }
+
+  RenderGraph(const Device::Ptr &device, uint32_t setCount) {
+    m_Device = device;
+    m_SetCount = std::max(1u, setCount);
+  }
+  ~RenderGraph();
+
+  // 由图创建和管理的临时image
+  RenderGraphResource CreateImage(const std::string &name,
+                                  const RenderGraphImageDesc &desc);
+
+  // 外部的image(比如swapchain image)，每帧Execute前用SetImportedImage绑定
+  RenderGraphResource ImportImage(const std::string &name,
+                                  const RenderGraphImageDesc &desc,
+                                  const ResourceState &initialState,
+                                  ResourceUsage finalUsage);
+  void SetImportedImage(RenderGraphResource resource, VkImage image,
+                        VkImageView imageView);
+
+  RenderGraphPassHandle
+  AddPass(const std::string &name, RenderGraphPassType type,
+          const std::function<void(RenderGraphPass &)> &setup,
+          const std::function<void(const CommandBuffer::Ptr &)> &execute);
+
+  void Compile();
+
+  void Execute(const CommandBuffer::Ptr &commandBuffer);
+
+  // 设置后每个pass前后各写一个timestamp，barrier不计入pass的时间
+  // profiler打开了pipeline statistics时每个pass也单独统计
+  void SetGpuProfiler(const GpuProfiler::Ptr &profiler) {
+    m_GpuProfiler = profiler;
+  }
+
+  // 给pipeline创建用，pass被剔除时为空
+  [[nodiscard]] RenderPass::Ptr GetRenderPass(RenderGraphPassHandle pass) const {
+    return m_Passes[pass].m_RenderPass;
+  }
+  // 当前这套attachment里的image
+  [[nodiscard]] Image::Ptr GetImage(RenderGraphResource resource) const {
+    auto &images = m_Resources[resource].m_Images;
+    return images.empty() ? nullptr : images[m_CurrentSet];
+  }
+  [[nodiscard]] auto GetSetCount() const { return m_SetCount; }
+  [[nodiscard]] bool IsCulled(RenderGraphPassHandle pass) const {
+    return m_Passes[pass].m_Culled;
+  }
+  [[nodiscard]] const auto &GetExecutionOrder() const { return m_Order; }
+  // 复用之后实际分配的临时image内存，以及不复用时需要的内存
+  [[nodiscard]] VkDeviceSize GetTransientMemorySize() const;
+  [[nodiscard]] auto GetUnaliasedMemorySize() const {
+    return m_UnaliasedMemorySize;
+  }
+  // 放在LAZILY_ALLOCATED内存里的临时attachment个数，不计入上面的内存
+  [[nodiscard]] auto GetLazilyAllocatedCount() const {
+    return m_LazilyAllocatedCount;
+  }
+  [[nodiscard]] const auto &GetBarrierStats() const {
+    return m_Tracker.GetStats();
+  }
+
+private:
+  void BuildEdges();
+  void CullPasses();
+  void SortPasses();
+  void AllocateResources();
+  void BuildRenderPasses();
+  VkFramebuffer GetFrameBuffer(PassNode &pass);
+  VkImage GetVkImage(const ResourceNode &resource) const;
+  VkImageView GetImageView(const ResourceNode &resource) const;
+  static bool IsDepthFormat(VkFormat format);
+  static VkImageUsageFlags GetImageUsage(ResourceUsage usage);
+};
+
+RenderGraph::~RenderGraph() {
+  for (auto &pass : m_Passes) {
+    for (auto &frameBuffer : pass.m_FrameBuffers) {
+      vkDestroyFramebuffer(m_Device->GetDevice(), frameBuffer.second, nullptr);
+    }
+  }
+  // image要先于它们的内存销毁
+  for (auto &resource : m_Resources) {
+    resource.m_Images.clear();
+  }
+  for (auto &block : m_MemoryBlocks) {
+    for (auto memory : block.m_Memory) {
+      if (memory == VK_NULL_HANDLE) {
+        continue;
+      }
+      vkFreeMemory(m_Device->GetDevice(), memory, nullptr);
+      m_Device->GetMemoryTracker()->Free(MemoryCategory::RenderTarget,
+                                         block.m_MemoryTypeIndex,
+                                         block.m_Size);
+    }
+  }
+}
+
+bool RenderGraph::IsDepthFormat(VkFormat format) {
+  return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_D32_SFLOAT ||
+         format == VK_FORMAT_D16_UNORM_S8_UINT ||
+         format == VK_FORMAT_D24_UNORM_S8_UINT ||
+         format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+VkImageUsageFlags RenderGraph::GetImageUsage(ResourceUsage usage) {
+  switch (usage) {
+  case ResourceUsage::TransferSrc:
+    return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  case ResourceUsage::TransferDst:
+    return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  case ResourceUsage::VertexShaderRead:
+  case ResourceUsage::FragmentShaderRead:
+  case ResourceUsage::ComputeShaderRead:
+  case ResourceUsage::DepthStencilRead:
+    return VK_IMAGE_USAGE_SAMPLED_BIT;
+  case ResourceUsage::ComputeShaderWrite:
+    return VK_IMAGE_USAGE_STORAGE_BIT;
+  case ResourceUsage::ColorAttachment:
+    return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  case ResourceUsage::DepthStencilAttachment:
+    return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  default:
+    return 0;
+  }
+}
+
+RenderGraphResource RenderGraph::CreateImage(const std::string &name,
+                                             const RenderGraphImageDesc &desc) {
+  if (m_Compiled) {
+    throw std::runtime_error("Error: render graph is already compiled");
+  }
+  ResourceNode resource{};
+  resource.m_Name = name;
+  resource.m_Desc = desc;
+  resource.m_Aspect = IsDepthFormat(desc.m_Format) ? VK_IMAGE_ASPECT_DEPTH_BIT
+                                                   : VK_IMAGE_ASPECT_COLOR_BIT;
+  m_Resources.push_back(resource);
+  return static_cast<RenderGraphResource>(m_Resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::ImportImage(const std::string &name,
+                                             const RenderGraphImageDesc &desc,
+                                             const ResourceState &initialState,
+                                             ResourceUsage finalUsage) {
+  auto resource = CreateImage(name, desc);
+  m_Resources[resource].m_Imported = true;
+  m_Resources[resource].m_ImportState = initialState;
+  m_Resources[resource].m_FinalUsage = finalUsage;
+  return resource;
+}
+
+void RenderGraph::SetImportedImage(RenderGraphResource resource, VkImage image,
+                                   VkImageView imageView) {
+  auto &node = m_Resources[resource];
+  if (!node.m_Imported) {
+    throw std::runtime_error("Error: " + node.m_Name +
+                             " is not an imported image");
+  }
+  node.m_ImportedImage = image;
+  node.m_ImportedView = imageView;
+}
+
+RenderGraphPassHandle RenderGraph::AddPass(
+    const std::string &name, RenderGraphPassType type,
+    const std::function<void(RenderGraphPass &)> &setup,
+    const std::function<void(const CommandBuffer::Ptr &)> &execute) {
+  if (m_Compiled) {
+    throw std::runtime_error("Error: render graph is already compiled");
+  }
+  PassNode pass{};
+  pass.m_Pass.m_Name = name;
+  pass.m_Pass.m_Type = type;
+  pass.m_ProfileName = Profiler::Get().Intern(name);
+  setup(pass.m_Pass);
+  pass.m_Execute = execute;
+
+  if (type == RenderGraphPassType::Compute &&
+      (!pass.m_Pass.m_ColorOutputs.empty() || pass.m_Pass.m_DepthOutput)) {
+    throw std::runtime_error("Error: compute pass " + name +
+                             " cannot have attachments");
+  }
+
+  m_Passes.push_back(std::move(pass));
+  return static_cast<RenderGraphPassHandle>(m_Passes.size() - 1);
+}
+
+void RenderGraph::Compile() {
+  if (m_Compiled) {
+    return;
+  }
+  BuildEdges();
+  CullPasses();
+  SortPasses();
+  AllocateResources();
+  BuildRenderPasses();
+  m_Compiled = true;
+}
+
+void RenderGraph::BuildEdges() {
+  for (RenderGraphPassHandle i = 0; i < m_Passes.size(); ++i) {
+    auto &pass = m_Passes[i].m_Pass;
+    auto addWrite = [&](RenderGraphResource resource, ResourceUsage usage) {
+      auto &node = m_Resources[resource];
+      if (node.m_Writers.empty() || node.m_Writers.back() != i) {
+        node.m_Writers.push_back(i);
+        m_Passes[i].m_RefCount++;
+      }
+      node.m_Usage |= GetImageUsage(usage);
+    };
+    auto addRead = [&](RenderGraphResource resource, ResourceUsage usage) {
+      auto &node = m_Resources[resource];
+      node.m_Readers.push_back(i);
+      node.m_Usage |= GetImageUsage(usage);
+    };
+
+    for (auto &color : pass.m_ColorOutputs) {
+      // 不clear就是在之前的内容上继续画，同时也依赖之前的写入
+      if (!color.m_Clear) {
+        addRead(color.m_Resource, ResourceUsage::ColorAttachment);
+      }
+      addWrite(color.m_Resource, ResourceUsage::ColorAttachment);
+      if (color.m_Resolve) {
+        addWrite(*color.m_Resolve, ResourceUsage::ColorAttachment);
+      }
+    }
+    if (pass.m_DepthOutput) {
+      if (!pass.m_DepthOutput->m_Clear) {
+        addRead(pass.m_DepthOutput->m_Resource,
+                ResourceUsage::DepthStencilAttachment);
+      }
+      addWrite(pass.m_DepthOutput->m_Resource,
+               ResourceUsage::DepthStencilAttachment);
+    }
+    for (auto &read : pass.m_Reads) {
+      addRead(read.m_Resource, read.m_Usage);
+    }
+    for (auto &write : pass.m_Writes) {
+      addWrite(write.m_Resource, write.m_Usage);
+    }
+  }
+}
+
+// 从没有被读取的资源往回推，写它的pass引用计数减到0就剔除，再减少它读取的资源的计数
+void RenderGraph::CullPasses() {
+  // pass读自己也写的资源(load已有内容)不算引用，否则它永远不会被剔除
+  auto isWriter = [&](const ResourceNode &resource,
+                      RenderGraphPassHandle pass) {
+    return std::find(resource.m_Writers.begin(), resource.m_Writers.end(),
+                     pass) != resource.m_Writers.end();
+  };
+
+  std::vector<RenderGraphResource> unused{};
+  for (RenderGraphResource i = 0; i < m_Resources.size(); ++i) {
+    auto &resource = m_Resources[i];
+    resource.m_RefCount = resource.m_Imported ? 1 : 0;
+    for (auto reader : resource.m_Readers) {
+      resource.m_RefCount += isWriter(resource, reader) ? 0 : 1;
+    }
+    if (resource.m_RefCount == 0) {
+      unused.push_back(i);
+    }
+  }
+
+  auto cull = [&](RenderGraphPassHandle pass) {
+    m_Passes[pass].m_Culled = true;
+    for (RenderGraphResource i = 0; i < m_Resources.size(); ++i) {
+      auto &resource = m_Resources[i];
+      for (auto reader : resource.m_Readers) {
+        if (reader == pass && !isWriter(resource, pass) &&
+            --resource.m_RefCount == 0) {
+          unused.push_back(i);
+        }
+      }
+    }
+  };
+
+  for (RenderGraphPassHandle i = 0; i < m_Passes.size(); ++i) {
+    if (m_Passes[i].m_RefCount == 0 && !m_Passes[i].m_Pass.m_SideEffect) {
+      cull(i);
+    }
+  }
+
+  while (!unused.empty()) {
+    auto resource = unused.back();
+    unused.pop_back();
+    for (auto writer : m_Resources[resource].m_Writers) {
+      auto &pass = m_Passes[writer];
+      if (pass.m_Culled || pass.m_RefCount == 0) {
+        continue;
+      }
+      if (--pass.m_RefCount == 0 && !pass.m_Pass.m_SideEffect) {
+        cull(writer);
+      }
+    }
+  }
+}
+
+// 拓扑排序，同时可执行的pass按声明顺序
+void RenderGraph::SortPasses() {
+  std::vector<std::vector<RenderGraphPassHandle>> edges(m_Passes.size());
+  std::vector<uint32_t> inDegree(m_Passes.size(), 0);
+  auto addEdge = [&](RenderGraphPassHandle from, RenderGraphPassHandle to) {
+    if (from == to || m_Passes[from].m_Culled || m_Passes[to].m_Culled) {
+      return;
+    }
+    edges[from].push_back(to);
+    inDegree[to]++;
+  };
+
+  for (auto &resource : m_Resources) {
+    for (size_t i = 1; i < resource.m_Writers.size(); ++i) {
+      addEdge(resource.m_Writers[i - 1], resource.m_Writers[i]);
+    }
+    for (auto reader : resource.m_Readers) {
+      // 同时读写的pass(load已有内容)只依赖声明在它之前的写入
+      bool readerWrites = false;
+      for (auto writer : resource.m_Writers) {
+        readerWrites = readerWrites || writer == reader;
+      }
+      for (auto writer : resource.m_Writers) {
+        if (!readerWrites || writer < reader) {
+          addEdge(writer, reader);
+        }
+      }
+    }
+  }
+
+  std::priority_queue<RenderGraphPassHandle,
+                      std::vector<RenderGraphPassHandle>,
+                      std::greater<RenderGraphPassHandle>>
+      ready{};
+  uint32_t alive = 0;
+  for (RenderGraphPassHandle i = 0; i < m_Passes.size(); ++i) {
+    if (m_Passes[i].m_Culled) {
+      continue;
+    }
+    alive++;
+    if (inDegree[i] == 0) {
+      ready.push(i);
+    }
+  }
+
+  m_Order.clear();
+  while (!ready.empty()) {
+    auto pass = ready.top();
+    ready.pop();
+    m_Order.push_back(pass);
+    for (auto next : edges[pass]) {
+      if (--inDegree[next] == 0) {
+        ready.push(next);
+      }
+    }
+  }
+
+  if (m_Order.size() != alive) {
+    throw std::runtime_error("Error: render graph has a dependency cycle");
+  }
+
+  for (uint32_t order = 0; order < m_Order.size(); ++order) {
+    auto &pass = m_Passes[m_Order[order]];
+    auto touch = [&](RenderGraphResource resource) {
+      auto &node = m_Resources[resource];
+      node.m_FirstUse = std::min(node.m_FirstUse, order);
+      node.m_LastUse = std::max(node.m_LastUse, order);
+    };
+    for (auto &color : pass.m_Pass.m_ColorOutputs) {
+      touch(color.m_Resource);
+      if (color.m_Resolve) {
+        touch(*color.m_Resolve);
+      }
+    }
+    if (pass.m_Pass.m_DepthOutput) {
+      touch(pass.m_Pass.m_DepthOutput->m_Resource);
+    }
+    for (auto &read : pass.m_Pass.m_Reads) {
+      touch(read.m_Resource);
+    }
+    for (auto &write : pass.m_Pass.m_Writes) {
+      touch(write.m_Resource);
+    }
+  }
+}
+
+// 临时image按大小从大到小放进内存块，同一块里的image生命周期互不重叠
+void RenderGraph::AllocateResources() {
+  std::vector<RenderGraphResource> transients{};
+  std::vector<VkMemoryRequirements> requirements(m_Resources.size());
+  const bool lazySupported = Image::isLazilyAllocatedMemorySupported(m_Device);
+  for (RenderGraphResource i = 0; i < m_Resources.size(); ++i) {
+    auto &resource = m_Resources[i];
+    if (resource.m_Imported || resource.m_FirstUse == UINT32_MAX) {
+      continue;
+    }
+
+    // 只在一个pass里作为attachment使用：load不是LOAD、store是DONT_CARE，内容从不写回内存
+    const VkImageUsageFlags attachmentUsage =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+        VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    if (resource.m_FirstUse == resource.m_LastUse &&
+        (resource.m_Usage & ~attachmentUsage) == 0) {
+      resource.m_Usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+      // lazy内存不能和普通image共用，单独分配
+      if (lazySupported) {
+        for (uint32_t set = 0; set < m_SetCount; ++set) {
+          auto image = Image::createTransientAttachment(
+              m_Device, resource.m_Desc.m_Width, resource.m_Desc.m_Height,
+              resource.m_Desc.m_Format, resource.m_Usage,
+              resource.m_Desc.m_Samples, resource.m_Aspect);
+          m_LazilyAllocatedCount += image->IsLazilyAllocated() ? 1 : 0;
+          m_Tracker.Import(image->GetImage(), resource.m_Aspect, 1,
+                           ResourceState{});
+          resource.m_Images.push_back(image);
+        }
+        continue;
+      }
+    }
+
+    for (uint32_t set = 0; set < m_SetCount; ++set) {
+      resource.m_Images.push_back(Image::CreateUnbound(
+          m_Device, resource.m_Desc.m_Width, resource.m_Desc.m_Height,
+          resource.m_Desc.m_Format, resource.m_Usage,
+          resource.m_Desc.m_Samples, resource.m_Aspect));
+    }
+    requirements[i] = resource.m_Images[0]->GetMemoryRequirements();
+    m_UnaliasedMemorySize += requirements[i].size * m_SetCount;
+    transients.push_back(i);
+  }
+
+  std::sort(transients.begin(), transients.end(),
+            [&](RenderGraphResource a, RenderGraphResource b) {
+              return requirements[a].size > requirements[b].size;
+            });
+
+  for (auto i : transients) {
+    auto &resource = m_Resources[i];
+    auto &requirement = requirements[i];
+
+    int32_t found = -1;
+    for (int32_t b = 0; b < static_cast<int32_t>(m_MemoryBlocks.size()); ++b) {
+      auto &block = m_MemoryBlocks[b];
+      if ((requirement.memoryTypeBits & (1u << block.m_MemoryTypeIndex)) ==
+          0) {
+        continue;
+      }
+      bool overlap = false;
+      for (auto other : block.m_Resources) {
+        auto &otherNode = m_Resources[other];
+        overlap = overlap || !(otherNode.m_LastUse < resource.m_FirstUse ||
+                               resource.m_LastUse < otherNode.m_FirstUse);
+      }
+      if (!overlap) {
+        found = b;
+        break;
+      }
+    }
+
+    if (found < 0) {
+      MemoryBlock block{};
+      block.m_MemoryTypeIndex = resource.m_Images[0]->FindMemoryType(
+          requirement.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      m_MemoryBlocks.push_back(block);
+      found = static_cast<int32_t>(m_MemoryBlocks.size() - 1);
+    }
+
+    auto &block = m_MemoryBlocks[found];
+    // 按大小降序放入，块的大小就是第一个image的大小
+    block.m_Size = std::max(block.m_Size, requirement.size);
+    block.m_Resources.push_back(i);
+    resource.m_MemoryBlock = found;
+  }
+
+  for (auto &block : m_MemoryBlocks) {
+    block.m_Memory.resize(m_SetCount, VK_NULL_HANDLE);
+    block.m_LastState.resize(m_SetCount);
+    for (uint32_t set = 0; set < m_SetCount; ++set) {
+      VkMemoryAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      allocInfo.allocationSize = block.m_Size;
+      allocInfo.memoryTypeIndex = block.m_MemoryTypeIndex;
+      if (vkAllocateMemory(m_Device->GetDevice(), &allocInfo, nullptr,
+                           &block.m_Memory[set]) != VK_SUCCESS) {
+        throw std::runtime_error(
+            "Error: failed to allocate render graph memory");
+      }
+      m_Device->GetMemoryTracker()->Allocate(MemoryCategory::RenderTarget,
+                                             block.m_MemoryTypeIndex,
+                                             block.m_Size);
+      for (auto i : block.m_Resources) {
+        auto &image = m_Resources[i].m_Images[set];
+        image->BindMemory(block.m_Memory[set], 0);
+        m_Tracker.Import(image->GetImage(), m_Resources[i].m_Aspect, 1,
+                         ResourceState{});
+      }
+    }
+  }
+}
+
+void RenderGraph::BuildRenderPasses() {
+  for (uint32_t order = 0; order < m_Order.size(); ++order) {
+    auto &pass = m_Passes[m_Order[order]];
+    if (pass.m_Pass.m_Type != RenderGraphPassType::Graphics) {
+      continue;
+    }
+
+    // 之前有pass写过才需要load，之后还有pass用到或者是导入资源才需要store
+    auto makeAttachment = [&](RenderGraphResource resource, bool clear,
+                              VkImageLayout layout) {
+      auto &node = m_Resources[resource];
+      VkAttachmentDescription attachment{};
+      attachment.format = node.m_Desc.m_Format;
+      attachment.samples = node.m_Desc.m_Samples;
+      const bool hasContent =
+          node.m_FirstUse < order ||
+          (node.m_Imported &&
+           node.m_ImportState.m_Layout != VK_IMAGE_LAYOUT_UNDEFINED);
+      attachment.loadOp = clear        ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                          : hasContent ? VK_ATTACHMENT_LOAD_OP_LOAD
+                                       : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      attachment.storeOp = node.m_Imported || node.m_LastUse > order
+                               ? VK_ATTACHMENT_STORE_OP_STORE
+                               : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      // layout转换都由tracker在pass之前完成，renderPass里不再转换
+      attachment.initialLayout = layout;
+      attachment.finalLayout = layout;
+
+      VkAttachmentReference reference{};
+      reference.attachment =
+          static_cast<uint32_t>(pass.m_Attachments.size());
+      reference.layout = layout;
+      pass.m_RenderPass->AddAttachment(attachment);
+      pass.m_Attachments.push_back(resource);
+      return reference;
+    };
+
+    pass.m_RenderPass = RenderPass::Create(m_Device);
+    SubPass subPass{};
+
+    for (auto &color : pass.m_Pass.m_ColorOutputs) {
+      subPass.AddColorAttachmentReference(
+          makeAttachment(color.m_Resource, color.m_Clear.has_value(),
+                         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+      VkClearValue clearValue{};
+      clearValue.color = color.m_Clear.value_or(VkClearColorValue{});
+      pass.m_ClearValues.push_back(clearValue);
+    }
+    for (auto &color : pass.m_Pass.m_ColorOutputs) {
+      if (color.m_Resolve) {
+        // SubPass只支持一个resolve
+        subPass.setResolveAttachmentReference(
+            makeAttachment(*color.m_Resolve, false,
+                           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+        pass.m_ClearValues.push_back(VkClearValue{});
+      }
+    }
+    if (pass.m_Pass.m_DepthOutput) {
+      auto &depth = *pass.m_Pass.m_DepthOutput;
+      subPass.SetDepthStencilAttachmentReference(
+          makeAttachment(depth.m_Resource, depth.m_Clear.has_value(),
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL));
+      VkClearValue clearValue{};
+      clearValue.depthStencil =
+          depth.m_Clear.value_or(VkClearDepthStencilValue{1.0f, 0});
+      pass.m_ClearValues.push_back(clearValue);
+    }
+
+    subPass.BuildSubPassDescription();
+    pass.m_RenderPass->AddSubPass(subPass);
+
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                              VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = 0;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                              VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    pass.m_RenderPass->AddDependency(dependency);
+
+    pass.m_RenderPass->BuildRenderPass();
+  }
+}
+
+VkImage RenderGraph::GetVkImage(const ResourceNode &resource) const {
+  return resource.m_Imported ? resource.m_ImportedImage
+                             : resource.m_Images[m_CurrentSet]->GetImage();
+}
+
+VkImageView RenderGraph::GetImageView(const ResourceNode &resource) const {
+  return resource.m_Imported ? resource.m_ImportedView
+                             : resource.m_Images[m_CurrentSet]->GetImageView();
+}
+
+// 导入的image每帧可能不同，按view组合缓存frameBuffer
+VkFramebuffer RenderGraph::GetFrameBuffer(PassNode &pass) {
+  std::vector<VkImageView> views{};
+  for (auto resource : pass.m_Attachments) {
+    views.push_back(GetImageView(m_Resources[resource]));
+  }
+
+  auto found = pass.m_FrameBuffers.find(views);
+  if (found != pass.m_FrameBuffers.end()) {
+    return found->second;
+  }
+
+  auto &desc = m_Resources[pass.m_Attachments[0]].m_Desc;
+  VkFramebufferCreateInfo frameBufferCreateInfo{};
+  frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  frameBufferCreateInfo.renderPass = pass.m_RenderPass->GetRenderPass();
+  frameBufferCreateInfo.attachmentCount = static_cast<uint32_t>(views.size());
+  frameBufferCreateInfo.pAttachments = views.data();
+  frameBufferCreateInfo.width = desc.m_Width;
+  frameBufferCreateInfo.height = desc.m_Height;
+  frameBufferCreateInfo.layers = 1;
+
+  VkFramebuffer frameBuffer{VK_NULL_HANDLE};
+  if (vkCreateFramebuffer(m_Device->GetDevice(), &frameBufferCreateInfo,
+                          nullptr, &frameBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Error: failed to create render graph frameBuffer");
+  }
+  pass.m_FrameBuffers[views] = frameBuffer;
+  return frameBuffer;
+}
+
+void RenderGraph::Execute(const CommandBuffer::Ptr &commandBuffer) {
+  if (!m_Compiled) {
+    Compile();
+  }
+
+  // 导入资源每帧从调用方给的状态开始，比如swapchain image的内容不需要保留
+  for (auto &resource : m_Resources) {
+    if (!resource.m_Imported || resource.m_FirstUse == UINT32_MAX) {
+      continue;
+    }
+    if (resource.m_ImportedImage == VK_NULL_HANDLE) {
+      throw std::runtime_error("Error: imported image " + resource.m_Name +
+                               " is not bound");
+    }
+    m_Tracker.Import(resource.m_ImportedImage, resource.m_Aspect, 1,
+                     resource.m_ImportState);
+  }
+
+  for (uint32_t order = 0; order < m_Order.size(); ++order) {
+    auto &pass = m_Passes[m_Order[order]];
+
+    // 共用内存的image第一次使用时内容无效，要等上一个使用者结束
+    for (auto &resource : m_Resources) {
+      if (resource.m_MemoryBlock < 0 || resource.m_FirstUse != order) {
+        continue;
+      }
+      auto &block = m_MemoryBlocks[resource.m_MemoryBlock];
+      if (block.m_Resources.size() > 1) {
+        auto state = block.m_LastState[m_CurrentSet];
+        state.m_Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        m_Tracker.Import(GetVkImage(resource), resource.m_Aspect, 1,
+                         state);
+      }
+    }
+
+    for (auto &color : pass.m_Pass.m_ColorOutputs) {
+      m_Tracker.Transition(GetVkImage(m_Resources[color.m_Resource]),
+                           ResourceUsage::ColorAttachment);
+      if (color.m_Resolve) {
+        m_Tracker.Transition(GetVkImage(m_Resources[*color.m_Resolve]),
+                             ResourceUsage::ColorAttachment);
+      }
+    }
+    if (pass.m_Pass.m_DepthOutput) {
+      m_Tracker.Transition(
+          GetVkImage(m_Resources[pass.m_Pass.m_DepthOutput->m_Resource]),
+          ResourceUsage::DepthStencilAttachment);
+    }
+    for (auto &read : pass.m_Pass.m_Reads) {
+      m_Tracker.Transition(GetVkImage(m_Resources[read.m_Resource]),
+                           read.m_Usage);
+    }
+    for (auto &write : pass.m_Pass.m_Writes) {
+      m_Tracker.Transition(GetVkImage(m_Resources[write.m_Resource]),
+                           write.m_Usage);
+    }
+    m_Tracker.Flush(commandBuffer);
+
+    GpuProfiler::Scope gpuScope(m_GpuProfiler.get(), commandBuffer,
+                                pass.m_ProfileName, true);
+    if (pass.m_Pass.m_Type == RenderGraphPassType::Graphics) {
+      auto &desc = m_Resources[pass.m_Attachments[0]].m_Desc;
+      VkRenderPassBeginInfo renderBeginInfo{};
+      renderBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+      renderBeginInfo.renderPass = pass.m_RenderPass->GetRenderPass();
+      renderBeginInfo.framebuffer = GetFrameBuffer(pass);
+      renderBeginInfo.renderArea.offset = {0, 0};
+      renderBeginInfo.renderArea.extent = {desc.m_Width, desc.m_Height};
+      renderBeginInfo.clearValueCount =
+          static_cast<uint32_t>(pass.m_ClearValues.size());
+      renderBeginInfo.pClearValues = pass.m_ClearValues.data();
+
+      commandBuffer->BeginRenderPass(renderBeginInfo);
+      if (pass.m_Execute) {
+        pass.m_Execute(commandBuffer);
+      }
+      commandBuffer->EndRenderPass();
+    } else if (pass.m_Execute) {
+      pass.m_Execute(commandBuffer);
+    }
+
+    for (auto &resource : m_Resources) {
+      if (resource.m_MemoryBlock >= 0 && resource.m_LastUse == order) {
+        m_MemoryBlocks[resource.m_MemoryBlock].m_LastState[m_CurrentSet] =
+            m_Tracker.GetState(GetVkImage(resource), 0);
+      }
+    }
+  }
+
+  for (auto &resource : m_Resources) {
+    if (resource.m_Imported && resource.m_FirstUse != UINT32_MAX &&
+        resource.m_FinalUsage != ResourceUsage::Undefined) {
+      m_Tracker.Transition(resource.m_ImportedImage, resource.m_FinalUsage);
+    }
+  }
+  m_Tracker.Flush(commandBuffer);
+
+  m_CurrentSet = (m_CurrentSet + 1) % m_SetCount;
+}
+
+VkDeviceSize RenderGraph::GetTransientMemorySize() const {
+  VkDeviceSize size = 0;
+  for (auto &block : m_MemoryBlocks) {
+    size += block.m_Size * m_SetCount;
+  }
+  return size;
+}
+
+} // namespace VK::Wrapper
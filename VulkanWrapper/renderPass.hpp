@@ -59,6 +59,8 @@ void RenderPass::BuildRenderPass() {
   // unwrap
   std::vector<VkSubpassDescription> subPasses{};
   for (int i = 0; i < mSubPasses.size(); ++i) {
+    // description里的指针指向SubPass自己的成员，拷贝进来之后要重新生成
+    mSubPasses[i].BuildSubPassDescription();
     subPasses.push_back(mSubPasses[i].GetSubPassDescription());
   }
 
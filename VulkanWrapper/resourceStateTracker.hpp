@@ -0,0 +1,483 @@
+#pragma once
+#include "../base.h"
+#include "buffer.hpp"
+#include "commandBuffer.hpp"
+#include "image.hpp"
+#include <unordered_map>
+
+namespace VK::Wrapper {
+
+// 资源接下来要被怎么用，由此推出需要的layout、stage和access
+enum class ResourceUsage {
+  Undefined,
+  TransferSrc,
+  TransferDst,
+  VertexShaderRead,
+  FragmentShaderRead,
+  ComputeShaderRead,
+  ComputeShaderWrite,
+  ColorAttachment,
+  DepthStencilAttachment,
+  DepthStencilRead,
+  Present,
+  VertexBuffer,
+  IndexBuffer,
+  IndirectBuffer,
+  UniformBuffer,
+  HostWrite,
+  HostRead,
+};
+
+struct ResourceState {
+  // 上一次barrier之后访问过的stage和access，下一次写或者layout变化要等它们
+  VkPipelineStageFlags m_Stages{VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
+  VkAccessFlags m_Access{0};
+  VkImageLayout m_Layout{VK_IMAGE_LAYOUT_UNDEFINED};
+  // 最近一次写(或layout转换)：读它要从m_WriteStages开始同步，0表示没有写过
+  VkPipelineStageFlags m_WriteStages{0};
+  VkAccessFlags m_WriteAccess{0};
+  // 这次写已经通过barrier对哪些stage/access可见，覆盖不到的读还要再补barrier
+  VkPipelineStageFlags m_VisibleStages{0};
+  VkAccessFlags m_VisibleAccess{0};
+};
+
+struct ResourceStateTrackerStats {
+  // 实际生成的image/buffer barrier，以及因为读后读被省掉的
+  uint32_t m_ImageBarriers{0};
+  uint32_t m_BufferBarriers{0};
+  uint32_t m_SkippedTransitions{0};
+  uint32_t m_Flushes{0};
+};
+
+// 资源状态跟踪
+// image按(mip, layer)逐个子资源记录layout/access/stage，buffer整体记录
+// Transition只计算需要的最小barrier并暂存，Flush时合成一次vkCmdPipelineBarrier
+// - 读后读且layout不变：上一次写已经对这个stage可见时不生成barrier，只累加读的stage，
+//   之后的写会等待所有读；不可见时从写的stage补一个barrier
+// - 读后写且layout不变：只需要执行依赖，不生成内存barrier
+// - 写之后或layout变化：生成barrier，src只带之前的写access
+// 相邻mip的旧状态相同时合并成一个barrier
+class ResourceStateTracker {
+private:
+  struct ImageState {
+    VkImageAspectFlags m_Aspect{0};
+    uint32_t m_MipLevels{1};
+    uint32_t m_Layers{1};
+    std::vector<ResourceState> m_Subresources{};
+  };
+
+  std::unordered_map<VkImage, ImageState> m_Images{};
+  std::unordered_map<VkBuffer, ResourceState> m_Buffers{};
+
+  std::vector<VkImageMemoryBarrier> m_ImageBarriers{};
+  std::vector<VkBufferMemoryBarrier> m_BufferBarriers{};
+  VkPipelineStageFlags m_SrcStages{0};
+  VkPipelineStageFlags m_DstStages{0};
+
+  ResourceStateTrackerStats m_Stats{};
+
+  static constexpr VkAccessFlags WRITE_ACCESS =
+      VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+      VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+      VK_ACCESS_MEMORY_WRITE_BIT;
+
+public:
+  using Ptr = std::shared_ptr<ResourceStateTracker>;
+  static Ptr Create() { return std::make_shared<ResourceStateTracker>(); }
+
+  ResourceStateTracker() = default;
+  ~ResourceStateTracker() = default;
+
+  static ResourceState GetUsageState(ResourceUsage usage);
+
+  void Transition(const Image::Ptr &image, ResourceUsage usage);
+  void Transition(const Image::Ptr &image, ResourceUsage usage,
+                  const VkImageSubresourceRange &range);
+  void Transition(const Buffer::Ptr &buffer, ResourceUsage usage);
+
+  // 不归Image管理的image(比如swapchain image)，或者需要指定初始状态的image
+  // state.m_Stages用来和之前的同步衔接，比如acquire semaphore等待的stage
+  void Import(VkImage image, VkImageAspectFlags aspect, uint32_t mipLevels,
+              const ResourceState &state);
+  // image需要先Import
+  void Transition(VkImage image, ResourceUsage usage);
+
+  // 把暂存的barrier一次性录制下去
+  void Flush(const CommandBuffer::Ptr &commandBuffer);
+  // 丢掉暂存的barrier不录制，只测barrier生成开销时用
+  void DiscardPending() {
+    m_ImageBarriers.clear();
+    m_BufferBarriers.clear();
+    m_SrcStages = 0;
+    m_DstStages = 0;
+  }
+  [[nodiscard]] size_t GetPendingBarrierCount() const {
+    return m_ImageBarriers.size() + m_BufferBarriers.size();
+  }
+
+  [[nodiscard]] ResourceState GetState(const Image::Ptr &image,
+                                       uint32_t mipLevel,
+                                       uint32_t layer = 0);
+  [[nodiscard]] ResourceState GetState(VkImage image, uint32_t mipLevel,
+                                       uint32_t layer = 0);
+
+  // image销毁或者在别处改了layout之后，下次从image自己记录的layout重新开始
+  void Forget(const Image::Ptr &image) { m_Images.erase(image->GetImage()); }
+  void Forget(VkImage image) { m_Images.erase(image); }
+  void Forget(const Buffer::Ptr &buffer) {
+    m_Buffers.erase(buffer->getBuffer());
+  }
+
+  [[nodiscard]] auto &GetStats() const { return m_Stats; }
+  void ResetStats() { m_Stats = {}; }
+
+private:
+  ImageState &GetImageState(const Image::Ptr &image);
+  void TransitionImage(VkImage image, ImageState &state, ResourceUsage usage,
+                       const VkImageSubresourceRange &range);
+  // 计算old->target需要什么同步，返回是否需要内存barrier
+  bool ResolveTransition(ResourceState &current, const ResourceState &target,
+                         VkAccessFlags &srcAccess, VkAccessFlags &dstAccess);
+};
+
+ResourceState ResourceStateTracker::GetUsageState(ResourceUsage usage) {
+  switch (usage) {
+  case ResourceUsage::TransferSrc:
+    return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+  case ResourceUsage::TransferDst:
+    return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+  case ResourceUsage::VertexShaderRead:
+    return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  case ResourceUsage::FragmentShaderRead:
+    return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  case ResourceUsage::ComputeShaderRead:
+    return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  case ResourceUsage::ComputeShaderWrite:
+    return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_GENERAL};
+  case ResourceUsage::ColorAttachment:
+    return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  case ResourceUsage::DepthStencilAttachment:
+    return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+  case ResourceUsage::DepthStencilRead:
+    return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+  case ResourceUsage::Present:
+    return {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+  case ResourceUsage::VertexBuffer:
+    return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED};
+  case ResourceUsage::IndexBuffer:
+    return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED};
+  case ResourceUsage::IndirectBuffer:
+    return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED};
+  case ResourceUsage::UniformBuffer:
+    return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED};
+  case ResourceUsage::HostWrite:
+    return {VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_WRITE_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED};
+  // 回读buffer，拷贝写完之后cpu去map读
+  case ResourceUsage::HostRead:
+    return {VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED};
+  case ResourceUsage::Undefined:
+  default:
+    return {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED};
+  }
+}
+
+ResourceStateTracker::ImageState &
+ResourceStateTracker::GetImageState(const Image::Ptr &image) {
+  auto found = m_Images.find(image->GetImage());
+  if (found != m_Images.end()) {
+    return found->second;
+  }
+
+  // 第一次见到的image，之前做过什么不清楚，只知道它自己记录的layout
+  ImageState state{};
+  state.m_Aspect = image->GetAspectFlags();
+  state.m_MipLevels = image->GetMipLevels();
+  state.m_Layers = 1;
+  ResourceState initial{};
+  initial.m_Layout = image->GetLayout();
+  state.m_Subresources.assign(state.m_MipLevels * state.m_Layers, initial);
+  return m_Images.emplace(image->GetImage(), std::move(state)).first->second;
+}
+
+bool ResourceStateTracker::ResolveTransition(ResourceState &current,
+                                             const ResourceState &target,
+                                             VkAccessFlags &srcAccess,
+                                             VkAccessFlags &dstAccess) {
+  const bool layoutChange = current.m_Layout != target.m_Layout;
+  const bool nextWrite = (target.m_Access & WRITE_ACCESS) != 0;
+
+  if (!layoutChange && !nextWrite) {
+    // 读后读：上一次写已经对这些stage可见，记下新的读stage，后面的写要等所有读完成
+    const bool visible =
+        current.m_WriteStages == 0 ||
+        ((target.m_Stages & ~current.m_VisibleStages) == 0 &&
+         (target.m_Access & ~current.m_VisibleAccess) == 0);
+    current.m_Stages |= target.m_Stages;
+    current.m_Access |= target.m_Access;
+    if (visible) {
+      m_Stats.m_SkippedTransitions++;
+      return false;
+    }
+
+    // 比如写完只对fragment可见，现在vertex也要读，从写的stage再同步一次
+    m_SrcStages |= current.m_WriteStages;
+    m_DstStages |= target.m_Stages;
+    srcAccess = current.m_WriteAccess;
+    dstAccess = target.m_Access;
+    current.m_VisibleStages |= target.m_Stages;
+    current.m_VisibleAccess |= target.m_Access;
+    return true;
+  }
+
+  const bool previousWrite = current.m_WriteAccess != 0;
+  m_SrcStages |= current.m_Stages;
+  m_DstStages |= target.m_Stages;
+
+  srcAccess = current.m_WriteAccess;
+  dstAccess = target.m_Access;
+
+  const auto stages = target.m_Stages;
+  current = target;
+  if (nextWrite) {
+    current.m_WriteStages = stages;
+    current.m_WriteAccess = target.m_Access & WRITE_ACCESS;
+    current.m_VisibleStages = 0;
+    current.m_VisibleAccess = 0;
+  } else if (layoutChange) {
+    // layout转换本身也是写，只保证在这次的dst stage之前完成
+    // 别的stage再读时要从这里的dst stage接上同步链
+    current.m_WriteStages = stages;
+    current.m_WriteAccess = 0;
+    current.m_VisibleStages = stages;
+    current.m_VisibleAccess = target.m_Access;
+  }
+
+  // 读后写且layout不变，执行依赖已经足够
+  return layoutChange || previousWrite;
+}
+
+void ResourceStateTracker::Transition(const Image::Ptr &image,
+                                      ResourceUsage usage) {
+  VkImageSubresourceRange range{};
+  range.aspectMask = image->GetAspectFlags();
+  range.baseMipLevel = 0;
+  range.levelCount = image->GetMipLevels();
+  range.baseArrayLayer = 0;
+  range.layerCount = 1;
+  Transition(image, usage, range);
+}
+
+void ResourceStateTracker::Import(VkImage image, VkImageAspectFlags aspect,
+                                  uint32_t mipLevels,
+                                  const ResourceState &state) {
+  ImageState imageState{};
+  imageState.m_Aspect = aspect;
+  imageState.m_MipLevels = mipLevels;
+  imageState.m_Layers = 1;
+  imageState.m_Subresources.assign(mipLevels, state);
+  // 调用方只给了stage和access时，带写的access当作还没有对任何人可见的写
+  for (auto &subresource : imageState.m_Subresources) {
+    if (subresource.m_WriteStages == 0 &&
+        (subresource.m_Access & WRITE_ACCESS) != 0) {
+      subresource.m_WriteStages = subresource.m_Stages;
+      subresource.m_WriteAccess = subresource.m_Access & WRITE_ACCESS;
+    }
+  }
+  m_Images[image] = std::move(imageState);
+}
+
+void ResourceStateTracker::Transition(VkImage image, ResourceUsage usage) {
+  auto found = m_Images.find(image);
+  if (found == m_Images.end()) {
+    throw std::runtime_error("Error: image is not imported to tracker");
+  }
+
+  VkImageSubresourceRange range{};
+  range.aspectMask = found->second.m_Aspect;
+  range.baseMipLevel = 0;
+  range.levelCount = found->second.m_MipLevels;
+  range.baseArrayLayer = 0;
+  range.layerCount = found->second.m_Layers;
+  TransitionImage(image, found->second, usage, range);
+}
+
+void ResourceStateTracker::Transition(const Image::Ptr &image,
+                                      ResourceUsage usage,
+                                      const VkImageSubresourceRange &range) {
+  auto &state = GetImageState(image);
+  TransitionImage(image->GetImage(), state, usage, range);
+
+  // 整张image处于同一layout时同步给Image，沿用旧接口的代码看到的layout才是对的
+  const auto layout = state.m_Subresources[0].m_Layout;
+  bool uniform = true;
+  for (const auto &subresource : state.m_Subresources) {
+    uniform = uniform && subresource.m_Layout == layout;
+  }
+  if (uniform) {
+    image->SetLayout(layout);
+  }
+}
+
+void ResourceStateTracker::TransitionImage(
+    VkImage image, ImageState &state, ResourceUsage usage,
+    const VkImageSubresourceRange &range) {
+  const auto target = GetUsageState(usage);
+
+  const uint32_t levelEnd =
+      range.levelCount == VK_REMAINING_MIP_LEVELS
+          ? state.m_MipLevels
+          : range.baseMipLevel + range.levelCount;
+  const uint32_t layerEnd =
+      range.layerCount == VK_REMAINING_ARRAY_LAYERS
+          ? state.m_Layers
+          : range.baseArrayLayer + range.layerCount;
+
+  for (uint32_t layer = range.baseArrayLayer; layer < layerEnd; ++layer) {
+    // 正在合并的一段连续mip
+    VkImageMemoryBarrier pending{};
+    bool hasPending = false;
+
+    for (uint32_t mip = range.baseMipLevel; mip < levelEnd; ++mip) {
+      auto &current = state.m_Subresources[layer * state.m_MipLevels + mip];
+      const auto oldLayout = current.m_Layout;
+
+      VkAccessFlags srcAccess = 0;
+      VkAccessFlags dstAccess = 0;
+      if (!ResolveTransition(current, target, srcAccess, dstAccess)) {
+        if (hasPending) {
+          m_ImageBarriers.push_back(pending);
+          hasPending = false;
+        }
+        continue;
+      }
+
+      if (hasPending && pending.oldLayout == oldLayout &&
+          pending.srcAccessMask == srcAccess &&
+          pending.subresourceRange.baseMipLevel +
+                  pending.subresourceRange.levelCount ==
+              mip) {
+        pending.subresourceRange.levelCount++;
+        continue;
+      }
+
+      if (hasPending) {
+        m_ImageBarriers.push_back(pending);
+      }
+
+      pending = {};
+      pending.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      pending.oldLayout = oldLayout;
+      pending.newLayout = target.m_Layout;
+      pending.srcAccessMask = srcAccess;
+      pending.dstAccessMask = dstAccess;
+      pending.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      pending.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      pending.image = image;
+      pending.subresourceRange.aspectMask = state.m_Aspect;
+      pending.subresourceRange.baseMipLevel = mip;
+      pending.subresourceRange.levelCount = 1;
+      pending.subresourceRange.baseArrayLayer = layer;
+      pending.subresourceRange.layerCount = 1;
+      hasPending = true;
+    }
+
+    if (hasPending) {
+      m_ImageBarriers.push_back(pending);
+    }
+  }
+}
+
+void ResourceStateTracker::Transition(const Buffer::Ptr &buffer,
+                                      ResourceUsage usage) {
+  auto &current = m_Buffers[buffer->getBuffer()];
+  auto target = GetUsageState(usage);
+  target.m_Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VkAccessFlags srcAccess = 0;
+  VkAccessFlags dstAccess = 0;
+  if (!ResolveTransition(current, target, srcAccess, dstAccess)) {
+    return;
+  }
+
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer->getBuffer();
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+  m_BufferBarriers.push_back(barrier);
+}
+
+void ResourceStateTracker::Flush(const CommandBuffer::Ptr &commandBuffer) {
+  if (m_SrcStages == 0 && m_DstStages == 0) {
+    return;
+  }
+
+  // sync1只有一组stage，取所有barrier的并集
+  commandBuffer->PipelineBarrier(
+      m_SrcStages != 0 ? m_SrcStages
+                       : static_cast<VkPipelineStageFlags>(
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+      m_DstStages != 0 ? m_DstStages
+                       : static_cast<VkPipelineStageFlags>(
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT),
+      m_BufferBarriers, m_ImageBarriers);
+
+  m_Stats.m_ImageBarriers += static_cast<uint32_t>(m_ImageBarriers.size());
+  m_Stats.m_BufferBarriers += static_cast<uint32_t>(m_BufferBarriers.size());
+  m_Stats.m_Flushes++;
+
+  m_ImageBarriers.clear();
+  m_BufferBarriers.clear();
+  m_SrcStages = 0;
+  m_DstStages = 0;
+}
+
+ResourceState ResourceStateTracker::GetState(const Image::Ptr &image,
+                                             uint32_t mipLevel,
+                                             uint32_t layer) {
+  auto &state = GetImageState(image);
+  return state.m_Subresources[layer * state.m_MipLevels + mipLevel];
+}
+
+ResourceState ResourceStateTracker::GetState(VkImage image, uint32_t mipLevel,
+                                             uint32_t layer) {
+  auto found = m_Images.find(image);
+  if (found == m_Images.end()) {
+    throw std::runtime_error("Error: image is not imported to tracker");
+  }
+  auto &state = found->second;
+  return state.m_Subresources[layer * state.m_MipLevels + mipLevel];
+}
+
+} // namespace VK::Wrapper
@@ -9,16 +9,16 @@ namespace VK::Wrapper {
 		VkSampler mSampler{ VK_NULL_HANDLE };
 	public:
 		using Ptr = std::shared_ptr<Sampler>;
-		static Ptr create(const Device::Ptr& device) { return std::make_shared<Sampler>(device); }
+		static Ptr create(const Device::Ptr& device, float maxLod = VK_LOD_CLAMP_NONE) { return std::make_shared<Sampler>(device, maxLod); }
 
-		Sampler(const Device::Ptr& device);
+		Sampler(const Device::Ptr& device, float maxLod = VK_LOD_CLAMP_NONE);
 
 		~Sampler();
 
 		[[nodiscard]] auto getSampler() const { return mSampler; }
 
 	};
-	Sampler::Sampler(const Device::Ptr& device) {
+	Sampler::Sampler(const Device::Ptr& device, float maxLod) {
 		mDevice = device;
 
 		VkSamplerCreateInfo createInfo{};
@@ -44,7 +44,7 @@ namespace VK::Wrapper {
 		createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 		createInfo.mipLodBias = 0.0f;
 		createInfo.minLod = 0.0f;
-		createInfo.maxLod = 0.0f;
+		createInfo.maxLod = maxLod;
 
 		if (vkCreateSampler(mDevice->GetDevice(), &createInfo, nullptr, &mSampler) != VK_SUCCESS) {
 			throw std::runtime_error("Error: failed to create sampler");
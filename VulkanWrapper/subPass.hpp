@@ -47,7 +47,9 @@ SubPass::~SubPass() {}
  
 
 void SubPass::BuildSubPassDescription() {
-  if (m_ColorAttachmentReferences.empty()) {
+  // 只写深度的pass(比如阴影)可以没有颜色attachment
+  if (m_ColorAttachmentReferences.empty() &&
+      m_DepthStencilAttachmentReference.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
     throw std::runtime_error("Error: color attachment group is empty!");
   }
   m_SubPassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
@@ -59,7 +61,11 @@ void SubPass::BuildSubPassDescription() {
   m_SubPassDescription.inputAttachmentCount =
       static_cast<uint32_t>(m_InputAttachmentReferences.size());
   m_SubPassDescription.pInputAttachments = m_InputAttachmentReferences.data();
-  m_SubPassDescription.pResolveAttachments = &m_ResolvedAttachmentReference;
+  // 没有设置resolve时layout为UNDEFINED，不能传给vulkan
+  m_SubPassDescription.pResolveAttachments =
+      m_ResolvedAttachmentReference.layout == VK_IMAGE_LAYOUT_UNDEFINED
+          ? nullptr
+          : &m_ResolvedAttachmentReference;
 
 
   m_SubPassDescription.pDepthStencilAttachment =
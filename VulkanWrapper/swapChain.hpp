@@ -3,6 +3,7 @@
 #include "image.hpp"
 #include "renderPass.hpp"
 #include "vulkan/vulkan_core.h"
+#include <algorithm>
 
 namespace VK::Wrapper {
 struct SwapChainSupportInfo {
@@ -14,6 +15,18 @@ struct SwapChainSupportInfo {
   std::vector<VkPresentModeKHR> m_PresentModes;
 };
 
+// 显示策略
+// FIFO：垂直同步，不撕裂，排队的帧越多延迟越高
+// FIFO_RELAXED：晚了一帧时立即显示，可能撕裂
+// MAILBOX：不撕裂，新帧替换还没显示的旧帧，延迟低但gpu一直满载
+// IMMEDIATE：不等垂直同步，延迟最低，会撕裂
+// 请求的模式不支持时按上面的相近模式回退，FIFO一定可用
+struct SwapChainSettings {
+  VkPresentModeKHR m_PresentMode{VK_PRESENT_MODE_MAILBOX_KHR};
+  // 0表示minImageCount + 1，否则限制在设备支持的范围内
+  uint32_t m_ImageCount{0};
+};
+
 class SwapChain {
 private:
   VkSwapchainKHR m_SwapChain{VK_NULL_HANDLE};
@@ -23,13 +36,13 @@ private:
   Device::Ptr m_Device{nullptr};
   Window::Ptr m_Window{nullptr};
   uint32_t imageCount{0};
+  bool m_TransferSrcSupported{false};
+  SwapChainSettings m_Settings{};
+  VkPresentModeKHR m_PresentMode{VK_PRESENT_MODE_FIFO_KHR};
 
   std::vector<VkImage> m_SwapChainImages{};
   // image管理器
   std::vector<VkImageView> m_SwapChainImageViews{};
-  std::vector<VkFramebuffer> m_SwapChainFrameBuffers{};
-  std::vector<Image::Ptr> m_DepthImages{};
-  std::vector<Image::Ptr> m_MutiSampleImages{};
 
   WindowSurface::Ptr m_Surface{nullptr};
   VkImageView CreateImageView(VkImage image, VkFormat format,
@@ -38,17 +51,22 @@ private:
 
 public:
   using Ptr = std::shared_ptr<SwapChain>;
+  // 多重采样和深度attachment由RenderGraph管理，所有swapchain image共用
+  // 重建时传入旧的swapchain，驱动可以复用它的资源，旧swapchain随之退役
+  // 退役的swapchain要等用到它的帧都结束后才能析构
   static Ptr Create(const Device::Ptr &device, const Window::Ptr &window,
                     const WindowSurface::Ptr &surface,
-                    const CommandPool::Ptr &commandPool) {
-    return std::make_shared<SwapChain>(device, window, surface, commandPool);
+                    const SwapChainSettings &settings = {},
+                    const Ptr &oldSwapChain = nullptr) {
+    return std::make_shared<SwapChain>(device, window, surface, settings,
+                                       oldSwapChain);
   }
 
   SwapChain(const Device::Ptr &device, const Window::Ptr &window,
             const WindowSurface::Ptr &surface,
-            const CommandPool::Ptr &commandPool);
+            const SwapChainSettings &settings = {},
+            const Ptr &oldSwapChain = nullptr);
   ~SwapChain();
-  void CreateFrameBuffers(const RenderPass::Ptr &renderPass);
   // 查看设备支持的格式
   SwapChainSupportInfo QuerySwapChainSupportInfo();
 
@@ -57,33 +75,41 @@ public:
 
   VkPresentModeKHR ChooseSurfacePresentMode(
       const std::vector<VkPresentModeKHR> &availablePresenstModes);
+  uint32_t ChooseImageCount(const VkSurfaceCapabilitiesKHR &capabilities);
 
   VkExtent2D ChooseExtent(const VkSurfaceCapabilitiesKHR &capabilities);
   [[nodiscard]] auto GetFormat() const { return m_SwapChainFormat; }
   [[nodiscard]] auto GetImageCount() const { return imageCount; }
-  [[nodiscard]] auto GetFrameBuffer(const int index) const {
-    return m_SwapChainFrameBuffers[index];
+  // 实际使用的显示模式，可能和请求的不同
+  [[nodiscard]] auto GetPresentMode() const { return m_PresentMode; }
+  [[nodiscard]] auto GetImage(const int index) const {
+    return m_SwapChainImages[index];
+  }
+  [[nodiscard]] auto GetImageView(const int index) const {
+    return m_SwapChainImageViews[index];
   }
   [[nodiscard]] auto GetExtent() const { return m_SwapChainExtent; }
+  [[nodiscard]] auto IsTransferSrcSupported() const {
+    return m_TransferSrcSupported;
+  }
   [[nodiscard]] auto GetSwapChain() { return m_SwapChain; }
 };
 
 SwapChain::SwapChain(const Device::Ptr &device, const Window::Ptr &window,
                      const WindowSurface::Ptr &surface,
-                     const CommandPool::Ptr &commandPool) {
+                     const SwapChainSettings &settings,
+                     const Ptr &oldSwapChain) {
   m_Device = device;
   m_Window = window;
   m_Surface = surface;
+  m_Settings = settings;
   auto swapChainInfo = QuerySwapChainSupportInfo();
   auto surfaceFormat = ChooseSurfaceFormat(swapChainInfo.m_Formats);
   auto presentMode = ChooseSurfacePresentMode(swapChainInfo.m_PresentModes);
+  m_PresentMode = presentMode;
   auto extent = ChooseExtent(swapChainInfo.m_Capabilities);
   // 设置交换链中图像的个数
-  imageCount = swapChainInfo.m_Capabilities.minImageCount + 1;
-  if (swapChainInfo.m_Capabilities.maxImageCount > 0 &&
-      imageCount > swapChainInfo.m_Capabilities.maxImageCount) {
-    imageCount = swapChainInfo.m_Capabilities.maxImageCount;
-  }
+  imageCount = ChooseImageCount(swapChainInfo.m_Capabilities);
   VkSwapchainCreateInfoKHR createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
   createInfo.surface = m_Surface->GetSurface();
@@ -94,6 +120,13 @@ SwapChain::SwapChain(const Device::Ptr &device, const Window::Ptr &window,
 
   createInfo.imageArrayLayers = 1;
   createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  // 支持的话允许拷贝出来，帧回读要用
+  m_TransferSrcSupported =
+      (swapChainInfo.m_Capabilities.supportedUsageFlags &
+       VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+  if (m_TransferSrcSupported) {
+    createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  }
 
   std::vector<uint32_t> queueFamilies = {
       m_Device->GetGraphicQueueFamily().value(),
@@ -118,8 +151,8 @@ SwapChain::SwapChain(const Device::Ptr &device, const Window::Ptr &window,
   createInfo.presentMode = presentMode;
   // VK_TRUE表示我们不关心被窗口系统中的其它窗口遮挡的像素的颜色
   createInfo.clipped = VK_TRUE;
-  // 此次还没有任何老交换链，置空即可
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  createInfo.oldSwapchain =
+      oldSwapChain ? oldSwapChain->GetSwapChain() : VK_NULL_HANDLE;
   if (vkCreateSwapchainKHR(m_Device->GetDevice(), &createInfo, nullptr,
                            &m_SwapChain) != VK_SUCCESS) {
     throw std::runtime_error("Error: failed to create swapChain");
@@ -148,47 +181,6 @@ SwapChain::SwapChain(const Device::Ptr &device, const Window::Ptr &window,
     m_SwapChainImageViews[i] = CreateImageView(
         m_SwapChainImages[i], m_SwapChainFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
   }
-  // 生成深度图
-  m_DepthImages.resize(imageCount);
-
-  VkImageSubresourceRange region{};
-  region.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-  region.baseMipLevel = 0;
-  region.levelCount = 1;
-  region.baseArrayLayer = 0;
-  region.layerCount = 1;
-
-  for (int i = 0; i < imageCount; ++i) {
-    m_DepthImages[i] = Image::createDepthImage(
-        m_Device, m_SwapChainExtent.width, m_SwapChainExtent.height,
-        m_Device->getMaxUsableSampleCount());
-
-    m_DepthImages[i]->SetImageLayout(
-        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, region, commandPool);
-  }
-  // 生成采样图，最终采样后的图片是 swapchain自动生成的m_SwapChainImages
-  m_MutiSampleImages.resize(imageCount);
-
-  VkImageSubresourceRange regionMutiSample{};
-  regionMutiSample.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  regionMutiSample.baseMipLevel = 0;
-  regionMutiSample.levelCount = 1;
-  regionMutiSample.baseArrayLayer = 0;
-  regionMutiSample.layerCount = 1;
-
-  for (int i = 0; i < imageCount; ++i) {
-    m_MutiSampleImages[i] = Image::createRenderTargetImage(
-        m_Device, m_SwapChainExtent.width, m_SwapChainExtent.height,
-        m_SwapChainFormat);
-
-    m_MutiSampleImages[i]->SetImageLayout(
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, regionMutiSample,
-        commandPool);
-  }
 }
 VkImageView SwapChain::CreateImageView(VkImage image, VkFormat format,
                                        VkImageAspectFlags aspectFlags,
@@ -219,41 +211,11 @@ VkImageView SwapChain::CreateImageView(VkImage image, VkFormat format,
   return imageView;
 }
 
-void SwapChain::CreateFrameBuffers(const RenderPass::Ptr &renderPass) {
-
-  m_SwapChainFrameBuffers.resize(imageCount);
-  for (int i = 0; i < imageCount; ++i) {
-    // framebuffer 包括一帧所有的数据
-    // 数组中的顺序必须要与renderpass的顺序匹配
-    std::array<VkImageView, 3> attachments = {
-        m_SwapChainImageViews[i], m_MutiSampleImages[i]->GetImageView(),
-        m_DepthImages[i]->GetImageView()};
-
-    VkFramebufferCreateInfo frameBufferCreateInfo{};
-    frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    frameBufferCreateInfo.renderPass = renderPass->GetRenderPass();
-    frameBufferCreateInfo.attachmentCount =
-        static_cast<uint32_t>(attachments.size());
-    frameBufferCreateInfo.pAttachments = attachments.data();
-    frameBufferCreateInfo.width = m_SwapChainExtent.width;
-    frameBufferCreateInfo.height = m_SwapChainExtent.height;
-    frameBufferCreateInfo.layers = 1;
-
-    if (vkCreateFramebuffer(m_Device->GetDevice(), &frameBufferCreateInfo,
-                            nullptr,
-                            &m_SwapChainFrameBuffers[i]) != VK_SUCCESS) {
-      throw std::runtime_error("Error:Failed to create frameBuffer");
-    }
-  }
-}
 SwapChain::~SwapChain() {
   vkDestroySwapchainKHR(m_Device->GetDevice(), m_SwapChain, nullptr);
   for (auto imageView : m_SwapChainImageViews) {
     vkDestroyImageView(m_Device->GetDevice(), imageView, nullptr);
   }
-  for (auto &i : m_SwapChainFrameBuffers) {
-    vkDestroyFramebuffer(m_Device->GetDevice(), i, nullptr);
-  }
   m_Window.reset();
   m_Surface.reset();
   m_Device.reset();
@@ -312,18 +274,43 @@ VkSurfaceFormatKHR SwapChain::ChooseSurfaceFormat(
 }
 VkPresentModeKHR SwapChain::ChooseSurfacePresentMode(
     const std::vector<VkPresentModeKHR> &availablePresenstModes) {
+  // 按请求的模式排出回退顺序
+  std::vector<VkPresentModeKHR> candidates{};
+  switch (m_Settings.m_PresentMode) {
+  case VK_PRESENT_MODE_MAILBOX_KHR:
+    candidates = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+    break;
+  case VK_PRESENT_MODE_IMMEDIATE_KHR:
+    candidates = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+    break;
+  case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+    candidates = {VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+    break;
+  default:
+    break;
+  }
 
-  VkPresentModeKHR bestMode = VK_PRESENT_MODE_FIFO_KHR;
-
-  for (const auto &availablePresentMode : availablePresenstModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      return availablePresentMode;
-    } else if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-      bestMode = availablePresentMode;
+  for (auto candidate : candidates) {
+    if (std::find(availablePresenstModes.begin(), availablePresenstModes.end(),
+                  candidate) != availablePresenstModes.end()) {
+      return candidate;
     }
   }
 
-  return bestMode;
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t
+SwapChain::ChooseImageCount(const VkSurfaceCapabilitiesKHR &capabilities) {
+  uint32_t count = m_Settings.m_ImageCount == 0
+                       ? capabilities.minImageCount + 1
+                       : m_Settings.m_ImageCount;
+  count = std::max(count, capabilities.minImageCount);
+  // maxImageCount为0表示没有上限
+  if (capabilities.maxImageCount > 0) {
+    count = std::min(count, capabilities.maxImageCount);
+  }
+  return count;
 }
 // 交换链中图像的分辨率，一般与窗口的分辨率相同
 VkExtent2D
@@ -6,8 +6,10 @@
 #include "VulkanWrapper/commandBuffer.hpp"
 #include "VulkanWrapper/descriptorSetLayout.hpp"
 #include "VulkanWrapper/device.hpp"
+#include "VulkanWrapper/gpuProfiler.hpp"
 #include "VulkanWrapper/pipeline.hpp"
-#include "VulkanWrapper/renderPass.hpp"
+#include "VulkanWrapper/readbackRing.hpp"
+#include "VulkanWrapper/renderGraph.hpp"
 #include "VulkanWrapper/sampler.hpp"
 #include "VulkanWrapper/semaphore.hpp"
 #include "VulkanWrapper/swapChain.hpp"
@@ -16,26 +18,75 @@
 #include "vulkan/vulkan_core.h"
 
 #include "VulkanWrapper/fence.hpp"
+#include "VulkanWrapper/frameAllocator.hpp"
 #include "camera.hpp"
+#include "culling.hpp"
 #include "model.hpp"
+#include "profiler.hpp"
+#include "scene.hpp"
+#include "texture/bindlessTextures.hpp"
+#include "texture/imageWriter.hpp"
 #include "texture/texture.hpp"
+#include "texture/textureLoader.hpp"
+#include "texture/textureStreamer.hpp"
 #include "uniformManager.hpp"
 #include <vector>
 
 namespace VK {
 
+// 无窗口模式的设置，CI和渲染农场上没有显示器也能跑
+struct HeadlessSettings {
+  uint32_t m_Width{800};
+  uint32_t m_Height{600};
+  uint32_t m_FrameCount{100};
+  // 为空时不回读，只渲染
+  std::string m_OutputPrefix{};
+  // true时按half float输出exr，否则输出png
+  bool m_WriteEXR{false};
+};
+
+// 每帧的渲染统计，cpu部分是刚录制完的这一帧，gpu部分晚frames in flight帧
+struct FrameStats {
+  uint64_t m_Frame{0};
+  Wrapper::CommandBufferStats m_Commands{};
+  // 拷贝命令、每帧临时内存和纹理上传加在一起
+  VkDeviceSize m_BytesUploaded{0};
+  uint64_t m_GpuFrame{0};
+  std::vector<std::pair<std::string, Wrapper::PipelineStatistics>>
+      m_PassStatistics{};
+  // 视锥剔除前后的物体数
+  uint32_t m_TotalObjects{0};
+  uint32_t m_VisibleObjects{0};
+};
+
 class Application {
 private:
   void InitWindow();
+  void InitCamera();
   void InitVulkan();
 
   void MainLoop();
+  void HeadlessLoop();
 
   void CleanUp();
 
 private:
   unsigned int m_Width{800};
   unsigned int m_Height{600};
+  // 每一帧可用的临时内存(uniform、动态顶点、indirect参数)
+  static constexpr VkDeviceSize FRAME_ALLOCATOR_SIZE{1024 * 1024};
+  Wrapper::FrameAllocator::Ptr m_FrameAllocator{nullptr};
+  // bindless模式：纹理通过set 1的大数组+push constant下标访问，设备不支持时自动关闭
+  bool m_EnableBindless{true};
+  BindlessTextures::Ptr m_BindlessTextures{nullptr};
+  MaterialConstants m_MaterialConstants{};
+  // 纹理的解码和上传放在后台，Render里每帧推进一次
+  TextureLoader::Ptr m_TextureLoader{nullptr};
+  // 设置了路径时模型纹理改为流送，按模型在屏幕上的大小每帧调整常驻的mip
+  static constexpr VkDeviceSize TEXTURE_STREAMING_BUDGET{256 * 1024 * 1024};
+  std::string m_StreamedTexturePath{};
+  TextureStreamer::Ptr m_TextureStreamer{nullptr};
+  uint32_t m_StreamedTextureHandle{0};
   Wrapper::UniformManager::Ptr m_UniformManager{nullptr};
   Wrapper::Window::Ptr m_Window{nullptr};
   Wrapper::WindowSurface::Ptr m_Surface{nullptr};
@@ -43,7 +94,73 @@ private:
   Wrapper::Instance::Ptr m_Instance{nullptr};
   Wrapper::Device::Ptr m_Device{nullptr};
   Wrapper::SwapChain::Ptr m_SwapChain{nullptr};
-  Wrapper::RenderPass::Ptr m_RenderPass{nullptr};
+  Wrapper::SwapChainSettings m_SwapChainSettings{};
+  // 重建后退役的swapchain和尺寸相关的对象，等提交过的帧都结束再释放
+  struct RetiredSwapChain {
+    Wrapper::SwapChain::Ptr m_SwapChain{nullptr};
+    Wrapper::RenderGraph::Ptr m_RenderGraph{nullptr};
+    // 格式变了才会重建pipeline，旧的录制过的commandBuffer还绑着它
+    Wrapper::Pipeline::Ptr m_Pipeline{nullptr};
+    uint64_t m_RetireFrame{0};
+  };
+  std::vector<RetiredSwapChain> m_RetiredSwapChains{};
+  // 最多允许几帧同时在gpu上，0表示不额外限制(由swapchain image数决定)
+  // 采样输入之前等最早的那一帧，越小输入到显示的延迟越低
+  uint32_t m_FrameLatency{0};
+  // 无窗口模式下没有surface和swapchain，画到离屏image上
+  bool m_Headless{false};
+  HeadlessSettings m_HeadlessSettings{};
+  static constexpr uint32_t HEADLESS_FRAMES_IN_FLIGHT{2};
+  // 每帧一张离屏目标，帧之间互不覆盖
+  std::vector<Wrapper::Image::Ptr> m_OffscreenTargets{};
+  // 帧回读，不阻塞渲染，回调比渲染晚几帧
+  static constexpr uint32_t READBACK_SLOT_COUNT{3};
+  Wrapper::ReadbackRing::Ptr m_ReadbackRing{nullptr};
+  // 图形队列不支持timestamp或者关掉profiler时为空
+  Wrapper::GpuProfiler::Ptr m_GpuProfiler{nullptr};
+  Wrapper::ReadbackRing::Callback m_FrameReadback{};
+  uint64_t m_FrameNumber{0};
+  // 退出时把cpu打点导出成chrome trace，为空时不导出
+  std::string m_ProfileOutput{};
+  // 退出前把显存统计写成json，为空时不写
+  std::string m_MemoryReport{};
+  // 需要设备支持pipelineStatisticsQuery，不支持时忽略
+  bool m_PipelineStatistics{false};
+  FrameStats m_FrameStats{};
+  VkDeviceSize m_TextureUploadedBytes{0};
+  // 程序生成的场景代替模型文件，性能测试用
+  bool m_UseProceduralScene{false};
+  SceneSettings m_SceneSettings{};
+  ProceduralScene::Ptr m_Scene{nullptr};
+  // 每张场景纹理对应的材质descriptorSet，以及bindless下标
+  std::vector<VkDescriptorSet> m_SceneMaterials{};
+  std::vector<uint32_t> m_SceneTextureIndices{};
+  // 场景物体的世界包围球，每帧按相机剔除
+  bool m_FrustumCulling{true};
+  FrustumCuller::Ptr m_Culler{nullptr};
+  std::vector<uint32_t> m_VisibleObjects{};
+  // 无窗口模式下按帧号驱动相机
+  CameraPath m_CameraPath{};
+  // 以/结尾，main里可以用--shaders/--assets改，无窗口模式默认放在可执行文件旁边
+  std::string m_ShaderDirectory{"D:\\cpp\\vk\\shaders/"};
+  std::string m_AssetDirectory{"D:\\cpp\\vk\\assets/"};
+  // 每帧结束(打点汇总之后)调用
+  std::function<void()> m_FrameEnd{};
+  // 每隔多少帧打印一次最近一帧的分段耗时，0表示不打印
+  uint32_t m_ProfileSummaryInterval{0};
+  uint32_t m_FramesInFlight{0};
+  VkFormat m_ColorFormat{VK_FORMAT_UNDEFINED};
+  // 抗锯齿设置，实际采样数按设备能力向下取
+  VkSampleCountFlagBits m_RequestedSampleCount{VK_SAMPLE_COUNT_4_BIT};
+  VkSampleCountFlagBits m_SampleCount{VK_SAMPLE_COUNT_1_BIT};
+  // 逐采样着色，改善纹理和shader内部的锯齿，代价是fragment shader按采样数执行
+  bool m_SampleRateShading{false};
+  // 多重采样颜色和深度的套数，1套最省内存，帧之间由barrier串行
+  static constexpr uint32_t ATTACHMENT_SET_COUNT{1};
+  // 帧渲染图，swapchain image以导入资源的方式接入
+  Wrapper::RenderGraph::Ptr m_RenderGraph{nullptr};
+  Wrapper::RenderGraphResource m_BackBuffer{0};
+  Wrapper::RenderGraphPassHandle m_MainPass{0};
   Wrapper::Pipeline::Ptr m_Pipeline{nullptr};
   Wrapper::CommandPool::Ptr m_CommandPool{nullptr};
   Wrapper::DescriptorSetLayout::Ptr m_DescriptorSetLayout{nullptr};
@@ -62,17 +179,90 @@ public:
   ~Application() = default;
 
   void Run();
+  // 在Run之前调用，1x关闭多重采样
+  void SetSampleCount(VkSampleCountFlagBits samples) {
+    m_RequestedSampleCount = samples;
+  }
+  void SetSampleRateShading(bool enable) { m_SampleRateShading = enable; }
+  // 在Run之前调用
+  void SetPresentMode(VkPresentModeKHR presentMode) {
+    m_SwapChainSettings.m_PresentMode = presentMode;
+  }
+  void SetSwapChainImageCount(uint32_t imageCount) {
+    m_SwapChainSettings.m_ImageCount = imageCount;
+  }
+  void SetFrameLatency(uint32_t frames) { m_FrameLatency = frames; }
+  void SetProfileOutput(const std::string &path) { m_ProfileOutput = path; }
+  void SetMemoryReport(const std::string &path) { m_MemoryReport = path; }
+  void SetProfileSummaryInterval(uint32_t frames) {
+    m_ProfileSummaryInterval = frames;
+  }
+  void SetPipelineStatistics(bool enable) { m_PipelineStatistics = enable; }
+  void SetFrustumCulling(bool enable) { m_FrustumCulling = enable; }
+  // 在Run之前调用，关掉后每张纹理走自己的descriptorSet
+  void SetBindless(bool enable) { m_EnableBindless = enable; }
+  // 在Run之前调用，程序化场景下不生效
+  void SetStreamedTexture(const std::string &path) {
+    m_StreamedTexturePath = path;
+  }
+  // InitVulkan之后才是实际的结果(设备可能不支持)
+  [[nodiscard]] auto IsBindlessEnabled() const { return m_EnableBindless; }
+  // 在Run之前调用
+  void SetProceduralScene(const SceneSettings &settings) {
+    m_UseProceduralScene = true;
+    m_SceneSettings = settings;
+  }
+  void SetCameraPath(const CameraPath &path) { m_CameraPath = path; }
+  void SetShaderDirectory(const std::string &directory) {
+    m_ShaderDirectory = directory;
+  }
+  void SetAssetDirectory(const std::string &directory) {
+    m_AssetDirectory = directory;
+  }
+  void SetFrameEndCallback(std::function<void()> callback) {
+    m_FrameEnd = std::move(callback);
+  }
+  [[nodiscard]] auto &GetDevice() const { return m_Device; }
+  [[nodiscard]] auto &GetGpuProfiler() const { return m_GpuProfiler; }
+  [[nodiscard]] const auto &GetFrameStats() const { return m_FrameStats; }
+  // 在Run之前调用，不创建窗口，渲染固定帧数后退出
+  void SetHeadless(const HeadlessSettings &settings) {
+    m_Headless = true;
+    m_HeadlessSettings = settings;
+    // InitCamera用它算投影的宽高比
+    m_Width = settings.m_Width;
+    m_Height = settings.m_Height;
+  }
+  // 在Run之前调用，每帧画完的像素交给callback(录屏、远程查看)
+  // 无窗口模式设置了输出前缀时由写文件占用
+  void SetFrameReadback(Wrapper::ReadbackRing::Callback callback) {
+    m_FrameReadback = std::move(callback);
+  }
   void CreatePipeline();
-  void CreateRenderPass();
+  void CreateRenderGraph();
+  void DrawScene(const Wrapper::CommandBuffer::Ptr &commandBuffer, int frame);
   void CreateCommandBuffer();
+  void RecordCommandBuffer(int frame, uint32_t imageIndex);
+  void DrawProceduralScene(const Wrapper::CommandBuffer::Ptr &commandBuffer);
   void CreateSyncObjects();
   void ReCreateSwapChain();
-  void CleanupSwapChain();
+  void ReleaseRetiredSwapChains();
+  void OnTextureChanged(const Texture::Ptr &texture);
+  void UpdateTextureStreaming();
   void WindowUpdate();
   void OnMouseMove(double xpos, double ypos);
   void OnKeyDown(CAMERA_MOVE moveDirection);
 
+  void WaitForFrameLatency();
+  void EndProfileFrame();
+  void CollectFrameStats(int frame);
+  void WriteProfile();
+  void WriteMemoryReport();
   void Render();
+  void RenderHeadless(uint32_t frameIndex);
+  void CreateOffscreenTargets();
+  void CreateReadbackRing();
+  void WriteFrame(const Wrapper::ReadbackFrame &frame);
 };
 
 static void cursorPosCallBack(GLFWwindow *window, double xpos, double ypos) {
@@ -87,7 +277,10 @@ void Application::InitWindow() {
   glfwSetWindowUserPointer(m_Window->GetWindow(), this);
 
   glfwSetCursorPosCallback(m_Window->GetWindow(), cursorPosCallBack);
-  
+  InitCamera();
+}
+
+void Application::InitCamera() {
 		mCamera.lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 		mCamera.update();
 
@@ -98,25 +291,119 @@ void Application::InitWindow() {
 
 void Application::MainLoop() {
   while (!m_Window->ShouldClose()) {
-    m_Window->PollEvent();
-    // m_Window->ProcessEvent();
-    WindowUpdate();
+    VK_PROFILE_BEGIN_FRAME();
+    {
+      VK_PROFILE_SCOPE("latency wait");
+      WaitForFrameLatency();
+    }
+    {
+      VK_PROFILE_SCOPE("input");
+      m_Window->PollEvent();
+      // m_Window->ProcessEvent();
+      WindowUpdate();
+      m_VPMatrices.mViewMatrix = mCamera.getViewMatrix();
+      m_VPMatrices.mProjectionMatrix = mCamera.getProjectMatrix();
+      // m_Model->update();
+    }
+
+    Render();
+    EndProfileFrame();
+  }
+  vkDeviceWaitIdle(m_Device->GetDevice());
+  WriteProfile();
+  WriteMemoryReport();
+}
+
+void Application::EndProfileFrame() {
+  VK_PROFILE_END_FRAME();
+  if (m_FrameEnd) {
+    m_FrameEnd();
+  }
+#if VK_ENABLE_PROFILER
+  if (m_ProfileSummaryInterval > 0 &&
+      Profiler::Get().GetFrame() % m_ProfileSummaryInterval == 0) {
+    Profiler::Get().PrintLastFrame(std::cout);
+    if (m_GpuProfiler) {
+      auto &gpu = m_GpuProfiler->GetLastFrame();
+      std::cout << "gpu frame " << gpu.m_Frame << ": " << gpu.m_FrameMs
+                << " ms";
+      for (auto &pass : gpu.m_ZoneMs) {
+        std::cout << " | " << pass.first << " " << pass.second;
+      }
+      std::cout << std::endl;
+    }
+    auto &commands = m_FrameStats.m_Commands;
+    std::cout << "objects " << m_FrameStats.m_VisibleObjects << "/"
+              << m_FrameStats.m_TotalObjects << " | draws "
+              << commands.mDrawCalls << " | pipelines "
+              << commands.mPipelineBinds << " | descriptor sets "
+              << commands.mDescriptorBinds << " | uploaded "
+              << m_FrameStats.m_BytesUploaded << " bytes" << std::endl;
+    auto memory = m_Device->GetMemoryTracker()->GetTotalStats();
+    std::cout << "memory " << memory.m_LiveBytes / (1024 * 1024) << " MB in "
+              << memory.m_Count << " allocations | peak "
+              << memory.m_PeakBytes / (1024 * 1024) << " MB" << std::endl;
+    for (auto &pass : m_FrameStats.m_PassStatistics) {
+      std::cout << pass.first << ": primitives "
+                << pass.second.m_InputPrimitives << " | vs "
+                << pass.second.m_VertexInvocations << " | clipped "
+                << pass.second.m_ClippingPrimitives << " | fs "
+                << pass.second.m_FragmentInvocations << std::endl;
+    }
+  }
+#endif
+}
+
+void Application::WriteProfile() {
+#if VK_ENABLE_PROFILER
+  if (!m_ProfileOutput.empty()) {
+    Profiler::Get().WriteChromeTrace(m_ProfileOutput);
+  }
+#endif
+}
+
+void Application::WriteMemoryReport() {
+  if (m_MemoryReport.empty()) {
+    return;
+  }
+  std::ofstream file(m_MemoryReport);
+  if (!file) {
+    throw std::runtime_error("Error: failed to write memory report " +
+                             m_MemoryReport);
+  }
+  m_Device->GetMemoryTracker()->WriteJson(file);
+  file << std::endl;
+}
+
+void Application::HeadlessLoop() {
+  for (uint32_t i = 0; i < m_HeadlessSettings.m_FrameCount; ++i) {
+    VK_PROFILE_BEGIN_FRAME();
+    m_CameraPath.Apply(mCamera, i);
     m_VPMatrices.mViewMatrix = mCamera.getViewMatrix();
     m_VPMatrices.mProjectionMatrix = mCamera.getProjectMatrix();
-    // m_Model->update();
-
-    // m_VPMatrices.mViewMatrix = mCamera.getViewMatrix();
-    // 	m_VPMatrices.mProjectionMatrix = mCamera.getProjectMatrix();
-    m_UniformManager->Update(m_VPMatrices, m_Model->getUniform(),
-                             m_CurrentFrame);
 
-    Render();
+    RenderHeadless(i);
+    EndProfileFrame();
+  }
+  if (m_ReadbackRing) {
+    m_ReadbackRing->Drain();
   }
   vkDeviceWaitIdle(m_Device->GetDevice());
+  WriteProfile();
+  WriteMemoryReport();
 }
 void Application::CleanUp() {
+  // 析构时会把还在路上的上传做完并回调OnTextureChanged，要在其它成员之前释放
+  m_TextureLoader.reset();
+  m_TextureStreamer.reset();
   m_Pipeline.reset();
-  m_RenderPass.reset();
+  m_RenderGraph.reset();
+  m_OffscreenTargets.clear();
+  m_ReadbackRing.reset();
+  m_GpuProfiler.reset();
+  m_Culler.reset();
+  m_Scene.reset();
+  m_RetiredSwapChains.clear();
   m_SwapChain.reset();
   m_Device.reset();
   m_Surface.reset();
@@ -127,79 +414,311 @@ void Application::CleanUp() {
 }
 
 void Application::InitVulkan() {
-  m_Instance = Wrapper::Instance::Create();
-  m_Surface = Wrapper::WindowSurface::Create(m_Instance, m_Window);
+  m_Instance = Wrapper::Instance::Create(m_Headless);
+  if (!m_Headless) {
+    m_Surface = Wrapper::WindowSurface::Create(m_Instance, m_Window);
+  }
   m_Device = Wrapper::Device::Create(m_Instance, m_Surface);
-  m_Model = Model::Create(m_Device);
-  m_Model->loadModel("D:\\cpp\\vk\\assets\\jqm.obj", m_Device);
   m_CommandPool = Wrapper::CommandPool::Create(m_Device);
-  m_SwapChain =
-      Wrapper::SwapChain::Create(m_Device, m_Window, m_Surface, m_CommandPool);
-  m_RenderPass = Wrapper::RenderPass::Create(m_Device);
-  CreateRenderPass();
-  m_SwapChain->CreateFrameBuffers(m_RenderPass);
-
-  m_Width = m_SwapChain->GetExtent().width;
-  m_Height = m_SwapChain->GetExtent().height;
+  m_TextureLoader = TextureLoader::create(m_Device, m_CommandPool);
+  if (m_UseProceduralScene) {
+    VK_PROFILE_SCOPE("generate scene");
+    m_Scene = ProceduralScene::Create(m_Device, m_CommandPool, m_SceneSettings);
+    // pipeline的顶点格式和默认的uniform都取第一个物体
+    m_Model = m_Scene->GetObjects()[0].m_Model;
+    m_Culler = FrustumCuller::Create();
+    for (auto &object : m_Scene->GetObjects()) {
+      m_Culler->Add(object.m_Bounds);
+    }
+  } else {
+    VK_PROFILE_SCOPE("load model");
+    m_Model = Model::Create(m_Device);
+    m_Model->loadModel(m_AssetDirectory + "jqm.obj", m_Device);
+  }
+  if (m_Headless) {
+    m_Width = m_HeadlessSettings.m_Width;
+    m_Height = m_HeadlessSettings.m_Height;
+    m_FramesInFlight = HEADLESS_FRAMES_IN_FLIGHT;
+    // png按srgb8存，exr存线性的half float
+    m_ColorFormat = m_HeadlessSettings.m_WriteEXR
+                        ? VK_FORMAT_R16G16B16A16_SFLOAT
+                        : VK_FORMAT_R8G8B8A8_SRGB;
+    CreateOffscreenTargets();
+  } else {
+    m_SwapChain = Wrapper::SwapChain::Create(m_Device, m_Window, m_Surface,
+                                             m_SwapChainSettings);
+    m_Width = m_SwapChain->GetExtent().width;
+    m_Height = m_SwapChain->GetExtent().height;
+    m_FramesInFlight = m_SwapChain->GetImageCount();
+    m_ColorFormat = m_SwapChain->GetFormat();
+  }
+  m_SampleCount = m_Device->GetSupportedSampleCount(m_RequestedSampleCount);
+#if VK_ENABLE_PROFILER
+  m_GpuProfiler =
+      Wrapper::GpuProfiler::Create(m_Device, m_CommandPool, m_FramesInFlight);
+  if (!m_GpuProfiler->IsSupported()) {
+    m_GpuProfiler.reset();
+  } else if (m_PipelineStatistics &&
+             !m_GpuProfiler->SetPipelineStatistics(true)) {
+    std::cout << "pipeline statistics query is not supported" << std::endl;
+  }
+#endif
+  CreateRenderGraph();
+  CreateReadbackRing();
+
+  // 场景里每个可见物体每帧推一个ObjectUniform，按全部可见留出空间
+  VkDeviceSize frameAllocatorSize = FRAME_ALLOCATOR_SIZE;
+  if (m_Scene) {
+    frameAllocatorSize += Wrapper::FrameAllocator::GetAlignedSize(
+                              m_Device, sizeof(ObjectUniform)) *
+                          m_Scene->GetObjects().size();
+  }
+  m_FrameAllocator = Wrapper::FrameAllocator::Create(
+      m_Device, frameAllocatorSize, m_FramesInFlight);
 
   // descriptor ============
+  // 模型的纹理在后台解码上传，先用占位图画，上传完成后在OnTextureChanged里切换
+  // 流送的纹理先只有最小的几级，换mip时同样走OnTextureChanged
+  Texture::Ptr modelTexture{nullptr};
+  if (m_Scene) {
+    modelTexture = m_Scene->GetTextures()[0];
+  } else if (!m_StreamedTexturePath.empty()) {
+    m_TextureStreamer =
+        TextureStreamer::create(m_Device, m_CommandPool,
+                                TEXTURE_STREAMING_BUDGET, m_FramesInFlight);
+    m_StreamedTextureHandle = m_TextureStreamer->Add(m_StreamedTexturePath);
+    modelTexture = m_TextureStreamer->GetTexture(m_StreamedTextureHandle);
+  } else {
+    modelTexture = m_TextureLoader->LoadAsync(m_AssetDirectory + "jqm.png");
+  }
   m_UniformManager = Wrapper::UniformManager::Create();
-  m_UniformManager->Init(m_Device, m_CommandPool, m_SwapChain->GetImageCount());
-  m_Pipeline = Wrapper::Pipeline::Create(m_Device, m_RenderPass);
+  m_UniformManager->Init(m_Device, m_FrameAllocator, m_FramesInFlight,
+                         modelTexture);
+  if (m_Scene) {
+    for (auto &texture : m_Scene->GetTextures()) {
+      m_SceneMaterials.push_back(m_UniformManager->GetDescriptorSet(texture));
+    }
+  }
+  m_TextureLoader->SetOnLoaded(
+      [this](const Texture::Ptr &texture) { OnTextureChanged(texture); });
+  // 加载失败的纹理留在占位图上，只报告一次
+  m_TextureLoader->SetOnFailed([](const Texture::Ptr &texture) {
+    std::cerr << texture->GetError() << std::endl;
+  });
+  if (m_TextureStreamer) {
+    // 旧imageView还在cache的key里，先丢掉再重新取set
+    m_TextureStreamer->SetOnImageChanged(
+        [this](const Texture::Ptr &texture, VkImageView oldView) {
+          m_UniformManager->GetDescriptorSetCache()->Invalidate(oldView);
+          OnTextureChanged(texture);
+        });
+  }
+
+  m_EnableBindless = m_EnableBindless && m_Device->IsBindlessSupported();
+  if (m_EnableBindless) {
+    m_BindlessTextures = BindlessTextures::create(m_Device, m_FramesInFlight);
+    m_MaterialConstants.mTextureIndex =
+        m_BindlessTextures->Register(m_UniformManager->GetTexture());
+    if (m_Scene) {
+      for (auto &texture : m_Scene->GetTextures()) {
+        m_SceneTextureIndices.push_back(m_BindlessTextures->Register(texture));
+      }
+    }
+  }
+  m_Pipeline = Wrapper::Pipeline::Create(
+      m_Device, m_RenderGraph->GetRenderPass(m_MainPass));
   CreatePipeline();
-  m_CommandBuffers.resize(m_SwapChain->GetImageCount());
+  m_CommandBuffers.resize(m_FramesInFlight);
   CreateCommandBuffer();
   CreateSyncObjects();
-  ReCreateSwapChain();
 }
-// commandBuffer 创建时会直接录制所有信息，后面可以独立运行
+
+void Application::CreateOffscreenTargets() {
+  for (uint32_t i = 0; i < m_FramesInFlight; ++i) {
+    m_OffscreenTargets.push_back(Wrapper::Image::Create(
+        m_Device, m_Width, m_Height, m_ColorFormat, VK_IMAGE_TYPE_2D,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        VK_SAMPLE_COUNT_1_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, 1, Wrapper::MemoryCategory::RenderTarget));
+  }
+}
+
+void Application::CreateReadbackRing() {
+  if (m_Headless && !m_HeadlessSettings.m_OutputPrefix.empty()) {
+    m_FrameReadback = [this](const Wrapper::ReadbackFrame &frame) {
+      WriteFrame(frame);
+    };
+  }
+  if (!m_FrameReadback) {
+    return;
+  }
+  if (!m_Headless && !m_SwapChain->IsTransferSrcSupported()) {
+    std::cout << "swapchain image cannot be copied, frame readback disabled"
+              << std::endl;
+    return;
+  }
+  // 槽位比并行的帧多一个，等完当前帧的fence时最早的槽位一定已经可以交付
+  m_ReadbackRing = Wrapper::ReadbackRing::Create(
+      m_Device, m_Width, m_Height, m_ColorFormat,
+      std::max(READBACK_SLOT_COUNT, m_FramesInFlight + 1), m_FrameReadback);
+}
+// 每一帧一个commandBuffer，uniform的dynamic offset每帧都不同，所以每帧重新录制
 void Application::CreateCommandBuffer() {
 
-  for (int i = 0; i < m_SwapChain->GetImageCount(); ++i) {
+  for (uint32_t i = 0; i < m_FramesInFlight; ++i) {
     m_CommandBuffers[i] =
         Wrapper::CommandBuffer::Create(m_Device, m_CommandPool);
-    m_CommandBuffers[i]->Begin();
-    VkRenderPassBeginInfo renderBeginInfo{};
-    renderBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderBeginInfo.renderPass = m_RenderPass->GetRenderPass();
-    renderBeginInfo.framebuffer = m_SwapChain->GetFrameBuffer(i);
-    renderBeginInfo.renderArea.offset = {0, 0};
-    renderBeginInfo.renderArea.extent = m_SwapChain->GetExtent();
-    std::vector<VkClearValue> clearColors{};
-    VkClearValue finalClearColor{};
-    finalClearColor.color = {0.0f, 0.0f, 0.0f, 1.0f};
-    clearColors.push_back(finalClearColor);
-
-    VkClearValue mutiClearColor{};
-    mutiClearColor.color = {0.0f, 0.0f, 0.0f, 1.0f};
-    clearColors.push_back(mutiClearColor);
-
-    VkClearValue depthClearColor{};
-    depthClearColor.depthStencil = {1.0f, 0};
-    clearColors.push_back(depthClearColor);
-    renderBeginInfo.clearValueCount = clearColors.size();
-    renderBeginInfo.pClearValues = clearColors.data();
-
-    m_CommandBuffers[i]->BeginRenderPass(renderBeginInfo);
-
-    m_CommandBuffers[i]->BindGraphicPipeline(m_Pipeline->GetPipeline());
-    m_CommandBuffers[i]->BindDescriptorSet(
-        m_Pipeline->GetLayout(),
-        m_UniformManager->GetDescriptorSet(m_CurrentFrame));
-
-    m_CommandBuffers[i]->BindVertexBuffer(m_Model->getVertexBuffers());
-    m_CommandBuffers[i]->BindIndexBuffer(
-        m_Model->getIndexBuffer()->getBuffer());
-    // m_CommandBuffers[i]->Draw(3);
-    m_CommandBuffers[i]->DrawIndex(m_Model->getIndexCount());
-
-    m_CommandBuffers[i]->EndRenderPass();
-
-    m_CommandBuffers[i]->End();
+  }
+}
+
+void Application::RecordCommandBuffer(int frame, uint32_t imageIndex) {
+  auto &commandBuffer = m_CommandBuffers[frame];
+  // commandPool带有RESET_COMMAND_BUFFER_BIT，Begin时会隐式reset
+  commandBuffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  // 这一帧槽位的fence已经等过，上一轮的timestamp可以直接读
+  if (m_GpuProfiler) {
+    m_GpuProfiler->BeginFrame(commandBuffer, frame, m_FrameNumber);
+  }
+
+  if (m_Headless) {
+    m_RenderGraph->SetImportedImage(m_BackBuffer,
+                                    m_OffscreenTargets[frame]->GetImage(),
+                                    m_OffscreenTargets[frame]->GetImageView());
+  } else {
+    m_RenderGraph->SetImportedImage(m_BackBuffer,
+                                    m_SwapChain->GetImage(imageIndex),
+                                    m_SwapChain->GetImageView(imageIndex));
+  }
+  m_RenderGraph->Execute(commandBuffer);
+
+  // 渲染图结束时离屏目标是TRANSFER_SRC，swapchain image是PRESENT
+  if (m_ReadbackRing) {
+    if (m_Headless) {
+      m_ReadbackRing->Record(commandBuffer,
+                             m_OffscreenTargets[frame]->GetImage(),
+                             Wrapper::ResourceUsage::TransferSrc,
+                             m_Fences[frame]->GetFence(), m_FrameNumber);
+    } else {
+      m_ReadbackRing->Record(commandBuffer, m_SwapChain->GetImage(imageIndex),
+                             Wrapper::ResourceUsage::Present,
+                             m_Fences[frame]->GetFence(), m_FrameNumber);
+    }
+  }
+
+  if (m_GpuProfiler) {
+    m_GpuProfiler->EndFrame(commandBuffer);
+  }
+  commandBuffer->End();
+  CollectFrameStats(frame);
+}
+
+void Application::CollectFrameStats(int frame) {
+  m_FrameStats.m_Frame = m_FrameNumber;
+  m_FrameStats.m_Commands = m_CommandBuffers[frame]->GetStats();
+
+  const auto textureBytes = m_TextureLoader->GetUploadedBytes();
+  m_FrameStats.m_BytesUploaded = m_FrameStats.m_Commands.mBytesUploaded +
+                                 m_FrameAllocator->GetUsedBytes() +
+                                 textureBytes - m_TextureUploadedBytes;
+  m_TextureUploadedBytes = textureBytes;
+
+  m_FrameStats.m_PassStatistics.clear();
+  if (m_GpuProfiler) {
+    m_FrameStats.m_GpuFrame = m_GpuProfiler->GetLastFrame().m_Frame;
+    for (auto &pass : m_GpuProfiler->GetLastStatistics()) {
+      m_FrameStats.m_PassStatistics.push_back({pass.first, pass.second});
+    }
+  }
+}
+
+void Application::DrawScene(const Wrapper::CommandBuffer::Ptr &commandBuffer,
+                            int frame) {
+  commandBuffer->BindGraphicPipeline(m_Pipeline->GetPipeline());
+  // 视口和裁剪是动态状态，窗口尺寸变化不用重建pipeline
+  VkViewport viewport{0.0f, 0.0f, (float)m_Width, (float)m_Height, 0.0f, 1.0f};
+  commandBuffer->SetViewport(viewport);
+  commandBuffer->SetScissor({{0, 0}, {m_Width, m_Height}});
+  commandBuffer->BindDescriptorSet(m_Pipeline->GetLayout(),
+                                   m_UniformManager->GetDescriptorSet(frame),
+                                   m_UniformManager->GetDynamicOffsets());
+  if (m_EnableBindless) {
+    commandBuffer->BindDescriptorSet(m_Pipeline->GetLayout(),
+                                     m_BindlessTextures->GetDescriptorSet(), {},
+                                     1);
+    commandBuffer->PushConstants(m_Pipeline->GetLayout(),
+                                 VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                                 sizeof(MaterialConstants),
+                                 &m_MaterialConstants);
+  }
+
+  if (m_Scene) {
+    DrawProceduralScene(commandBuffer);
+    return;
+  }
+
+  m_FrameStats.m_TotalObjects = 1;
+  m_FrameStats.m_VisibleObjects = 1;
+  if (m_FrustumCulling) {
+    const auto frustum = Frustum::FromMatrix(m_VPMatrices.mProjectionMatrix *
+                                             m_VPMatrices.mViewMatrix);
+    if (!frustum.IsVisible(m_Model->getBounds().Transform(
+            m_Model->getUniform().mModelMatrix))) {
+      m_FrameStats.m_VisibleObjects = 0;
+      return;
+    }
+  }
+
+  commandBuffer->BindVertexBuffer(m_Model->getVertexBuffers());
+  commandBuffer->BindIndexBuffer(m_Model->getIndexBuffer()->getBuffer());
+  commandBuffer->DrawIndex(m_Model->getIndexCount());
+}
+
+// 每个物体的ObjectUniform从frameAllocator里切一块，换dynamic offset重新绑定材质
+void Application::DrawProceduralScene(
+    const Wrapper::CommandBuffer::Ptr &commandBuffer) {
+  auto &objects = m_Scene->GetObjects();
+  {
+    VK_PROFILE_SCOPE("cull");
+    if (m_FrustumCulling) {
+      m_Culler->Cull(Frustum::FromMatrix(m_VPMatrices.mProjectionMatrix *
+                                         m_VPMatrices.mViewMatrix),
+                     m_VisibleObjects);
+    } else {
+      m_VisibleObjects.resize(objects.size());
+      for (uint32_t i = 0; i < objects.size(); ++i) {
+        m_VisibleObjects[i] = i;
+      }
+    }
+  }
+  m_FrameStats.m_TotalObjects = static_cast<uint32_t>(objects.size());
+  m_FrameStats.m_VisibleObjects =
+      static_cast<uint32_t>(m_VisibleObjects.size());
+
+  auto dynamicOffsets = m_UniformManager->GetDynamicOffsets();
+  for (auto index : m_VisibleObjects) {
+    auto &object = objects[index];
+    dynamicOffsets[1] = static_cast<uint32_t>(
+        m_FrameAllocator->Push(object.m_Uniform).m_Offset);
+    commandBuffer->BindDescriptorSet(m_Pipeline->GetLayout(),
+                                     m_SceneMaterials[object.m_Texture],
+                                     dynamicOffsets);
+    if (m_EnableBindless) {
+      MaterialConstants constants{};
+      constants.mTextureIndex = m_SceneTextureIndices[object.m_Texture];
+      commandBuffer->PushConstants(m_Pipeline->GetLayout(),
+                                   VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                                   sizeof(MaterialConstants), &constants);
+    }
+
+    auto &model = object.m_Model;
+    commandBuffer->BindVertexBuffer(model->getVertexBuffers());
+    commandBuffer->BindIndexBuffer(model->getIndexBuffer()->getBuffer());
+    commandBuffer->DrawIndex(model->getIndexCount());
   }
 }
 void Application::CreateSyncObjects() {
-  for (int i = 0; i < m_SwapChain->GetImageCount(); ++i) {
+  for (uint32_t i = 0; i < m_FramesInFlight; ++i) {
     auto imageSemaphore = Wrapper::Semaphore::Create(m_Device);
     m_ImageAvailableSemaphores.push_back(imageSemaphore);
 
@@ -210,22 +729,68 @@ void Application::CreateSyncObjects() {
   }
 }
 
+// 第i帧用的是fence[i % n]，往前数latency帧的那个fence完成后，
+// 还在gpu上的帧不超过latency - 1个，加上这一帧正好latency个
+void Application::WaitForFrameLatency() {
+  if (m_FrameLatency == 0 || m_FrameLatency >= m_FramesInFlight) {
+    return;
+  }
+  const uint32_t oldest =
+      (m_CurrentFrame + m_FramesInFlight - m_FrameLatency) % m_FramesInFlight;
+  m_Fences[oldest]->Block();
+}
+
 void Application::Render() {
 
+  // 等待该槽位的上一个commandBuffer执行完毕，之后该帧的临时内存才可以复用
+  {
+    VK_PROFILE_SCOPE("fence wait");
+    m_Fences[m_CurrentFrame]->Block();
+  }
+  // 要在这一帧的fence被重置之前交付
+  if (m_ReadbackRing) {
+    VK_PROFILE_SCOPE("readback");
+    m_ReadbackRing->Poll();
+  }
+  ReleaseRetiredSwapChains();
+  if (m_EnableBindless) {
+    m_BindlessTextures->ReleaseRetired(m_FrameNumber);
+  }
+  m_FrameAllocator->BeginFrame(m_CurrentFrame);
+  {
+    VK_PROFILE_SCOPE("load");
+    m_TextureLoader->Update();
+  }
+  UpdateTextureStreaming();
+  {
+    VK_PROFILE_SCOPE("update");
+    m_UniformManager->Update(m_VPMatrices, m_Model->getUniform());
+  }
+
   uint32_t imageIndex{0};
 
   // 显示完后点亮m_ImageAvailableSemaphores[m_CurrentFrame]，同时该图片供下一次渲染使用
   // 此处的imageIndex 为SwapChain的m_SwapChainImages索引
   // 此时的imageIndex 已经被显示完了，等待渲染
-  auto result = vkAcquireNextImageKHR(
-      m_Device->GetDevice(), m_SwapChain->GetSwapChain(), UINT64_MAX,
-      m_ImageAvailableSemaphores[m_CurrentFrame]->GetSemaphore(),
-      VK_NULL_HANDLE, &imageIndex);
-
-  if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-    ReCreateSwapChain();
-    m_Window->m_WindowResized = false;
-  } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+  VkResult result{VK_SUCCESS};
+  {
+    VK_PROFILE_SCOPE("acquire");
+    result = vkAcquireNextImageKHR(
+        m_Device->GetDevice(), m_SwapChain->GetSwapChain(), UINT64_MAX,
+        m_ImageAvailableSemaphores[m_CurrentFrame]->GetSemaphore(),
+        VK_NULL_HANDLE, &imageIndex);
+
+    // 失败的acquire不会点亮semaphore，重建后在新swapchain上重新acquire，这一帧不丢
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      ReCreateSwapChain();
+      m_Window->m_WindowResized = false;
+      result = vkAcquireNextImageKHR(
+          m_Device->GetDevice(), m_SwapChain->GetSwapChain(), UINT64_MAX,
+          m_ImageAvailableSemaphores[m_CurrentFrame]->GetSemaphore(),
+          VK_NULL_HANDLE, &imageIndex);
+    }
+  }
+  if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
     throw std::runtime_error("Error: failed to acquire next image");
   }
 
@@ -241,8 +806,13 @@ void Application::Render() {
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
 
+  {
+    VK_PROFILE_SCOPE("record");
+    RecordCommandBuffer(m_CurrentFrame, imageIndex);
+  }
+
   // 提交哪些命令
-  auto commandBuffer = m_CommandBuffers[imageIndex]->GetCommandBuffer();
+  auto commandBuffer = m_CommandBuffers[m_CurrentFrame]->GetCommandBuffer();
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
 
@@ -250,14 +820,13 @@ void Application::Render() {
       m_RenderFinishedSemaphores[m_CurrentFrame]->GetSemaphore()};
   submitInfo.signalSemaphoreCount = 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
-  // 等待该槽位的上一个commandBuffer执行完毕
-
-  m_Fences[m_CurrentFrame]->Block();
-  // 阻塞住
   m_Fences[m_CurrentFrame]->ResetFence();
-  if (vkQueueSubmit(m_Device->GetGraphicQueue(), 1, &submitInfo,
-                    m_Fences[m_CurrentFrame]->GetFence()) != VK_SUCCESS) {
-    throw std::runtime_error("Fail");
+  {
+    VK_PROFILE_SCOPE("submit");
+    if (vkQueueSubmit(m_Device->GetGraphicQueue(), 1, &submitInfo,
+                      m_Fences[m_CurrentFrame]->GetFence()) != VK_SUCCESS) {
+      throw std::runtime_error("Fail");
+    }
   }
 
   VkPresentInfoKHR presentInfo{};
@@ -271,7 +840,10 @@ void Application::Render() {
   presentInfo.pSwapchains = swapChains;
   presentInfo.pImageIndices = &imageIndex;
 
-  result = vkQueuePresentKHR(m_Device->GetPresentQueue(), &presentInfo);
+  {
+    VK_PROFILE_SCOPE("present");
+    result = vkQueuePresentKHR(m_Device->GetPresentQueue(), &presentInfo);
+  }
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
       m_Window->m_WindowResized) {
     ReCreateSwapChain();
@@ -279,9 +851,70 @@ void Application::Render() {
   } else if (result != VK_SUCCESS) {
     throw std::runtime_error("Error: failed to present");
   }
-  m_CurrentFrame = (m_CurrentFrame + 1) % m_SwapChain->GetImageCount();
+  ++m_FrameNumber;
+  m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesInFlight;
+}
+
+// 没有acquire和present，只用fence控制帧的并行
+void Application::RenderHeadless(uint32_t frameIndex) {
+  {
+    VK_PROFILE_SCOPE("fence wait");
+    m_Fences[m_CurrentFrame]->Block();
+  }
+  if (m_ReadbackRing) {
+    VK_PROFILE_SCOPE("readback");
+    m_ReadbackRing->Poll();
+  }
+  m_FrameNumber = frameIndex;
+  m_FrameAllocator->BeginFrame(m_CurrentFrame);
+  {
+    VK_PROFILE_SCOPE("load");
+    m_TextureLoader->Update();
+  }
+  UpdateTextureStreaming();
+  {
+    VK_PROFILE_SCOPE("update");
+    m_UniformManager->Update(m_VPMatrices, m_Model->getUniform());
+  }
+  {
+    VK_PROFILE_SCOPE("record");
+    RecordCommandBuffer(m_CurrentFrame, 0);
+  }
+
+  m_Fences[m_CurrentFrame]->ResetFence();
+  {
+    VK_PROFILE_SCOPE("submit");
+    m_CommandBuffers[m_CurrentFrame]->Submit(
+        m_Device->GetGraphicQueue(), m_Fences[m_CurrentFrame]->GetFence());
+  }
+  m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesInFlight;
 }
+
+void Application::WriteFrame(const Wrapper::ReadbackFrame &frame) {
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), "_%04u.%s",
+           static_cast<uint32_t>(frame.m_FrameId),
+           m_HeadlessSettings.m_WriteEXR ? "exr" : "png");
+  const auto path = m_HeadlessSettings.m_OutputPrefix + suffix;
+
+  if (m_HeadlessSettings.m_WriteEXR) {
+    ImageWriter::WriteEXR(path, frame.m_Width, frame.m_Height,
+                          static_cast<const uint16_t *>(frame.m_Data));
+  } else {
+    ImageWriter::WritePNG(path, frame.m_Width, frame.m_Height,
+                          static_cast<const uint8_t *>(frame.m_Data));
+  }
+}
+
 void Application::Run() {
+  if (m_Headless) {
+    InitCamera();
+    InitVulkan();
+
+    HeadlessLoop();
+    CleanUp();
+    return;
+  }
 
   InitWindow();
   InitVulkan();
@@ -303,16 +936,20 @@ void Application::CreatePipeline() {
   scissor.extent = {m_Width, m_Height};
   m_Pipeline->SetViewports({viewport});
   m_Pipeline->SetScissors({scissor});
+  m_Pipeline->SetDynamicStates(
+      {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR});
   std::vector<Wrapper::Shader::Ptr> shaderGroup{};
 
   auto shaderVertex =
-      Wrapper::Shader::Create(m_Device, "D:\\cpp\\vk\\shaders/vs.spv",
+      Wrapper::Shader::Create(m_Device, m_ShaderDirectory + "vs.spv",
                               VK_SHADER_STAGE_VERTEX_BIT, "main");
   shaderGroup.push_back(shaderVertex);
 
-  auto shaderFragment =
-      Wrapper::Shader::Create(m_Device, "D:\\cpp\\vk\\shaders/fs.spv",
-                              VK_SHADER_STAGE_FRAGMENT_BIT, "main");
+  auto shaderFragment = Wrapper::Shader::Create(
+      m_Device,
+      m_ShaderDirectory +
+          (m_EnableBindless ? "fs_bindless.spv" : "fs.spv"),
+      VK_SHADER_STAGE_FRAGMENT_BIT, "main");
   shaderGroup.push_back(shaderFragment);
 
   auto vertexBindingDes = m_Model->getVertexInputBindingDescriptions();
@@ -328,7 +965,7 @@ void Application::CreatePipeline() {
   // 光栅化设置
   m_Pipeline->Make_Raster_Info();
   // 多重采样
-  m_Pipeline->Make_MultiSample_Info();
+  m_Pipeline->Make_MultiSample_Info(m_SampleCount, m_SampleRateShading);
   // TODO深度与模板
 
   // 颜色混合
@@ -338,87 +975,63 @@ void Application::CreatePipeline() {
   m_Pipeline->Make_DepthStecil_Info();
 
   auto pipelineLayout = m_UniformManager->GetDescriptorLayout()->GetLayout();
-  m_Pipeline->Make_LayoutCreate_Info(pipelineLayout);
+  if (m_EnableBindless) {
+    VkPushConstantRange materialRange{};
+    materialRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    materialRange.offset = 0;
+    materialRange.size = sizeof(MaterialConstants);
+    m_Pipeline->Make_LayoutCreate_Info(
+        {pipelineLayout, m_BindlessTextures->GetLayout()}, {materialRange});
+  } else {
+    m_Pipeline->Make_LayoutCreate_Info(pipelineLayout);
+  }
   m_Pipeline->Build();
 }
 
-void Application::CreateRenderPass() {
-
-  VkAttachmentDescription finalAttachmentDes{};
-  finalAttachmentDes.format = m_SwapChain->GetFormat();
-  finalAttachmentDes.samples = VK_SAMPLE_COUNT_1_BIT;
-  finalAttachmentDes.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  finalAttachmentDes.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  finalAttachmentDes.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  finalAttachmentDes.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  finalAttachmentDes.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  finalAttachmentDes.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-  m_RenderPass->AddAttachment(finalAttachmentDes);
-
-  VkAttachmentReference finalAttachmentRef{};
-  finalAttachmentRef.attachment = 0;
-  finalAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-  // 采样attachment
-  VkAttachmentDescription MutiAttachmentDes{};
-  MutiAttachmentDes.format = m_SwapChain->GetFormat();
-  MutiAttachmentDes.samples = m_Device->getMaxUsableSampleCount();
-  MutiAttachmentDes.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  MutiAttachmentDes.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  MutiAttachmentDes.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  MutiAttachmentDes.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  MutiAttachmentDes.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  MutiAttachmentDes.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-  m_RenderPass->AddAttachment(MutiAttachmentDes);
-  VkAttachmentReference mutiAttachmentRef{};
-  mutiAttachmentRef.attachment = 1;
-  mutiAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-  // 深度 attachment
-  VkAttachmentDescription depthAttachmentDes{};
-  depthAttachmentDes.format = Wrapper::Image::findDepthFormat(m_Device);
-  depthAttachmentDes.samples = m_Device->getMaxUsableSampleCount();
-  depthAttachmentDes.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depthAttachmentDes.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depthAttachmentDes.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  depthAttachmentDes.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depthAttachmentDes.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  depthAttachmentDes.finalLayout =
-      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-  m_RenderPass->AddAttachment(depthAttachmentDes);
-  VkAttachmentReference depthAttachmentRef{};
-  depthAttachmentRef.attachment = 2;
-  depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-  // 做一个subpass
-  Wrapper::SubPass subPass{};
-  // colorAttachment = 多重采样图片
-  //  ResolveAttachment，对colorAttachment的每个像素内的采样点做平均值
-  subPass.AddColorAttachmentReference(mutiAttachmentRef);
-  subPass.SetDepthStencilAttachmentReference(depthAttachmentRef);
-  subPass.setResolveAttachmentReference(finalAttachmentRef);
-  subPass.BuildSubPassDescription();
-
-  m_RenderPass->AddSubPass(subPass);
-  // 创建依赖关系，这里需要按流程创建一个虚拟阶段
-  VkSubpassDependency dependency{};
-  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.dstSubpass = 0;
-  // 上一个pass在哪一个stage的哪一个操作完成
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.srcAccessMask = 0;
-  // P一个pass在哪一个stage的哪一个操作阻塞
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
-                             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-  m_RenderPass->AddDependency(dependency);
-
-  m_RenderPass->BuildRenderPass();
+void Application::CreateRenderGraph() {
+  m_RenderGraph =
+      Wrapper::RenderGraph::Create(m_Device, ATTACHMENT_SET_COUNT);
+  m_RenderGraph->SetGpuProfiler(m_GpuProfiler);
+
+  // swapchain image的内容每帧都不保留，从acquire semaphore等待的stage开始同步
+  // 离屏目标由fence保证上一次的回读已经结束，最后留在TRANSFER_SRC给回读拷贝
+  Wrapper::ResourceState backBufferState{};
+  backBufferState.m_Stages = m_Headless
+                                 ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+                                 : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  m_BackBuffer = m_RenderGraph->ImportImage(
+      "backBuffer", {m_ColorFormat, m_Width, m_Height}, backBufferState,
+      m_Headless ? Wrapper::ResourceUsage::TransferSrc
+                 : Wrapper::ResourceUsage::Present);
+
+  const bool msaa = m_SampleCount != VK_SAMPLE_COUNT_1_BIT;
+  auto sceneDepth = m_RenderGraph->CreateImage(
+      "sceneDepth", {Wrapper::Image::findDepthFormat(m_Device), m_Width,
+                     m_Height, m_SampleCount});
+  // 1x时直接画到swapchain image上，不需要多重采样的颜色和resolve
+  auto sceneColor = msaa ? m_RenderGraph->CreateImage(
+                               "sceneColor", {m_ColorFormat, m_Width,
+                                              m_Height, m_SampleCount})
+                         : m_BackBuffer;
+
+  m_MainPass = m_RenderGraph->AddPass(
+      "scene", Wrapper::RenderGraphPassType::Graphics,
+      [&](Wrapper::RenderGraphPass &pass) {
+        pass.AddColorOutput(sceneColor, VkClearColorValue{{0.0f, 0.0f, 0.0f, 1.0f}});
+        if (msaa) {
+          pass.SetResolveOutput(m_BackBuffer);
+        }
+        pass.SetDepthOutput(sceneDepth, VkClearDepthStencilValue{1.0f, 0});
+      },
+      [this](const Wrapper::CommandBuffer::Ptr &commandBuffer) {
+        DrawScene(commandBuffer, m_CurrentFrame);
+      });
+
+  m_RenderGraph->Compile();
 }
 
+// 只重建和尺寸相关的东西：swapchain、渲染图(attachment和frameBuffer)、回读环
+// pipeline、commandBuffer和同步对象保留，不等待设备空闲
 void Application::ReCreateSwapChain() {
   int width = 0, height = 0;
   glfwGetFramebufferSize(m_Window->GetWindow(), &width, &height);
@@ -427,38 +1040,88 @@ void Application::ReCreateSwapChain() {
     glfwGetFramebufferSize(m_Window->GetWindow(), &width, &height);
   }
 
-  vkDeviceWaitIdle(m_Device->GetDevice());
+  // 回读环按尺寸分配，还在路上的帧先交付掉
+  if (m_ReadbackRing) {
+    m_ReadbackRing->Drain();
+    m_ReadbackRing.reset();
+  }
 
-  CleanupSwapChain();
+  // 旧swapchain传给新的之后退役，已提交的帧可能还在用它的image和旧渲染图
+  RetiredSwapChain retired{};
+  retired.m_SwapChain = m_SwapChain;
+  retired.m_RenderGraph = m_RenderGraph;
+  retired.m_RetireFrame = m_FrameNumber;
 
-  m_SwapChain =
-      Wrapper::SwapChain::Create(m_Device, m_Window, m_Surface, m_CommandPool);
+  const auto oldFormat = m_ColorFormat;
+  m_SwapChain = Wrapper::SwapChain::Create(m_Device, m_Window, m_Surface,
+                                           m_SwapChainSettings, m_SwapChain);
   m_Width = m_SwapChain->GetExtent().width;
   m_Height = m_SwapChain->GetExtent().height;
+  m_ColorFormat = m_SwapChain->GetFormat();
+
+  CreateRenderGraph();
+  CreateReadbackRing();
+
+  // 新旧renderPass的格式和采样数相同时是兼容的，pipeline可以继续用
+  // 否则旧pipeline跟着旧渲染图一起退役，它的renderPass由旧渲染图持有
+  if (m_ColorFormat != oldFormat) {
+    retired.m_Pipeline = m_Pipeline;
+    m_Pipeline = Wrapper::Pipeline::Create(
+        m_Device, m_RenderGraph->GetRenderPass(m_MainPass));
+    CreatePipeline();
+  }
+  m_RetiredSwapChains.push_back(retired);
+}
 
-  m_RenderPass = Wrapper::RenderPass::Create(m_Device);
-  CreateRenderPass();
-
-  m_SwapChain->CreateFrameBuffers(m_RenderPass);
-
-  m_Pipeline = Wrapper::Pipeline::Create(m_Device, m_RenderPass);
-  CreatePipeline();
-
-  m_CommandBuffers.resize(m_SwapChain->GetImageCount());
-
-  CreateCommandBuffer();
+// 纹理换了image(异步加载完成)，引用旧imageView的descriptorSet都要换掉
+// 旧的set和bindless下标都不改写，已经提交的帧还在用它们
+void Application::OnTextureChanged(const Texture::Ptr &texture) {
+  if (texture == m_UniformManager->GetTexture()) {
+    m_UniformManager->RefreshDescriptorSets();
+    if (m_EnableBindless) {
+      m_MaterialConstants.mTextureIndex = m_BindlessTextures->Replace(
+          m_MaterialConstants.mTextureIndex, texture, m_FrameNumber);
+    }
+  }
+  if (m_Scene) {
+    auto &textures = m_Scene->GetTextures();
+    for (size_t i = 0; i < textures.size(); ++i) {
+      if (textures[i] == texture) {
+        m_SceneMaterials[i] = m_UniformManager->GetDescriptorSet(texture);
+        if (m_EnableBindless) {
+          m_SceneTextureIndices[i] = m_BindlessTextures->Replace(
+              m_SceneTextureIndices[i], texture, m_FrameNumber);
+        }
+      }
+    }
+  }
+}
 
-  CreateSyncObjects();
+// 模型包围球投影到屏幕上的大小作为反馈，在录制之前换好这一帧要用的mip
+void Application::UpdateTextureStreaming() {
+  if (!m_TextureStreamer) {
+    return;
+  }
+  VK_PROFILE_SCOPE("stream");
+  const auto bounds =
+      m_Model->getBounds().Transform(m_Model->getUniform().mModelMatrix);
+  m_TextureStreamer->RequestScreenSize(
+      m_StreamedTextureHandle,
+      TextureStreamer::CalculateScreenSize(
+          m_VPMatrices.mViewMatrix, m_VPMatrices.mProjectionMatrix,
+          bounds.m_Center, bounds.m_Radius, m_Height));
+  m_TextureStreamer->Update();
 }
 
-void Application::CleanupSwapChain() {
-  m_SwapChain.reset();
-  m_CommandBuffers.clear();
-  m_Pipeline.reset();
-  m_RenderPass.reset();
-  m_ImageAvailableSemaphores.clear();
-  m_RenderFinishedSemaphores.clear();
-  m_Fences.clear();
+// 每个槽位的fence都至少又等过一次，退役之前提交的帧就全部结束了
+void Application::ReleaseRetiredSwapChains() {
+  m_RetiredSwapChains.erase(
+      std::remove_if(m_RetiredSwapChains.begin(), m_RetiredSwapChains.end(),
+                     [this](const RetiredSwapChain &retired) {
+                       return m_FrameNumber >=
+                              retired.m_RetireFrame + m_FramesInFlight;
+                     }),
+      m_RetiredSwapChains.end());
 }
 
 void Application::OnMouseMove(double xpos, double ypos) {
@@ -37,4 +37,10 @@ struct ObjectUniform {
   glm::mat4 mModelMatrix;
 
   ObjectUniform() { mModelMatrix = glm::mat4(1.0f); }
+};
+
+// bindless模式下每次draw通过push constant告诉shader用哪张纹理
+struct MaterialConstants {
+  uint32_t mTextureIndex{0};
+  uint32_t mSamplerIndex{0};
 };
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include"base.h"
+#include"application.hpp"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+// 无窗口性能测试：程序生成的场景 + 固定的相机路径，结果输出成json
+// 没有gpu的CI上可以用软件实现的ICD(lavapipe/swiftshader)跑，按提交比较
+//
+// vkBenchmark [--meshes N] [--textures N] [--resolution N] [--seed N]
+//             [--frames N] [--warmup N] [--width N] [--height N]
+//             [--shaders dir/] [--output result.json] [--pipeline-stats]
+//             [--no-cull] [--no-bindless]
+
+namespace {
+
+struct BenchmarkSettings {
+    VK::SceneSettings m_Scene{};
+    uint32_t m_Width{1280};
+    uint32_t m_Height{720};
+    uint32_t m_FrameCount{600};
+    // 前面几帧有管线和内存的首次开销，不计入结果
+    uint32_t m_WarmupFrames{60};
+    std::string m_ShaderDirectory{"shaders/"};
+    std::string m_Output{};
+    bool m_PipelineStatistics{false};
+    bool m_FrustumCulling{true};
+    bool m_Bindless{true};
+};
+
+// 按名字累加，最后除以帧数
+struct Accumulator {
+    std::map<std::string, double> m_Sums{};
+    uint64_t m_Count{0};
+
+    void Add(const std::vector<std::pair<std::string, double>> &values) {
+        for (auto &value : values) {
+            m_Sums[value.first] += value.second;
+        }
+        ++m_Count;
+    }
+};
+
+double Percentile(std::vector<double> sorted, double percent) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    const auto rank = static_cast<size_t>(percent / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+void WriteAverages(std::ostream &out, const Accumulator &accumulator) {
+    out << "{";
+    bool first = true;
+    for (auto &sum : accumulator.m_Sums) {
+        out << (first ? "" : ", ");
+        VK::Profiler::WriteJsonString(out, sum.first);
+        out << ": " << (accumulator.m_Count ? sum.second / accumulator.m_Count : 0.0);
+        first = false;
+    }
+    out << "}";
+}
+
+BenchmarkSettings ParseArguments(int argc, char **argv) {
+    BenchmarkSettings settings{};
+    for (int arg = 1; arg < argc; ++arg) {
+        const std::string name = argv[arg];
+        if (name == "--pipeline-stats") {
+            settings.m_PipelineStatistics = true;
+            continue;
+        }
+        if (name == "--no-cull") {
+            settings.m_FrustumCulling = false;
+            continue;
+        }
+        if (name == "--no-bindless") {
+            settings.m_Bindless = false;
+            continue;
+        }
+        if (arg + 1 >= argc) {
+            throw std::runtime_error("Error: missing value for " + name);
+        }
+        const std::string value = argv[++arg];
+        if (name == "--meshes") {
+            const auto count = std::stoul(value);
+            if (count == 0 || count > VK::ProceduralScene::MAX_MESH_COUNT) {
+                throw std::runtime_error("Error: --meshes must be between 1 and " +
+                                         std::to_string(VK::ProceduralScene::MAX_MESH_COUNT));
+            }
+            settings.m_Scene.m_MeshCount = static_cast<uint32_t>(count);
+        } else if (name == "--textures") {
+            settings.m_Scene.m_TextureCount = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--resolution") {
+            settings.m_Scene.m_MeshResolution = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--seed") {
+            settings.m_Scene.m_Seed = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--frames") {
+            settings.m_FrameCount = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--warmup") {
+            settings.m_WarmupFrames = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--width") {
+            settings.m_Width = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--height") {
+            settings.m_Height = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--shaders") {
+            settings.m_ShaderDirectory = value;
+        } else if (name == "--output") {
+            settings.m_Output = value;
+        } else {
+            throw std::runtime_error("Error: unknown benchmark option " + name);
+        }
+    }
+    return settings;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto settings = ParseArguments(argc, argv);
+
+    VK::Application app;
+    VK::HeadlessSettings headless{};
+    headless.m_Width = settings.m_Width;
+    headless.m_Height = settings.m_Height;
+    // 第一帧结束时才开始计时
+    headless.m_FrameCount = 1 + settings.m_WarmupFrames + settings.m_FrameCount;
+    app.SetHeadless(headless);
+    app.SetProceduralScene(settings.m_Scene);
+    app.SetShaderDirectory(settings.m_ShaderDirectory);
+    app.SetPipelineStatistics(settings.m_PipelineStatistics);
+    app.SetFrustumCulling(settings.m_FrustumCulling);
+    app.SetBindless(settings.m_Bindless);
+
+    // 路径长度等于计时的帧数，预热阶段先走一段
+    const float sceneRadius = VK::ProceduralScene::GetRadius(settings.m_Scene);
+    app.SetCameraPath(VK::CameraPath::Orbit(sceneRadius * 1.5f, sceneRadius * 0.5f,
+                                            settings.m_FrameCount));
+
+    std::vector<double> frameTimes{};
+    Accumulator cpuZones{};
+    Accumulator gpuPasses{};
+    std::vector<double> gpuFrameTimes{};
+    uint64_t lastGpuFrame{UINT64_MAX};
+    double draws = 0.0, pipelineBinds = 0.0, descriptorBinds = 0.0, bytesUploaded = 0.0;
+    double visibleObjects = 0.0;
+    std::map<std::string, VK::Wrapper::PipelineStatistics> passStatistics{};
+
+    // Run结束时device已经释放，名字先记下来
+    std::string deviceName{};
+    std::string memoryJson{"{}"};
+    uint64_t frame = 0;
+    std::chrono::steady_clock::time_point last{};
+    app.SetFrameEndCallback([&]() {
+        const auto now = std::chrono::steady_clock::now();
+        const double frameMs = std::chrono::duration<double, std::milli>(now - last).count();
+        last = now;
+        if (frame++ == 0) {
+            deviceName = app.GetDevice()->GetProperties().deviceName;
+            return;
+        }
+        if (frame <= 1 + settings.m_WarmupFrames) {
+            return;
+        }
+        frameTimes.push_back(frameMs);
+        // 场景资源都还在，最后一帧的显存统计就是整个场景的占用
+        if (frame == headless.m_FrameCount) {
+            std::ostringstream memory{};
+            app.GetDevice()->GetMemoryTracker()->WriteJson(memory);
+            memoryJson = memory.str();
+        }
+
+        cpuZones.Add(VK::Profiler::Get().GetLastFrame().m_ZoneMs);
+
+        auto &stats = app.GetFrameStats();
+        draws += stats.m_Commands.mDrawCalls;
+        pipelineBinds += stats.m_Commands.mPipelineBinds;
+        descriptorBinds += stats.m_Commands.mDescriptorBinds;
+        bytesUploaded += static_cast<double>(stats.m_BytesUploaded);
+        visibleObjects += stats.m_VisibleObjects;
+        for (auto &pass : stats.m_PassStatistics) {
+            passStatistics[pass.first] = pass.second;
+        }
+
+        // gpu结果晚几帧才到，同一帧只统计一次，预热帧的结果也不要
+        auto &gpuProfiler = app.GetGpuProfiler();
+        if (gpuProfiler) {
+            auto &gpu = gpuProfiler->GetLastFrame();
+            if (gpu.m_Frame != lastGpuFrame && gpu.m_Frame > settings.m_WarmupFrames) {
+                lastGpuFrame = gpu.m_Frame;
+                gpuFrameTimes.push_back(gpu.m_FrameMs);
+                gpuPasses.Add(gpu.m_ZoneMs);
+            }
+        }
+    });
+
+    app.Run();
+
+    std::ofstream file{};
+    if (!settings.m_Output.empty()) {
+        file.open(settings.m_Output);
+        if (!file) {
+            throw std::runtime_error("Error: failed to write benchmark result " + settings.m_Output);
+        }
+    }
+    std::ostream &out = settings.m_Output.empty() ? std::cout : file;
+
+    const double count = std::max<size_t>(1, frameTimes.size());
+    double total = 0.0;
+    for (auto time : frameTimes) {
+        total += time;
+    }
+
+    out << "{\n";
+    out << "  \"device\": ";
+    VK::Profiler::WriteJsonString(out, deviceName);
+    out << ",\n";
+    out << "  \"scene\": {\"meshes\": " << settings.m_Scene.m_MeshCount
+        << ", \"textures\": " << settings.m_Scene.m_TextureCount
+        << ", \"resolution\": " << settings.m_Scene.m_MeshResolution
+        << ", \"seed\": " << settings.m_Scene.m_Seed
+        << ", \"culling\": " << (settings.m_FrustumCulling ? "true" : "false")
+        << ", \"bindless\": " << (app.IsBindlessEnabled() ? "true" : "false")
+        << ", \"width\": " << settings.m_Width
+        << ", \"height\": " << settings.m_Height << "},\n";
+    out << "  \"frames\": " << frameTimes.size() << ",\n";
+    out << "  \"warmup\": " << settings.m_WarmupFrames << ",\n";
+    out << "  \"frame_ms\": {\"mean\": " << total / count
+        << ", \"p50\": " << Percentile(frameTimes, 50.0)
+        << ", \"p90\": " << Percentile(frameTimes, 90.0)
+        << ", \"p95\": " << Percentile(frameTimes, 95.0)
+        << ", \"p99\": " << Percentile(frameTimes, 99.0)
+        << ", \"max\": " << Percentile(frameTimes, 100.0) << "},\n";
+    out << "  \"cpu_zones_ms\": ";
+    WriteAverages(out, cpuZones);
+    out << ",\n";
+    out << "  \"gpu_frame_ms\": {\"p50\": " << Percentile(gpuFrameTimes, 50.0)
+        << ", \"p95\": " << Percentile(gpuFrameTimes, 95.0)
+        << ", \"frames\": " << gpuFrameTimes.size() << "},\n";
+    out << "  \"gpu_passes_ms\": ";
+    WriteAverages(out, gpuPasses);
+    out << ",\n";
+    out << "  \"counters\": {\"draws\": " << draws / count
+        << ", \"pipeline_binds\": " << pipelineBinds / count
+        << ", \"descriptor_binds\": " << descriptorBinds / count
+        << ", \"bytes_uploaded\": " << bytesUploaded / count
+        << ", \"visible_objects\": " << visibleObjects / count << "},\n";
+    out << "  \"memory\": " << memoryJson << ",\n";
+    out << "  \"pipeline_statistics\": {";
+    bool first = true;
+    for (auto &pass : passStatistics) {
+        out << (first ? "" : ", ");
+        VK::Profiler::WriteJsonString(out, pass.first);
+        out << ": {"
+            << "\"input_primitives\": " << pass.second.m_InputPrimitives
+            << ", \"vertex_invocations\": " << pass.second.m_VertexInvocations
+            << ", \"clipping_primitives\": " << pass.second.m_ClippingPrimitives
+            << ", \"fragment_invocations\": " << pass.second.m_FragmentInvocations << "}";
+        first = false;
+    }
+    out << "}\n";
+    out << "}\n";
+    return 0;
+}
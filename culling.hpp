@@ -0,0 +1,309 @@
+#pragma once
+#include "base.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VK_CULLING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace VK {
+
+struct BoundingSphere {
+  glm::vec3 m_Center{0.0f};
+  float m_Radius{0.0f};
+
+  // 非均匀缩放时按最大的轴放大半径，结果偏保守
+  [[nodiscard]] BoundingSphere Transform(const glm::mat4 &matrix) const {
+    const float scale = std::sqrt(std::max(
+        {glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0])),
+         glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1])),
+         glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]))}));
+    return {glm::vec3(matrix * glm::vec4(m_Center, 1.0f)), m_Radius * scale};
+  }
+
+  // 包围盒中心到最远顶点的距离，positions按xyz紧密排列
+  static BoundingSphere FromPositions(const std::vector<float> &positions);
+};
+
+// 从projection * view里直接取六个平面，法线朝内并且已经归一化
+// base.h里打开了GLM_FORCE_DEPTH_ZERO_TO_ONE，近平面是第三行本身
+struct Frustum {
+  glm::vec4 m_Planes[6]{};
+
+  static Frustum FromMatrix(const glm::mat4 &viewProjection);
+
+  [[nodiscard]] bool IsVisible(const BoundingSphere &sphere) const {
+    for (auto &plane : m_Planes) {
+      if (glm::dot(glm::vec3(plane), sphere.m_Center) + plane.w <
+          -sphere.m_Radius) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// 世界空间的包围球按SoA存放，一次用SSE测4个
+// 物体多的时候分块交给工作线程，调用线程自己也领块，结果按下标升序合并
+class FrustumCuller {
+private:
+  static constexpr uint32_t CHUNK_SIZE{8192};
+  // 少于两块时开线程不划算
+  static constexpr uint32_t PARALLEL_THRESHOLD{2 * CHUNK_SIZE};
+
+  std::vector<float> m_CenterX{};
+  std::vector<float> m_CenterY{};
+  std::vector<float> m_CenterZ{};
+  std::vector<float> m_Radius{};
+
+  std::vector<std::thread> m_Workers{};
+  std::mutex m_Mutex{};
+  std::condition_variable m_StartCondition{};
+  std::condition_variable m_DoneCondition{};
+  uint64_t m_Generation{0};
+  uint32_t m_Running{0};
+  bool m_Stop{false};
+
+  // 当前这次Cull的任务，m_Generation变化之前写好
+  Frustum m_Frustum{};
+  uint32_t m_ChunkCount{0};
+  std::atomic<uint32_t> m_NextChunk{0};
+  std::vector<std::vector<uint32_t>> m_ChunkResults{};
+
+public:
+  using Ptr = std::shared_ptr<FrustumCuller>;
+  static Ptr Create(uint32_t threadCount = 0) {
+    return std::make_shared<FrustumCuller>(threadCount);
+  }
+
+  // threadCount为0时按cpu核数减一，最多7个，剩下的核留给录制和加载
+  FrustumCuller(uint32_t threadCount);
+  ~FrustumCuller();
+
+  uint32_t Add(const BoundingSphere &sphere);
+  void Set(uint32_t index, const BoundingSphere &sphere);
+  void Clear();
+  [[nodiscard]] auto GetCount() const {
+    return static_cast<uint32_t>(m_Radius.size());
+  }
+  [[nodiscard]] auto GetThreadCount() const { return m_Workers.size(); }
+
+  // visible里是可见物体的下标，升序
+  void Cull(const Frustum &frustum, std::vector<uint32_t> &visible);
+
+private:
+  void CullRange(const Frustum &frustum, uint32_t begin, uint32_t end,
+                 std::vector<uint32_t> &visible) const;
+  void RunChunks();
+  void WorkerLoop();
+};
+
+BoundingSphere BoundingSphere::FromPositions(const std::vector<float> &positions) {
+  if (positions.size() < 3) {
+    return {};
+  }
+  glm::vec3 minimum{positions[0], positions[1], positions[2]};
+  glm::vec3 maximum = minimum;
+  for (size_t i = 3; i + 2 < positions.size(); i += 3) {
+    const glm::vec3 position{positions[i], positions[i + 1], positions[i + 2]};
+    minimum = glm::min(minimum, position);
+    maximum = glm::max(maximum, position);
+  }
+
+  BoundingSphere sphere{};
+  sphere.m_Center = 0.5f * (minimum + maximum);
+  float radius2 = 0.0f;
+  for (size_t i = 0; i + 2 < positions.size(); i += 3) {
+    const glm::vec3 offset =
+        glm::vec3{positions[i], positions[i + 1], positions[i + 2]} -
+        sphere.m_Center;
+    radius2 = std::max(radius2, glm::dot(offset, offset));
+  }
+  sphere.m_Radius = std::sqrt(radius2);
+  return sphere;
+}
+
+Frustum Frustum::FromMatrix(const glm::mat4 &viewProjection) {
+  // glm按列存，row(i)是第i行
+  auto row = [&](int i) {
+    return glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                     viewProjection[2][i], viewProjection[3][i]);
+  };
+  Frustum frustum{};
+  frustum.m_Planes[0] = row(3) + row(0); // left
+  frustum.m_Planes[1] = row(3) - row(0); // right
+  frustum.m_Planes[2] = row(3) + row(1); // bottom
+  frustum.m_Planes[3] = row(3) - row(1); // top
+  frustum.m_Planes[4] = row(2);          // near
+  frustum.m_Planes[5] = row(3) - row(2); // far
+  for (auto &plane : frustum.m_Planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return frustum;
+}
+
+FrustumCuller::FrustumCuller(uint32_t threadCount) {
+  if (threadCount == 0) {
+    threadCount = std::min(7u, std::max(2u, std::thread::hardware_concurrency()) - 1);
+  }
+  for (uint32_t i = 0; i < threadCount; ++i) {
+    m_Workers.emplace_back(&FrustumCuller::WorkerLoop, this);
+  }
+}
+
+FrustumCuller::~FrustumCuller() {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stop = true;
+  }
+  m_StartCondition.notify_all();
+  for (auto &worker : m_Workers) {
+    worker.join();
+  }
+}
+
+uint32_t FrustumCuller::Add(const BoundingSphere &sphere) {
+  m_CenterX.push_back(sphere.m_Center.x);
+  m_CenterY.push_back(sphere.m_Center.y);
+  m_CenterZ.push_back(sphere.m_Center.z);
+  m_Radius.push_back(sphere.m_Radius);
+  return GetCount() - 1;
+}
+
+void FrustumCuller::Set(uint32_t index, const BoundingSphere &sphere) {
+  m_CenterX[index] = sphere.m_Center.x;
+  m_CenterY[index] = sphere.m_Center.y;
+  m_CenterZ[index] = sphere.m_Center.z;
+  m_Radius[index] = sphere.m_Radius;
+}
+
+void FrustumCuller::Clear() {
+  m_CenterX.clear();
+  m_CenterY.clear();
+  m_CenterZ.clear();
+  m_Radius.clear();
+}
+
+void FrustumCuller::CullRange(const Frustum &frustum, uint32_t begin,
+                              uint32_t end,
+                              std::vector<uint32_t> &visible) const {
+  uint32_t i = begin;
+#ifdef VK_CULLING_SSE2
+  __m128 planes[6][4];
+  for (int p = 0; p < 6; ++p) {
+    for (int c = 0; c < 4; ++c) {
+      planes[p][c] = _mm_set1_ps(frustum.m_Planes[p][c]);
+    }
+  }
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + 4 <= end; i += 4) {
+    const __m128 x = _mm_loadu_ps(&m_CenterX[i]);
+    const __m128 y = _mm_loadu_ps(&m_CenterY[i]);
+    const __m128 z = _mm_loadu_ps(&m_CenterZ[i]);
+    const __m128 r = _mm_loadu_ps(&m_Radius[i]);
+    // 到每个平面的距离 + 半径 >= 0 才可能可见
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < 6; ++p) {
+      __m128 distance = _mm_add_ps(_mm_mul_ps(planes[p][0], x), planes[p][3]);
+      distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][1], y));
+      distance = _mm_add_ps(distance, _mm_mul_ps(planes[p][2], z));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+    }
+    const int mask = _mm_movemask_ps(inside);
+    for (int lane = 0; lane < 4; ++lane) {
+      if (mask & (1 << lane)) {
+        visible.push_back(i + lane);
+      }
+    }
+  }
+#endif
+  for (; i < end; ++i) {
+    bool inside = true;
+    for (auto &plane : frustum.m_Planes) {
+      inside = inside && plane.x * m_CenterX[i] + plane.y * m_CenterY[i] +
+                                 plane.z * m_CenterZ[i] + plane.w >=
+                             -m_Radius[i];
+    }
+    if (inside) {
+      visible.push_back(i);
+    }
+  }
+}
+
+void FrustumCuller::Cull(const Frustum &frustum,
+                         std::vector<uint32_t> &visible) {
+  visible.clear();
+  const uint32_t count = GetCount();
+  if (m_Workers.empty() || count < PARALLEL_THRESHOLD) {
+    CullRange(frustum, 0, count, visible);
+    return;
+  }
+
+  m_Frustum = frustum;
+  m_ChunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  if (m_ChunkResults.size() < m_ChunkCount) {
+    m_ChunkResults.resize(m_ChunkCount);
+  }
+  m_NextChunk.store(0, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Generation++;
+    m_Running = static_cast<uint32_t>(m_Workers.size());
+  }
+  m_StartCondition.notify_all();
+
+  RunChunks();
+  {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_DoneCondition.wait(lock, [this] { return m_Running == 0; });
+  }
+
+  for (uint32_t chunk = 0; chunk < m_ChunkCount; ++chunk) {
+    visible.insert(visible.end(), m_ChunkResults[chunk].begin(),
+                   m_ChunkResults[chunk].end());
+  }
+}
+
+void FrustumCuller::RunChunks() {
+  const uint32_t count = GetCount();
+  while (true) {
+    const uint32_t chunk = m_NextChunk.fetch_add(1, std::memory_order_relaxed);
+    if (chunk >= m_ChunkCount) {
+      return;
+    }
+    auto &result = m_ChunkResults[chunk];
+    result.clear();
+    CullRange(m_Frustum, chunk * CHUNK_SIZE,
+              std::min(count, (chunk + 1) * CHUNK_SIZE), result);
+  }
+}
+
+void FrustumCuller::WorkerLoop() {
+  uint64_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_StartCondition.wait(
+          lock, [&] { return m_Stop || m_Generation != generation; });
+      if (m_Stop) {
+        return;
+      }
+      generation = m_Generation;
+    }
+
+    RunChunks();
+
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Running--;
+    }
+    m_DoneCondition.notify_one();
+  }
+}
+
+} // namespace VK
@@ -1,9 +1,130 @@
 #include"base.h"
 #include"application.hpp" 
 
-int main() {
+#include <filesystem>
+
+// --headless [帧数] [输出前缀] [--exr]，不给前缀时只渲染不回读
+// --present fifo|relaxed|mailbox|immediate  --images N  --latency N
+// --profile trace.json  --profile-summary N  --pipeline-stats
+// --memory-report memory.json  --no-cull  --no-bindless
+// --stream-texture texture.ktx2  --shaders dir  --assets dir
+// 选项顺序任意，无窗口模式没给目录时用可执行文件旁边的shaders/和assets/
+namespace {
+
+std::string NextValue(int argc, char **argv, int &arg) {
+    if (arg + 1 >= argc) {
+        throw std::runtime_error("Error: missing value for " + std::string(argv[arg]));
+    }
+    return argv[++arg];
+}
+
+uint32_t NextNumber(int argc, char **argv, int &arg) {
+    const std::string name = argv[arg];
+    const std::string value = NextValue(argc, argv, arg);
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+        throw std::runtime_error("Error: " + name + " expects a number, got " + value);
+    }
+    return static_cast<uint32_t>(std::stoul(value));
+}
+
+VkPresentModeKHR ParsePresentMode(const std::string &mode) {
+    if (mode == "fifo") {
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+    if (mode == "relaxed") {
+        return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    }
+    if (mode == "mailbox") {
+        return VK_PRESENT_MODE_MAILBOX_KHR;
+    }
+    if (mode == "immediate") {
+        return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    }
+    throw std::runtime_error("Error: unknown present mode " + mode);
+}
+
+// 目录统一以/结尾，调用方直接拼文件名
+std::string AsDirectory(const std::filesystem::path &path) {
+    return (path / "").generic_string();
+}
+
+void ParseArguments(int argc, char **argv, VK::Application &app) {
+    bool headless = false;
+    VK::HeadlessSettings settings{};
+    std::string shaderDirectory{};
+    std::string assetDirectory{};
+    for (int arg = 1; arg < argc; ++arg) {
+        const std::string name = argv[arg];
+        if (name == "--headless") {
+            headless = true;
+            if (arg + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[arg + 1][0]))) {
+                settings.m_FrameCount = NextNumber(argc, argv, arg);
+            }
+            if (arg + 1 < argc && argv[arg + 1][0] != '-') {
+                settings.m_OutputPrefix = argv[++arg];
+            }
+        } else if (name == "--exr") {
+            settings.m_WriteEXR = true;
+        } else if (name == "--pipeline-stats") {
+            app.SetPipelineStatistics(true);
+        } else if (name == "--no-cull") {
+            app.SetFrustumCulling(false);
+        } else if (name == "--no-bindless") {
+            app.SetBindless(false);
+        } else if (name == "--present") {
+            app.SetPresentMode(ParsePresentMode(NextValue(argc, argv, arg)));
+        } else if (name == "--images") {
+            app.SetSwapChainImageCount(NextNumber(argc, argv, arg));
+        } else if (name == "--latency") {
+            app.SetFrameLatency(NextNumber(argc, argv, arg));
+        } else if (name == "--profile") {
+            app.SetProfileOutput(NextValue(argc, argv, arg));
+        } else if (name == "--profile-summary") {
+            app.SetProfileSummaryInterval(NextNumber(argc, argv, arg));
+        } else if (name == "--memory-report") {
+            app.SetMemoryReport(NextValue(argc, argv, arg));
+        } else if (name == "--stream-texture") {
+            app.SetStreamedTexture(NextValue(argc, argv, arg));
+        } else if (name == "--shaders") {
+            shaderDirectory = AsDirectory(NextValue(argc, argv, arg));
+        } else if (name == "--assets") {
+            assetDirectory = AsDirectory(NextValue(argc, argv, arg));
+        } else {
+            throw std::runtime_error("Error: unknown option " + name);
+        }
+    }
+    if (settings.m_WriteEXR && !headless) {
+        throw std::runtime_error("Error: --exr needs --headless");
+    }
+    if (headless) {
+        app.SetHeadless(settings);
+        const auto executableDirectory = std::filesystem::path(argv[0]).parent_path();
+        if (shaderDirectory.empty()) {
+            shaderDirectory = AsDirectory(executableDirectory / "shaders");
+        }
+        if (assetDirectory.empty()) {
+            assetDirectory = AsDirectory(executableDirectory / "assets");
+        }
+    }
+    if (!shaderDirectory.empty()) {
+        app.SetShaderDirectory(shaderDirectory);
+    }
+    if (!assetDirectory.empty()) {
+        app.SetAssetDirectory(assetDirectory);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
 
     VK:: Application app;
+    try {
+        ParseArguments(argc, argv, app);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
     app.Run();
     return 0;
 
@@ -0,0 +1,501 @@
+#include"base.h"
+#include"culling.hpp"
+#include"model.hpp"
+#include"scene.hpp"
+#include"VulkanWrapper/descriptorSetCache.hpp"
+#include"VulkanWrapper/resourceStateTracker.hpp"
+#include"texture/blockCompressor.hpp"
+#include"texture/imageWriter.hpp"
+#include"texture/mipmapGenerator.hpp"
+#include"texture/texture.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+// cpu热点的微基准，不创建instance/device，没有gpu的机器上也能跑
+// 每项自动加倍迭代次数直到超过最短时间，输出ops/s和bytes/s
+// 录制前的cpu部分(barrier生成、descriptor数据)直接测，录制本身写进内存里的命令流代替驱动的commandBuffer
+//
+// vkMicrobench [--filter name] [--min-time seconds] [--output result.json]
+
+namespace {
+
+struct BenchSettings {
+    std::string m_Filter{};
+    double m_MinTime{0.5};
+    std::string m_Output{};
+};
+
+struct BenchResult {
+    std::string m_Name{};
+    uint64_t m_Iterations{0};
+    double m_Seconds{0.0};
+    // 每次迭代处理的字节数，0表示不统计吞吐
+    uint64_t m_Bytes{0};
+};
+
+// 防止结果没被使用时整段计算被优化掉
+volatile uint64_t g_Sink = 0;
+
+class BenchSuite {
+private:
+    BenchSettings m_Settings{};
+    std::vector<BenchResult> m_Results{};
+
+public:
+    explicit BenchSuite(const BenchSettings &settings) : m_Settings(settings) {}
+
+    // body返回的值只用来喂给g_Sink
+    void Run(const std::string &name, uint64_t bytesPerIteration,
+             const std::function<uint64_t()> &body) {
+        if (!m_Settings.m_Filter.empty() && name.find(m_Settings.m_Filter) == std::string::npos) {
+            return;
+        }
+        // 先跑一次，把首次分配和缓存冷启动排除掉
+        g_Sink = g_Sink + body();
+
+        uint64_t iterations = 1;
+        double seconds = 0.0;
+        while (true) {
+            const auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                g_Sink = g_Sink + body();
+            }
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (seconds >= m_Settings.m_MinTime || iterations >= (1ull << 40)) {
+                break;
+            }
+            // 按已经测到的速度估计，最多一次放大10倍
+            const double scale = seconds > 0.0 ? 1.4 * m_Settings.m_MinTime / seconds : 10.0;
+            iterations = static_cast<uint64_t>(iterations * std::min(10.0, std::max(2.0, scale)));
+        }
+
+        BenchResult result{name, iterations, seconds, bytesPerIteration};
+        const double nsPerOp = seconds * 1e9 / iterations;
+        std::printf("%-32s %12llu iters %14.1f ns/op %14.1f ops/s", name.c_str(),
+                    static_cast<unsigned long long>(iterations), nsPerOp, iterations / seconds);
+        if (bytesPerIteration != 0) {
+            std::printf(" %10.1f MB/s", bytesPerIteration * iterations / seconds / (1024.0 * 1024.0));
+        }
+        std::printf("\n");
+        m_Results.push_back(result);
+    }
+
+    void WriteJson(std::ostream &out) const {
+        out << "{\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < m_Results.size(); ++i) {
+            auto &result = m_Results[i];
+            out << "    {\"name\": \"" << result.m_Name << "\""
+                << ", \"iterations\": " << result.m_Iterations
+                << ", \"ns_per_op\": " << result.m_Seconds * 1e9 / result.m_Iterations
+                << ", \"ops_per_second\": " << result.m_Iterations / result.m_Seconds
+                << ", \"bytes_per_second\": " << result.m_Bytes * result.m_Iterations / result.m_Seconds
+                << "}" << (i + 1 < m_Results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+    }
+};
+
+BenchSettings ParseArguments(int argc, char **argv) {
+    BenchSettings settings{};
+    for (int arg = 1; arg < argc; ++arg) {
+        const std::string name = argv[arg];
+        if (arg + 1 >= argc) {
+            throw std::runtime_error("Error: missing value for " + name);
+        }
+        const std::string value = argv[++arg];
+        if (name == "--filter") {
+            settings.m_Filter = value;
+        } else if (name == "--min-time") {
+            settings.m_MinTime = std::stod(value);
+        } else if (name == "--output") {
+            settings.m_Output = value;
+        } else {
+            throw std::runtime_error("Error: unknown microbench option " + name);
+        }
+    }
+    return settings;
+}
+
+// 经纬网格的球，v/vt共用下标，接缝处的顶点会被重复引用，去重才有意义
+std::string GenerateObj(uint32_t resolution) {
+    std::string obj{};
+    char line[128];
+    for (uint32_t i = 0; i <= resolution; ++i) {
+        const float theta = glm::pi<float>() * i / resolution;
+        for (uint32_t j = 0; j <= resolution; ++j) {
+            const float phi = 2.0f * glm::pi<float>() * j / resolution;
+            std::snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\n",
+                          std::sin(theta) * std::cos(phi), std::cos(theta),
+                          std::sin(theta) * std::sin(phi),
+                          static_cast<float>(j) / resolution, static_cast<float>(i) / resolution);
+            obj += line;
+        }
+    }
+    for (uint32_t i = 0; i < resolution; ++i) {
+        for (uint32_t j = 0; j < resolution; ++j) {
+            // obj下标从1开始
+            const uint32_t a = i * (resolution + 1) + j + 1;
+            const uint32_t b = a + resolution + 1;
+            std::snprintf(line, sizeof(line), "f %u/%u %u/%u %u/%u\nf %u/%u %u/%u %u/%u\n",
+                          a, a, a + 1, a + 1, b, b, a + 1, a + 1, b + 1, b + 1, b, b);
+            obj += line;
+        }
+    }
+    return obj;
+}
+
+void WriteText(const std::string &path, const std::string &text) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Error: failed to write " + path);
+    }
+    file << text;
+}
+
+void ModelBenchmarks(BenchSuite &suite, const std::filesystem::path &directory) {
+    const auto objPath = (directory / "sphere.obj").string();
+    const auto obj = GenerateObj(256);
+    WriteText(objPath, obj);
+
+    // 构造函数不用device
+    auto model = VK::Model::Create(nullptr);
+    suite.Run("model/parse_obj", obj.size(), [&]() {
+        model->parseModel(objPath);
+        return static_cast<uint64_t>(model->getIndexCount());
+    });
+
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, objPath.c_str())) {
+        throw std::runtime_error("Error: failed to load " + objPath);
+    }
+    uint64_t indexCount = 0;
+    for (auto &shape : shapes) {
+        indexCount += shape.mesh.indices.size();
+    }
+    suite.Run("model/vertex_dedup", indexCount * sizeof(tinyobj::index_t), [&]() {
+        model->buildMesh(attrib, shapes);
+        return static_cast<uint64_t>(model->getVertexCount());
+    });
+}
+
+void TextureBenchmarks(BenchSuite &suite, const std::filesystem::path &directory) {
+    const uint32_t size = 1024;
+    const auto source = VK::ProceduralScene::GenerateTexture(size, 7);
+    const auto pngPath = (directory / "texture.png").string();
+    VK::ImageWriter::WritePNG(pngPath, size, size, source.mData.data());
+    const uint64_t pixelBytes = source.mData.size();
+
+    suite.Run("texture/generate", pixelBytes, []() {
+        return static_cast<uint64_t>(VK::ProceduralScene::GenerateTexture(size, 7).mData.size());
+    });
+    // ImageWriter只写store块，这里主要是stb的解析和拷贝开销，不是inflate
+    suite.Run("texture/decode_png", pixelBytes, [&]() {
+        return static_cast<uint64_t>(VK::Texture::DecodeFile(pngPath, false).mData.size());
+    });
+    suite.Run("texture/mipmaps_srgb", pixelBytes, [&]() {
+        auto levels = VK::MipmapGenerator::Generate(source.mData.data(), size, size, true);
+        return static_cast<uint64_t>(levels.size());
+    });
+    suite.Run("texture/compress_bc1", pixelBytes, [&]() {
+        return static_cast<uint64_t>(
+            VK::BlockCompressor::Compress(VK_FORMAT_BC1_RGB_SRGB_BLOCK, source.mData.data(), size, size).size());
+    });
+    suite.Run("texture/compress_bc3", pixelBytes, [&]() {
+        return static_cast<uint64_t>(
+            VK::BlockCompressor::Compress(VK_FORMAT_BC3_SRGB_BLOCK, source.mData.data(), size, size).size());
+    });
+}
+
+// 和DrawProceduralScene每帧做的一样：每个物体算model矩阵写进连续的uniform区
+void MatrixBenchmarks(BenchSuite &suite) {
+    const uint32_t objectCount = 4096;
+    std::vector<glm::vec3> positions(objectCount);
+    for (uint32_t i = 0; i < objectCount; ++i) {
+        positions[i] = glm::vec3(VK::ProceduralScene::Random(1, i), VK::ProceduralScene::Random(2, i),
+                                 VK::ProceduralScene::Random(3, i)) * 100.0f;
+    }
+    std::vector<ObjectUniform> uniforms(objectCount);
+    float angle = 0.0f;
+    suite.Run("matrix/object_uniforms_4096", objectCount * sizeof(ObjectUniform), [&]() {
+        angle += 0.5f;
+        for (uint32_t i = 0; i < objectCount; ++i) {
+            uniforms[i].mModelMatrix = glm::rotate(glm::translate(glm::mat4(1.0f), positions[i]),
+                                                   glm::radians(angle + i), glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+        return static_cast<uint64_t>(uniforms[objectCount - 1].mModelMatrix[3][0]);
+    });
+
+    Camera camera{};
+    camera.setPerpective(45.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+    const auto path = VK::CameraPath::Orbit(50.0f, 10.0f, 600);
+    uint64_t frame = 0;
+    std::vector<glm::mat4> mvp(objectCount);
+    suite.Run("matrix/view_projection_4096", objectCount * sizeof(glm::mat4), [&]() {
+        path.Apply(camera, frame++);
+        const auto viewProjection = camera.getProjectMatrix() * camera.getViewMatrix();
+        for (uint32_t i = 0; i < objectCount; ++i) {
+            mvp[i] = viewProjection * uniforms[i].mModelMatrix;
+        }
+        return static_cast<uint64_t>(mvp[objectCount - 1][3][3]);
+    });
+}
+
+// 10万个物体随机撒在相机周围，大约四分之一落在视锥里
+void CullingBenchmarks(BenchSuite &suite) {
+    const uint32_t objectCount = 100000;
+    std::vector<VK::BoundingSphere> spheres(objectCount);
+    auto culler = VK::FrustumCuller::Create();
+    for (uint32_t i = 0; i < objectCount; ++i) {
+        spheres[i].m_Center = (glm::vec3(VK::ProceduralScene::Random(1, i), VK::ProceduralScene::Random(2, i),
+                                         VK::ProceduralScene::Random(3, i)) - 0.5f) * 400.0f;
+        spheres[i].m_Radius = 0.5f + 2.0f * VK::ProceduralScene::Random(4, i);
+        culler->Add(spheres[i]);
+    }
+
+    Camera camera{};
+    camera.setPerpective(45.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+    const auto path = VK::CameraPath::Orbit(50.0f, 10.0f, 600);
+    uint64_t frame = 0;
+    auto nextFrustum = [&]() {
+        path.Apply(camera, frame++);
+        return VK::Frustum::FromMatrix(camera.getProjectMatrix() * camera.getViewMatrix());
+    };
+
+    // 逐个测AoS的包围球，作为对照
+    std::vector<uint32_t> visible{};
+    visible.reserve(objectCount);
+    suite.Run("culling/scalar_aos_100k", objectCount * sizeof(VK::BoundingSphere), [&]() {
+        const auto frustum = nextFrustum();
+        visible.clear();
+        for (uint32_t i = 0; i < objectCount; ++i) {
+            if (frustum.IsVisible(spheres[i])) {
+                visible.push_back(i);
+            }
+        }
+        return static_cast<uint64_t>(visible.size());
+    });
+    suite.Run("culling/simd_soa_threads_100k", objectCount * sizeof(VK::BoundingSphere), [&]() {
+        culler->Cull(nextFrustum(), visible);
+        return static_cast<uint64_t>(visible.size());
+    });
+}
+
+template <typename T>
+T FakeHandle(uint64_t value) {
+    // 64位下non-dispatchable句柄是指针，32位下是uint64_t
+#if defined(VK_USE_64_BIT_PTR_DEFINES) && VK_USE_64_BIT_PTR_DEFINES == 1
+    return reinterpret_cast<T>(static_cast<uintptr_t>(value));
+#else
+    return static_cast<T>(value);
+#endif
+}
+
+// 不调用vkUpdateDescriptorSets，只测拼数据槽和缓存查找用的哈希
+void DescriptorBenchmarks(BenchSuite &suite) {
+    const uint32_t objectCount = 256;
+    const uint32_t slotsPerSet = 4;
+    std::vector<VK::Wrapper::DescriptorData> data{};
+    const auto layout = FakeHandle<VkDescriptorSetLayout>(0x1000);
+    suite.Run("descriptor/build_and_hash_256", objectCount * slotsPerSet * sizeof(VK::Wrapper::DescriptorData),
+              [&]() {
+        uint64_t hash = 0;
+        for (uint32_t object = 0; object < objectCount; ++object) {
+            data.resize(slotsPerSet);
+            memset(data.data(), 0, data.size() * sizeof(VK::Wrapper::DescriptorData));
+            data[0].m_BufferInfo = {FakeHandle<VkBuffer>(0x2000 + object), 0, sizeof(ObjectUniform)};
+            data[1].m_BufferInfo = {FakeHandle<VkBuffer>(0x3000), 0, sizeof(VPMatrices)};
+            for (uint32_t slot = 2; slot < slotsPerSet; ++slot) {
+                data[slot].m_ImageInfo = {FakeHandle<VkSampler>(0x4000), FakeHandle<VkImageView>(0x5000 + object % 8),
+                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            }
+            hash ^= VK::Wrapper::DescriptorSetCache::HashKey(layout, data);
+        }
+        return hash;
+    });
+}
+
+// 一帧里的典型状态变化，barrier只生成不录制
+void StateTrackerBenchmarks(BenchSuite &suite) {
+    const uint32_t imageCount = 64;
+    const uint32_t mipLevels = 8;
+    auto tracker = VK::Wrapper::ResourceStateTracker::Create();
+    suite.Run("tracker/frame_transitions_64", 0, [&]() {
+        for (uint32_t i = 0; i < imageCount; ++i) {
+            const auto image = FakeHandle<VkImage>(0x6000 + i);
+            tracker->Import(image, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, {});
+            tracker->Transition(image, VK::Wrapper::ResourceUsage::ColorAttachment);
+            tracker->Transition(image, VK::Wrapper::ResourceUsage::FragmentShaderRead);
+            // 读后读不需要barrier
+            tracker->Transition(image, VK::Wrapper::ResourceUsage::FragmentShaderRead);
+            tracker->Transition(image, VK::Wrapper::ResourceUsage::TransferSrc);
+        }
+        const auto pending = tracker->GetPendingBarrierCount();
+        tracker->DiscardPending();
+        for (uint32_t i = 0; i < imageCount; ++i) {
+            tracker->Forget(FakeHandle<VkImage>(0x6000 + i));
+        }
+        return static_cast<uint64_t>(pending);
+    });
+}
+
+// 接口和Wrapper::CommandBuffer一致，vkCmd*换成把命令和参数顺序写进一块内存
+// 相当于一个什么都不做的驱动，测出来的是引擎自己每个draw的录制开销
+class StubCommandStream {
+private:
+    std::vector<uint8_t> m_Data{};
+    VK::Wrapper::CommandBufferStats m_Stats{};
+
+    enum class Command : uint32_t {
+        BindPipeline,
+        BindDescriptorSets,
+        PushConstants,
+        BindVertexBuffers,
+        BindIndexBuffer,
+        DrawIndexed
+    };
+
+    void Write(const void *data, size_t size) {
+        const size_t offset = m_Data.size();
+        m_Data.resize(offset + size);
+        memcpy(m_Data.data() + offset, data, size);
+    }
+
+    template <typename T>
+    void Write(const T &value) {
+        Write(&value, sizeof(T));
+    }
+
+public:
+    // 和Begin一样清零计数，内存留着下一次复用
+    void Begin() {
+        m_Data.clear();
+        m_Stats = {};
+    }
+
+    [[nodiscard]] auto &GetStats() const { return m_Stats; }
+    [[nodiscard]] size_t GetSize() const { return m_Data.size(); }
+
+    void BindGraphicPipeline(const VkPipeline &pipeline) {
+        ++m_Stats.mPipelineBinds;
+        Write(Command::BindPipeline);
+        Write(pipeline);
+    }
+    void BindDescriptorSet(const VkPipelineLayout layout, const VkDescriptorSet &descriptorSet,
+                           const std::vector<uint32_t> &dynamicOffsets = {}, uint32_t firstSet = 0) {
+        ++m_Stats.mDescriptorBinds;
+        Write(Command::BindDescriptorSets);
+        Write(layout);
+        Write(firstSet);
+        Write(descriptorSet);
+        Write(static_cast<uint32_t>(dynamicOffsets.size()));
+        Write(dynamicOffsets.data(), dynamicOffsets.size() * sizeof(uint32_t));
+    }
+    void PushConstants(const VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset,
+                       uint32_t size, const void *pValues) {
+        Write(Command::PushConstants);
+        Write(layout);
+        Write(stageFlags);
+        Write(offset);
+        Write(size);
+        Write(pValues, size);
+    }
+    void BindVertexBuffer(const std::vector<VkBuffer> &buffers) {
+        std::vector<VkDeviceSize> offsets(buffers.size(), 0);
+        Write(Command::BindVertexBuffers);
+        Write(static_cast<uint32_t>(buffers.size()));
+        Write(buffers.data(), buffers.size() * sizeof(VkBuffer));
+        Write(offsets.data(), offsets.size() * sizeof(VkDeviceSize));
+    }
+    void BindIndexBuffer(const VkBuffer &buffer) {
+        Write(Command::BindIndexBuffer);
+        Write(buffer);
+        Write(VK_INDEX_TYPE_UINT32);
+    }
+    void DrawIndex(size_t indexCount) {
+        ++m_Stats.mDrawCalls;
+        m_Stats.mIndices += indexCount;
+        Write(Command::DrawIndexed);
+        Write(static_cast<uint32_t>(indexCount));
+    }
+};
+
+// 和Application::DrawProceduralScene同样的循环：每个物体一份uniform、材质set、bindless下标、顶点和索引
+void RecordingBenchmarks(BenchSuite &suite) {
+    const uint32_t objectCount = 4096;
+    const uint32_t meshCount = 16;
+    const uint32_t materialCount = 64;
+    // frameAllocator按minUniformBufferOffsetAlignment对齐，常见的是256
+    const uint32_t uniformStride = 256;
+
+    struct Object {
+        uint32_t m_Mesh{0};
+        uint32_t m_Material{0};
+    };
+    std::vector<Object> objects(objectCount);
+    uint32_t seed = 1;
+    for (auto &object : objects) {
+        seed = seed * 1664525u + 1013904223u;
+        object.m_Mesh = (seed >> 8) % meshCount;
+        object.m_Material = (seed >> 16) % materialCount;
+    }
+    std::vector<std::vector<VkBuffer>> vertexBuffers(meshCount);
+    for (uint32_t i = 0; i < meshCount; ++i) {
+        vertexBuffers[i] = {FakeHandle<VkBuffer>(0x7000 + i)};
+    }
+    const auto pipeline = FakeHandle<VkPipeline>(0x8000);
+    const auto layout = FakeHandle<VkPipelineLayout>(0x8001);
+
+    StubCommandStream stream{};
+    suite.Run("recording/draw_objects_4096", 0, [&]() {
+        stream.Begin();
+        stream.BindGraphicPipeline(pipeline);
+        std::vector<uint32_t> dynamicOffsets{0, 0};
+        uint32_t uniformOffset = 0;
+        for (auto &object : objects) {
+            dynamicOffsets[1] = uniformOffset;
+            uniformOffset += uniformStride;
+            stream.BindDescriptorSet(layout, FakeHandle<VkDescriptorSet>(0x9000 + object.m_Material), dynamicOffsets);
+            MaterialConstants constants{};
+            constants.mTextureIndex = object.m_Material;
+            stream.PushConstants(layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MaterialConstants), &constants);
+            stream.BindVertexBuffer(vertexBuffers[object.m_Mesh]);
+            stream.BindIndexBuffer(FakeHandle<VkBuffer>(0xA000 + object.m_Mesh));
+            stream.DrawIndex(6 * 64 * 64);
+        }
+        return static_cast<uint64_t>(stream.GetSize() + stream.GetStats().mDrawCalls);
+    });
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto settings = ParseArguments(argc, argv);
+
+    const auto directory = std::filesystem::temp_directory_path() / "vkMicrobench";
+    std::filesystem::create_directories(directory);
+
+    BenchSuite suite(settings);
+    ModelBenchmarks(suite, directory);
+    TextureBenchmarks(suite, directory);
+    MatrixBenchmarks(suite);
+    CullingBenchmarks(suite);
+    DescriptorBenchmarks(suite);
+    StateTrackerBenchmarks(suite);
+    RecordingBenchmarks(suite);
+
+    std::filesystem::remove_all(directory);
+
+    if (!settings.m_Output.empty()) {
+        std::ofstream file(settings.m_Output);
+        if (!file) {
+            throw std::runtime_error("Error: failed to write microbench result " + settings.m_Output);
+        }
+        suite.WriteJson(file);
+    }
+    return 0;
+}
@@ -3,7 +3,9 @@
 #include "VulkanWrapper/buffer.hpp"
 #include "VulkanWrapper/device.hpp"
 #include "base.h"
+#include "culling.hpp"
 #include "vulkan/vulkan_core.h"
+#include <unordered_map>
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
@@ -25,6 +27,8 @@ private:
   Wrapper::Buffer::Ptr mIndexBuffer{nullptr};
   ObjectUniform m_Uniform;
   float mAngle{0.0f};
+  // 模型空间的包围球，剔除时再乘model矩阵
+  BoundingSphere mBounds{};
 
 public:
   using Ptr = std::shared_ptr<Model>;
@@ -145,6 +149,7 @@ public:
 
   [[nodiscard]] auto getIndexCount() const { return mIndexDatas.size(); }
   [[nodiscard]] auto getUniform() const { return m_Uniform; }
+  [[nodiscard]] auto &getBounds() const { return mBounds; }
 
   void setModelMatrix(const glm::mat4 matrix) {
     m_Uniform.mModelMatrix = matrix;
@@ -158,6 +163,14 @@ public:
     mAngle += 0.05f;
   }
   void loadModel(const std::string &path, const Wrapper::Device::Ptr &device) {
+    parseModel(path);
+    std::cout << mPositions.size() << std::endl;
+
+    createBuffers(device);
+  }
+
+  // 只解析obj到cpu数组，不创建buffer，没有device也能用
+  void parseModel(const std::string &path) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
@@ -168,24 +181,94 @@ public:
                           path.c_str())) {
       throw std::runtime_error("Error: failed to load model");
     }
+    buildMesh(attrib, shapes);
+  }
 
+  // 位置和uv下标都相同的顶点只保留一份
+  void buildMesh(const tinyobj::attrib_t &attrib,
+                 const std::vector<tinyobj::shape_t> &shapes) {
+    mPositions.clear();
+    mUVs.clear();
+    mIndexDatas.clear();
+    std::unordered_map<uint64_t, unsigned int> uniqueVertices{};
+    uniqueVertices.reserve(attrib.vertices.size() / 3);
     for (const auto &shape : shapes) {
+      mIndexDatas.reserve(mIndexDatas.size() + shape.mesh.indices.size());
       for (const auto &index : shape.mesh.indices) {
-        // ��ȡ������λ������
+        const uint64_t key =
+            static_cast<uint64_t>(static_cast<uint32_t>(index.vertex_index))
+                << 32 |
+            static_cast<uint32_t>(index.texcoord_index);
+        auto found = uniqueVertices.find(key);
+        if (found != uniqueVertices.end()) {
+          mIndexDatas.push_back(found->second);
+          continue;
+        }
+
+        const auto vertex = static_cast<unsigned int>(mPositions.size() / 3);
+        uniqueVertices.emplace(key, vertex);
+        // 取出顶点位置
         mPositions.push_back(attrib.vertices[3 * index.vertex_index + 0]);
         mPositions.push_back(attrib.vertices[3 * index.vertex_index + 1]);
         mPositions.push_back(attrib.vertices[3 * index.vertex_index + 2]);
 
-        // ȡ��uvֵ
+        // 取出uv值
         mUVs.push_back(attrib.texcoords[2 * index.texcoord_index + 0]);
         mUVs.push_back(1.0f - attrib.texcoords[2 * index.texcoord_index + 1]);
 
-        // ����
-        mIndexDatas.push_back(mIndexDatas.size());
+        mIndexDatas.push_back(vertex);
       }
     }
-    std::cout << mPositions.size() << std::endl;
+    mBounds = BoundingSphere::FromPositions(mPositions);
+  }
+
+  [[nodiscard]] auto getVertexCount() const { return mPositions.size() / 3; }
+
+  // 程序生成的球，半径按seed做一点起伏，性能测试用，不依赖模型文件
+  void generateMesh(uint32_t resolution, uint32_t seed,
+                    const Wrapper::Device::Ptr &device) {
+    resolution = std::max(3u, resolution);
+    mPositions.clear();
+    mUVs.clear();
+    mIndexDatas.clear();
+
+    const float pi = glm::pi<float>();
+    for (uint32_t i = 0; i <= resolution; ++i) {
+      const float theta = pi * i / resolution;
+      for (uint32_t j = 0; j <= resolution; ++j) {
+        const float phi = 2.0f * pi * j / resolution;
+        // 经线首尾和两极取同一个起伏，不会裂开
+        float radius = 1.0f;
+        if (i != 0 && i != resolution) {
+          uint32_t hash = seed * 73856093u ^ i * 19349663u ^
+                          (j % resolution) * 83492791u;
+          hash = (hash ^ (hash >> 13)) * 0x5bd1e995u;
+          radius += 0.15f * (static_cast<float>(hash >> 8) / 16777216.0f - 0.5f);
+        }
+        mPositions.push_back(radius * std::sin(theta) * std::cos(phi));
+        mPositions.push_back(radius * std::cos(theta));
+        mPositions.push_back(radius * std::sin(theta) * std::sin(phi));
+
+        mUVs.push_back(static_cast<float>(j) / resolution);
+        mUVs.push_back(static_cast<float>(i) / resolution);
+      }
+    }
+
+    // 从外面看是逆时针
+    for (uint32_t i = 0; i < resolution; ++i) {
+      for (uint32_t j = 0; j < resolution; ++j) {
+        const uint32_t a = i * (resolution + 1) + j;
+        const uint32_t b = a + resolution + 1;
+        mIndexDatas.insert(mIndexDatas.end(), {a, a + 1, b, a + 1, b + 1, b});
+      }
+    }
+    mBounds = BoundingSphere::FromPositions(mPositions);
+
+    createBuffers(device);
+  }
 
+private:
+  void createBuffers(const Wrapper::Device::Ptr &device) {
     mPositionBuffer = Wrapper::Buffer::CreateVertexBuffer(
         device, mPositions.size() * sizeof(float), mPositions.data());
 
@@ -0,0 +1,329 @@
+#pragma once
+#include "base.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+// 编译时设为0可以去掉所有打点，宏展开为空
+#ifndef VK_ENABLE_PROFILER
+#define VK_ENABLE_PROFILER 1
+#endif
+
+namespace VK {
+
+// 一段计时，时间单位是纳秒
+struct ProfilerZone {
+  const char *m_Name{nullptr};
+  uint64_t m_Start{0};
+  uint64_t m_End{0};
+  uint32_t m_Depth{0};
+  uint64_t m_Frame{0};
+};
+
+// 一帧里按名字累加的时间
+struct ProfilerFrameSummary {
+  uint64_t m_Frame{0};
+  double m_FrameMs{0.0};
+  std::vector<std::pair<std::string, double>> m_ZoneMs{};
+};
+
+// cpu分段计时
+// 每个线程一个固定大小的环形缓冲，打点只写本线程的缓冲，不加锁
+// 缓冲写满后覆盖最旧的记录，导出和统计只看还在缓冲里的部分
+// 名字必须是字符串常量，只保存指针，运行时拼出来的名字先用Intern转一下
+// gpu等外部时间线用CreateTrack单独建一条轨道，由AddZone补录，不计入每帧汇总
+class Profiler {
+public:
+  static constexpr uint32_t ZONES_PER_THREAD{1 << 16};
+
+private:
+  struct ThreadBuffer {
+    uint32_t m_ThreadIndex{0};
+    std::string m_Name{};
+    bool m_External{false};
+    std::vector<ProfilerZone> m_Zones{};
+    // 已经写入的总数，取模得到环里的位置
+    std::atomic<uint64_t> m_WriteCount{0};
+    // EndFrame统计到的位置
+    uint64_t m_SummaryCount{0};
+    uint32_t m_Depth{0};
+  };
+
+  std::mutex m_Mutex{};
+  std::vector<std::unique_ptr<ThreadBuffer>> m_Buffers{};
+  uint32_t m_ThreadCount{0};
+  std::unordered_set<std::string> m_Names{};
+  std::atomic<uint64_t> m_Frame{0};
+  uint64_t m_FrameStart{0};
+  ProfilerFrameSummary m_LastFrame{};
+
+  ThreadBuffer &GetThreadBuffer();
+  ThreadBuffer &AddBuffer(const std::string &name, bool external);
+  static void WriteZone(ThreadBuffer &buffer, const char *name, uint64_t start,
+                        uint64_t end, uint32_t depth, uint64_t frame);
+
+public:
+  // 带引号和转义写出一个json字符串，benchmark的报告也用它
+  static void WriteJsonString(std::ostream &out, const std::string &value);
+  static Profiler &Get() {
+    static Profiler profiler{};
+    return profiler;
+  }
+
+  static uint64_t Now() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+  }
+
+  // 由Scope调用
+  uint32_t BeginZone();
+  void EndZone(const char *name, uint64_t start, uint32_t depth);
+
+  // 外部时间线，时间要先换算到Now()的时钟上
+  uint32_t CreateTrack(const std::string &name);
+  void AddZone(uint32_t track, const char *name, uint64_t start, uint64_t end,
+               uint32_t depth, uint64_t frame);
+  // 返回的指针在程序结束前一直有效
+  const char *Intern(const std::string &name);
+
+  // 主线程每帧开始和结束各调用一次，EndFrame汇总这一帧所有线程的打点
+  void BeginFrame();
+  void EndFrame();
+
+  [[nodiscard]] uint64_t GetFrame() const { return m_Frame.load(); }
+  [[nodiscard]] const auto &GetLastFrame() const { return m_LastFrame; }
+  void PrintLastFrame(std::ostream &out) const;
+
+  // chrome://tracing 或 Perfetto 可以直接打开
+  void WriteChromeTrace(const std::string &path);
+
+  class Scope {
+  private:
+    const char *m_Name{nullptr};
+    uint64_t m_Start{0};
+    uint32_t m_Depth{0};
+
+  public:
+    explicit Scope(const char *name) : m_Name(name) {
+      m_Depth = Profiler::Get().BeginZone();
+      m_Start = Now();
+    }
+    ~Scope() { Profiler::Get().EndZone(m_Name, m_Start, m_Depth); }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+};
+
+Profiler::ThreadBuffer &Profiler::GetThreadBuffer() {
+  thread_local ThreadBuffer *buffer = nullptr;
+  if (buffer == nullptr) {
+    // 每个线程只在第一次打点时加锁注册一次，缓冲在程序结束前一直有效
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    buffer = &AddBuffer(m_ThreadCount == 0
+                            ? std::string("main")
+                            : "worker " + std::to_string(m_ThreadCount),
+                        false);
+    ++m_ThreadCount;
+  }
+  return *buffer;
+}
+
+// 调用方持有m_Mutex
+Profiler::ThreadBuffer &Profiler::AddBuffer(const std::string &name,
+                                            bool external) {
+  auto created = std::make_unique<ThreadBuffer>();
+  created->m_ThreadIndex = static_cast<uint32_t>(m_Buffers.size());
+  created->m_Name = name;
+  created->m_External = external;
+  created->m_Zones.resize(ZONES_PER_THREAD);
+  m_Buffers.push_back(std::move(created));
+  return *m_Buffers.back();
+}
+
+void Profiler::WriteZone(ThreadBuffer &buffer, const char *name,
+                         uint64_t start, uint64_t end, uint32_t depth,
+                         uint64_t frame) {
+  const auto count = buffer.m_WriteCount.load(std::memory_order_relaxed);
+  auto &zone = buffer.m_Zones[count % ZONES_PER_THREAD];
+  zone.m_Name = name;
+  zone.m_Start = start;
+  zone.m_End = end;
+  zone.m_Depth = depth;
+  zone.m_Frame = frame;
+  buffer.m_WriteCount.store(count + 1, std::memory_order_release);
+}
+
+uint32_t Profiler::CreateTrack(const std::string &name) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return AddBuffer(name, true).m_ThreadIndex;
+}
+
+void Profiler::AddZone(uint32_t track, const char *name, uint64_t start,
+                       uint64_t end, uint32_t depth, uint64_t frame) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (track >= m_Buffers.size() || !m_Buffers[track]->m_External) {
+    throw std::runtime_error("Error: invalid profiler track");
+  }
+  WriteZone(*m_Buffers[track], name, start, end, depth, frame);
+}
+
+const char *Profiler::Intern(const std::string &name) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Names.insert(name).first->c_str();
+}
+
+uint32_t Profiler::BeginZone() { return GetThreadBuffer().m_Depth++; }
+
+void Profiler::EndZone(const char *name, uint64_t start, uint32_t depth) {
+  const auto end = Now();
+  auto &buffer = GetThreadBuffer();
+  buffer.m_Depth = depth;
+  WriteZone(buffer, name, start, end, depth,
+            m_Frame.load(std::memory_order_relaxed));
+}
+
+void Profiler::BeginFrame() { m_FrameStart = Now(); }
+
+void Profiler::EndFrame() {
+  const auto frameEnd = Now();
+
+  ProfilerFrameSummary summary{};
+  summary.m_Frame = m_Frame.load();
+  summary.m_FrameMs = (frameEnd - m_FrameStart) / 1e6;
+
+  std::unordered_map<const char *, size_t> indices{};
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (auto &buffer : m_Buffers) {
+      if (buffer->m_External) {
+        continue;
+      }
+      const auto count = buffer->m_WriteCount.load(std::memory_order_acquire);
+      // 落后超过一圈的部分已经被覆盖
+      auto first = buffer->m_SummaryCount;
+      if (count - first > ZONES_PER_THREAD) {
+        first = count - ZONES_PER_THREAD;
+      }
+      for (auto i = first; i < count; ++i) {
+        auto &zone = buffer->m_Zones[i % ZONES_PER_THREAD];
+        auto found = indices.find(zone.m_Name);
+        if (found == indices.end()) {
+          found = indices.emplace(zone.m_Name, summary.m_ZoneMs.size()).first;
+          summary.m_ZoneMs.push_back({zone.m_Name, 0.0});
+        }
+        summary.m_ZoneMs[found->second].second +=
+            (zone.m_End - zone.m_Start) / 1e6;
+      }
+      buffer->m_SummaryCount = count;
+    }
+  }
+
+  m_LastFrame = std::move(summary);
+  m_Frame.fetch_add(1);
+}
+
+void Profiler::PrintLastFrame(std::ostream &out) const {
+  out << "frame " << m_LastFrame.m_Frame << ": " << m_LastFrame.m_FrameMs
+      << " ms";
+  for (auto &zone : m_LastFrame.m_ZoneMs) {
+    out << " | " << zone.first << " " << zone.second;
+  }
+  out << std::endl;
+}
+
+void Profiler::WriteJsonString(std::ostream &out, const std::string &value) {
+  out << '"';
+  for (const char c : value) {
+    switch (c) {
+    case '"':
+      out << "\\\"";
+      break;
+    case '\\':
+      out << "\\\\";
+      break;
+    case '\n':
+      out << "\\n";
+      break;
+    case '\r':
+      out << "\\r";
+      break;
+    case '\t':
+      out << "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        const char *digits = "0123456789abcdef";
+        out << "\\u00" << digits[(c >> 4) & 0xF] << digits[c & 0xF];
+      } else {
+        out << c;
+      }
+    }
+  }
+  out << '"';
+}
+
+void Profiler::WriteChromeTrace(const std::string &path) {
+  std::ofstream file(path);
+  if (!file) {
+    throw std::runtime_error("Error: failed to write profiler trace " + path);
+  }
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  // steady_clock的绝对值很大，直接按微秒输出会丢精度，以最早的一段为0点
+  uint64_t origin = UINT64_MAX;
+  for (auto &buffer : m_Buffers) {
+    const auto count = buffer->m_WriteCount.load(std::memory_order_acquire);
+    const auto begin = count > ZONES_PER_THREAD ? count - ZONES_PER_THREAD : 0;
+    for (auto i = begin; i < count; ++i) {
+      origin = std::min(origin, buffer->m_Zones[i % ZONES_PER_THREAD].m_Start);
+    }
+  }
+
+  // chrome trace的时间单位是微秒，保留到纳秒
+  file << std::fixed << std::setprecision(3);
+  file << "{\"traceEvents\":[\n";
+  bool first = true;
+  for (auto &buffer : m_Buffers) {
+    file << (first ? "" : ",\n")
+         << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+         << buffer->m_ThreadIndex << ",\"args\":{\"name\":";
+    WriteJsonString(file, buffer->m_Name);
+    file << "}}";
+    first = false;
+
+    const auto count = buffer->m_WriteCount.load(std::memory_order_acquire);
+    const auto begin = count > ZONES_PER_THREAD ? count - ZONES_PER_THREAD : 0;
+    for (auto i = begin; i < count; ++i) {
+      auto &zone = buffer->m_Zones[i % ZONES_PER_THREAD];
+      file << ",\n{\"name\":";
+      WriteJsonString(file, zone.m_Name ? zone.m_Name : "");
+      file << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->m_ThreadIndex
+           << ",\"ts\":" << (zone.m_Start - origin) / 1000.0
+           << ",\"dur\":" << (zone.m_End - zone.m_Start) / 1000.0
+           << ",\"args\":{\"frame\":" << zone.m_Frame << "}}";
+    }
+  }
+  file << "\n]}\n";
+}
+
+} // namespace VK
+
+#define VK_PROFILE_CONCAT_IMPL(a, b) a##b
+#define VK_PROFILE_CONCAT(a, b) VK_PROFILE_CONCAT_IMPL(a, b)
+
+#if VK_ENABLE_PROFILER
+#define VK_PROFILE_SCOPE(name)                                                 \
+  ::VK::Profiler::Scope VK_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define VK_PROFILE_BEGIN_FRAME() ::VK::Profiler::Get().BeginFrame()
+#define VK_PROFILE_END_FRAME() ::VK::Profiler::Get().EndFrame()
+#else
+#define VK_PROFILE_SCOPE(name)
+#define VK_PROFILE_BEGIN_FRAME()
+#define VK_PROFILE_END_FRAME()
+#endif
@@ -0,0 +1,231 @@
+#pragma once
+#include "VulkanWrapper/commandPool.hpp"
+#include "VulkanWrapper/device.hpp"
+#include "base.h"
+#include "camera.hpp"
+#include "model.hpp"
+#include "texture/texture.hpp"
+#include "texture/textureUploadBatch.hpp"
+
+namespace VK {
+
+// 程序生成的测试场景，同样的设置每次生成的内容完全一样
+struct SceneSettings {
+  uint32_t m_MeshCount{64};
+  // 不同形状的网格数，物体轮流使用，每个网格各占一套顶点和索引buffer
+  uint32_t m_MeshVariants{16};
+  uint32_t m_TextureCount{8};
+  // 每个球的经纬分段数
+  uint32_t m_MeshResolution{32};
+  uint32_t m_TextureSize{256};
+  uint32_t m_Seed{1};
+  // 网格上相邻两个物体的间距
+  float m_Spacing{3.0f};
+};
+
+struct SceneObject {
+  Model::Ptr m_Model{nullptr};
+  uint32_t m_Texture{0};
+  ObjectUniform m_Uniform{};
+  // 世界空间
+  BoundingSphere m_Bounds{};
+};
+
+// 物体摆在xz平面的方形网格上，网格和纹理都按下标轮流使用
+class ProceduralScene {
+private:
+  std::vector<SceneObject> m_Objects{};
+  std::vector<Model::Ptr> m_Meshes{};
+  std::vector<Texture::Ptr> m_Textures{};
+
+public:
+  // 每个物体每帧要从frameAllocator里切一块ObjectUniform，物体数不能无限大
+  static constexpr uint32_t MAX_MESH_COUNT{1 << 16};
+
+  using Ptr = std::shared_ptr<ProceduralScene>;
+  static Ptr Create(const Wrapper::Device::Ptr &device,
+                    const Wrapper::CommandPool::Ptr &commandPool,
+                    const SceneSettings &settings) {
+    return std::make_shared<ProceduralScene>(device, commandPool, settings);
+  }
+
+  ProceduralScene(const Wrapper::Device::Ptr &device,
+                  const Wrapper::CommandPool::Ptr &commandPool,
+                  const SceneSettings &settings);
+  ~ProceduralScene() = default;
+
+  [[nodiscard]] auto &GetObjects() const { return m_Objects; }
+  [[nodiscard]] auto &GetMeshes() const { return m_Meshes; }
+  [[nodiscard]] auto &GetTextures() const { return m_Textures; }
+  // 包住所有物体的半径，相机路径按它来定，不用先生成场景
+  static float GetRadius(const SceneSettings &settings) {
+    const auto side =
+        std::ceil(std::sqrt(static_cast<float>(settings.m_MeshCount)));
+    return 0.5f * side * settings.m_Spacing * std::sqrt(2.0f) + 1.2f;
+  }
+
+  // 纯cpu，棋盘格加上按seed变化的颜色
+  static TextureFileData GenerateTexture(uint32_t size, uint32_t seed);
+
+  // 不依赖标准库分布的实现，不同平台结果一致，返回[0, 1)
+  static float Random(uint32_t seed, uint32_t index) {
+    uint32_t hash = seed * 0x9e3779b9u + index * 0x85ebca6bu;
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    hash *= 0x846ca68bu;
+    hash ^= hash >> 16;
+    return static_cast<float>(hash >> 8) / 16777216.0f;
+  }
+};
+
+ProceduralScene::ProceduralScene(const Wrapper::Device::Ptr &device,
+                                 const Wrapper::CommandPool::Ptr &commandPool,
+                                 const SceneSettings &settings) {
+  if (settings.m_MeshCount == 0 || settings.m_TextureCount == 0) {
+    throw std::runtime_error(
+        "Error: procedural scene needs at least one mesh and one texture");
+  }
+  if (settings.m_MeshCount > MAX_MESH_COUNT) {
+    throw std::runtime_error("Error: procedural scene supports at most " +
+                             std::to_string(MAX_MESH_COUNT) + " meshes");
+  }
+
+  // 所有纹理一次提交
+  auto batch = TextureUploadBatch::create(device);
+  std::vector<Wrapper::Image::Ptr> images{};
+  for (uint32_t i = 0; i < settings.m_TextureCount; ++i) {
+    images.push_back(batch->Add(
+        GenerateTexture(settings.m_TextureSize, settings.m_Seed + i)));
+  }
+  auto commandBuffer = Wrapper::CommandBuffer::Create(device, commandPool);
+  commandBuffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  batch->Record(commandBuffer);
+  commandBuffer->End();
+  commandBuffer->SubmitSync(device->GetGraphicQueue());
+  for (auto &image : images) {
+    m_Textures.push_back(Texture::create(device, image));
+  }
+
+  // 几千个物体各建一套buffer会超过maxMemoryAllocationCount，只生成少量网格共享
+  const auto variants =
+      std::max(1u, std::min(settings.m_MeshVariants, settings.m_MeshCount));
+  for (uint32_t i = 0; i < variants; ++i) {
+    auto mesh = Model::Create(device);
+    mesh->generateMesh(settings.m_MeshResolution, settings.m_Seed * 7919u + i,
+                       device);
+    m_Meshes.push_back(mesh);
+  }
+
+  const auto side = static_cast<uint32_t>(
+      std::ceil(std::sqrt(static_cast<float>(settings.m_MeshCount))));
+  const float half = 0.5f * (side - 1) * settings.m_Spacing;
+  for (uint32_t i = 0; i < settings.m_MeshCount; ++i) {
+    SceneObject object{};
+    object.m_Model = m_Meshes[i % variants];
+    object.m_Texture = i % settings.m_TextureCount;
+
+    const glm::vec3 position{(i % side) * settings.m_Spacing - half,
+                             Random(settings.m_Seed, i) - 0.5f,
+                             (i / side) * settings.m_Spacing - half};
+    const float angle = 360.0f * Random(settings.m_Seed + 1, i);
+    object.m_Uniform.mModelMatrix =
+        glm::rotate(glm::translate(glm::mat4(1.0f), position),
+                    glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
+    object.m_Bounds =
+        object.m_Model->getBounds().Transform(object.m_Uniform.mModelMatrix);
+    m_Objects.push_back(object);
+  }
+}
+
+TextureFileData ProceduralScene::GenerateTexture(uint32_t size,
+                                                 uint32_t seed) {
+  TextureFileData data{};
+  data.mFormat = VK_FORMAT_R8G8B8A8_SRGB;
+  data.mWidth = size;
+  data.mHeight = size;
+  data.mData.resize(static_cast<size_t>(size) * size * 4);
+  data.mLevels.push_back({size, size, 0, data.mData.size()});
+
+  const uint8_t color[3] = {
+      static_cast<uint8_t>(64 + 191 * Random(seed, 0)),
+      static_cast<uint8_t>(64 + 191 * Random(seed, 1)),
+      static_cast<uint8_t>(64 + 191 * Random(seed, 2))};
+  const uint32_t cell = std::max(1u, size / 8);
+  for (uint32_t y = 0; y < size; ++y) {
+    for (uint32_t x = 0; x < size; ++x) {
+      const bool dark = ((x / cell) + (y / cell)) % 2 == 0;
+      auto *pixel = &data.mData[(static_cast<size_t>(y) * size + x) * 4];
+      for (int c = 0; c < 3; ++c) {
+        pixel[c] = dark ? color[c] / 3 : color[c];
+      }
+      pixel[3] = 255;
+    }
+  }
+  return data;
+}
+
+// 脚本化的相机路径，按帧号取位置，和帧率无关，每次回放都一样
+class CameraPath {
+private:
+  struct Key {
+    glm::vec3 m_Position{};
+    glm::vec3 m_Target{};
+  };
+  std::vector<Key> m_Keys{};
+  // 走完整条路径用的帧数，之后从头循环
+  uint32_t m_FrameCount{1};
+
+public:
+  CameraPath() = default;
+
+  // 绕原点一圈，高度上下起伏一次
+  static CameraPath Orbit(float radius, float height, uint32_t frameCount,
+                          uint32_t keyCount = 64);
+
+  void AddKey(const glm::vec3 &position, const glm::vec3 &target) {
+    m_Keys.push_back({position, target});
+  }
+  void SetFrameCount(uint32_t frameCount) {
+    m_FrameCount = std::max(1u, frameCount);
+  }
+  [[nodiscard]] bool IsEmpty() const { return m_Keys.empty(); }
+
+  // 相邻两个关键点之间线性插值
+  void Apply(Camera &camera, uint64_t frame) const;
+};
+
+CameraPath CameraPath::Orbit(float radius, float height, uint32_t frameCount,
+                             uint32_t keyCount) {
+  CameraPath path{};
+  keyCount = std::max(2u, keyCount);
+  for (uint32_t i = 0; i < keyCount; ++i) {
+    const float t = static_cast<float>(i) / keyCount;
+    const float angle = 2.0f * glm::pi<float>() * t;
+    path.AddKey({radius * std::cos(angle),
+                 height * (1.0f + 0.5f * std::sin(angle)),
+                 radius * std::sin(angle)},
+                glm::vec3(0.0f));
+  }
+  path.SetFrameCount(frameCount);
+  return path;
+}
+
+void CameraPath::Apply(Camera &camera, uint64_t frame) const {
+  if (m_Keys.empty()) {
+    return;
+  }
+  // 最后一个关键点接回第一个
+  const float t = static_cast<float>(frame % m_FrameCount) / m_FrameCount *
+                  m_Keys.size();
+  const auto index = static_cast<size_t>(t);
+  const float blend = t - index;
+  auto &from = m_Keys[index % m_Keys.size()];
+  auto &to = m_Keys[(index + 1) % m_Keys.size()];
+
+  const auto position = glm::mix(from.m_Position, to.m_Position, blend);
+  const auto target = glm::mix(from.m_Target, to.m_Target, blend);
+  camera.lookAt(position, target - position, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+} // namespace VK
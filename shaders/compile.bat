@@ -1,5 +1,6 @@
 
 D:\SomeSoft\vk\Bin\glslangValidator.exe -V vertice.vert -o vs.spv
 D:\SomeSoft\vk\Bin\glslangValidator.exe -V frag.frag -o fs.spv
+D:\SomeSoft\vk\Bin\glslangValidator.exe -V frag_bindless.frag -o fs_bindless.spv
 
 pause
\ No newline at end of file
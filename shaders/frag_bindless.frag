@@ -0,0 +1,24 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects:enable
+#extension GL_EXT_nonuniform_qualifier:enable
+
+layout(location = 0) in vec3 inColor;
+layout(location = 1) in vec2 inUV;
+
+layout(location = 0) out vec4 outColor;
+
+// set 1 为bindless纹理表，下标由push constant给出
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
+
+layout(push_constant) uniform MaterialConstants{
+    uint textureIndex;
+    uint samplerIndex;
+}material;
+
+void main(){
+
+    outColor = texture(sampler2D(textures[nonuniformEXT(material.textureIndex)],
+                                 samplers[nonuniformEXT(material.samplerIndex)]), inUV);
+}
@@ -0,0 +1,234 @@
+#pragma once
+#include "../base.h"
+#include "../VulkanWrapper/descriptorPool.hpp"
+#include "../VulkanWrapper/device.hpp"
+#include "../VulkanWrapper/sampler.hpp"
+#include "texture.hpp"
+
+namespace VK {
+
+	// bindless纹理表
+	// 一个set里放一个很大的sampled image数组(binding 0)和一个sampler数组(binding 1)
+	// 纹理注册后得到一个下标，shader通过push constant里的下标去取，
+	// 这样切换材质不需要再重新绑定descriptorSet
+	// 已经被提交的帧用到的下标不能再改写(UPDATE_AFTER_BIND也不允许)，纹理换image时写到新下标，
+	// 旧下标等framesInFlight帧之后才回到空闲列表
+	class BindlessTextures {
+	private:
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		Wrapper::DescriptorPool::Ptr mPool{ nullptr };
+		VkDescriptorSetLayout mLayout{ VK_NULL_HANDLE };
+		VkDescriptorSet mSet{ VK_NULL_HANDLE };
+
+		uint32_t mMaxTextures{ 0 };
+		uint32_t mMaxSamplers{ 0 };
+		uint32_t mFramesInFlight{ 0 };
+
+		// 注销或被替换的下标先退役，退役之前提交的帧都结束后进入空闲列表等待复用
+		struct RetiredIndex {
+			uint32_t mIndex{ 0 };
+			uint64_t mRetireFrame{ 0 };
+		};
+		uint32_t mNextTextureIndex{ 0 };
+		std::vector<uint32_t> mFreeTextureIndices{};
+		std::vector<RetiredIndex> mRetiredIndices{};
+		// 每个下标对应的纹理，纹理换image后用来找到要重写的下标
+		std::vector<Texture::Ptr> mTextures{};
+		std::vector<VkSampler> mSamplers{};
+
+		Wrapper::Sampler::Ptr mDefaultSampler{ nullptr };
+
+	public:
+		using Ptr = std::shared_ptr<BindlessTextures>;
+		static Ptr create(const Wrapper::Device::Ptr& device, uint32_t framesInFlight, uint32_t maxTextures = 4096, uint32_t maxSamplers = 32) {
+			return std::make_shared<BindlessTextures>(device, framesInFlight, maxTextures, maxSamplers);
+		}
+
+		BindlessTextures(const Wrapper::Device::Ptr& device, uint32_t framesInFlight, uint32_t maxTextures, uint32_t maxSamplers);
+
+		~BindlessTextures();
+
+		// 返回纹理在数组里的下标，写入的一定是没有被在途帧引用的下标
+		uint32_t Register(const Texture::Ptr& texture);
+
+		// 纹理的image换了(比如异步加载完成)之后调用：写到新下标并返回，调用方换成新下标
+		// 原下标在frame这一帧退役
+		uint32_t Replace(uint32_t index, const Texture::Ptr& texture, uint64_t frame);
+
+		void Unregister(uint32_t index, uint64_t frame);
+
+		// 每帧等过fence之后调用，frame之前framesInFlight帧退役的下标可以复用了
+		void ReleaseRetired(uint64_t frame);
+
+		// 0号sampler是默认的线性重复采样器
+		uint32_t RegisterSampler(VkSampler sampler);
+
+		[[nodiscard]] auto GetLayout() const { return mLayout; }
+		[[nodiscard]] auto GetDescriptorSet() const { return mSet; }
+
+	private:
+		void Write(uint32_t index, const Texture::Ptr& texture);
+	};
+
+	BindlessTextures::BindlessTextures(const Wrapper::Device::Ptr& device, uint32_t framesInFlight, uint32_t maxTextures, uint32_t maxSamplers) {
+		mDevice = device;
+		mFramesInFlight = framesInFlight;
+
+		if (!mDevice->IsBindlessSupported()) {
+			throw std::runtime_error("Error: device does not support descriptor indexing");
+		}
+
+		const auto& indexingProps = mDevice->GetDescriptorIndexingProperties();
+		mMaxTextures = std::min(maxTextures, indexingProps.maxDescriptorSetUpdateAfterBindSampledImages);
+		mMaxSamplers = std::min(maxSamplers, indexingProps.maxDescriptorSetUpdateAfterBindSamplers);
+
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		bindings[0].descriptorCount = mMaxTextures;
+		bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+		bindings[1].descriptorCount = mMaxSamplers;
+		bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		// 没用到的槽位可以是空的，且set绑定之后仍然可以往里写新纹理
+		std::array<VkDescriptorBindingFlags, 2> bindingFlags{};
+		bindingFlags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+		bindingFlags[1] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(mDevice->GetDevice(), &layoutInfo, nullptr, &mLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Error: failed to create bindless descriptor set layout");
+		}
+
+		std::vector<VkDescriptorPoolSize> poolSizes(2);
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		poolSizes[0].descriptorCount = mMaxTextures;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+		poolSizes[1].descriptorCount = mMaxSamplers;
+
+		mPool = Wrapper::DescriptorPool::Create(mDevice);
+		mPool->Build(poolSizes, 1, VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT);
+
+		if (mPool->Allocate(mLayout, mSet) != VK_SUCCESS) {
+			throw std::runtime_error("Error: failed to allocate bindless descriptor set");
+		}
+
+		mDefaultSampler = Wrapper::Sampler::create(mDevice);
+		RegisterSampler(mDefaultSampler->getSampler());
+	}
+
+	BindlessTextures::~BindlessTextures() {
+		mPool.reset();
+		if (mLayout != VK_NULL_HANDLE) {
+			vkDestroyDescriptorSetLayout(mDevice->GetDevice(), mLayout, nullptr);
+		}
+	}
+
+	uint32_t BindlessTextures::Register(const Texture::Ptr& texture) {
+		uint32_t index = 0;
+		if (!mFreeTextureIndices.empty()) {
+			index = mFreeTextureIndices.back();
+			mFreeTextureIndices.pop_back();
+		}
+		else {
+			if (mNextTextureIndex >= mMaxTextures) {
+				throw std::runtime_error("Error: bindless texture table is full");
+			}
+			index = mNextTextureIndex++;
+		}
+
+		if (index >= mTextures.size()) {
+			mTextures.resize(index + 1);
+		}
+		mTextures[index] = texture;
+
+		Write(index, texture);
+		return index;
+	}
+
+	void BindlessTextures::Write(uint32_t index, const Texture::Ptr& texture) {
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageView = texture->GetImageInfo().imageView;
+		imageInfo.imageLayout = texture->GetImageInfo().imageLayout;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = mSet;
+		write.dstBinding = 0;
+		write.dstArrayElement = index;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		write.descriptorCount = 1;
+		write.pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(mDevice->GetDevice(), 1, &write, 0, nullptr);
+	}
+
+	uint32_t BindlessTextures::Replace(uint32_t index, const Texture::Ptr& texture, uint64_t frame) {
+		// 先拿新下标再退役旧的，保证不会原地改写
+		const auto newIndex = Register(texture);
+		Unregister(index, frame);
+		return newIndex;
+	}
+
+	void BindlessTextures::Unregister(uint32_t index, uint64_t frame) {
+		mTextures[index].reset();
+		mRetiredIndices.push_back({ index, frame });
+	}
+
+	void BindlessTextures::ReleaseRetired(uint64_t frame) {
+		for (auto it = mRetiredIndices.begin(); it != mRetiredIndices.end();) {
+			if (frame >= it->mRetireFrame + mFramesInFlight) {
+				mFreeTextureIndices.push_back(it->mIndex);
+				it = mRetiredIndices.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	uint32_t BindlessTextures::RegisterSampler(VkSampler sampler) {
+		for (uint32_t i = 0; i < mSamplers.size(); ++i) {
+			if (mSamplers[i] == sampler) {
+				return i;
+			}
+		}
+
+		if (mSamplers.size() >= mMaxSamplers) {
+			throw std::runtime_error("Error: bindless sampler table is full");
+		}
+
+		uint32_t index = static_cast<uint32_t>(mSamplers.size());
+		mSamplers.push_back(sampler);
+
+		VkDescriptorImageInfo samplerInfo{};
+		samplerInfo.sampler = sampler;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = mSet;
+		write.dstBinding = 1;
+		write.dstArrayElement = index;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+		write.descriptorCount = 1;
+		write.pImageInfo = &samplerInfo;
+
+		vkUpdateDescriptorSets(mDevice->GetDevice(), 1, &write, 0, nullptr);
+		return index;
+	}
+
+}
@@ -0,0 +1,195 @@
+#pragma once
+#include "../base.h"
+#include <algorithm>
+
+namespace VK {
+
+	// BC1/BC3/BC5的cpu编码器，给离线转换工具用，运行时不会调用
+	// 端点取块内包围盒再向内收缩1/16，质量不如专门的编码器但速度快、没有依赖
+	// BC7的模式搜索太复杂，这里不做编码，需要BC7时用外部工具生成ktx2/dds
+	class BlockCompressor {
+	public:
+		// 输入rgba8，输出大小为 ceil(w/4) * ceil(h/4) * 块大小
+		static std::vector<uint8_t> Compress(VkFormat format, const uint8_t* pixels, uint32_t width, uint32_t height);
+
+		static void EncodeBC1Block(const uint8_t block[64], uint8_t* dst);
+		static void EncodeBC3Block(const uint8_t block[64], uint8_t* dst);
+		static void EncodeBC5Block(const uint8_t block[64], uint8_t* dst);
+
+	private:
+		// 从图像取一个4x4块，越界的像素重复边缘
+		static void FetchBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t block[64]);
+		// 单通道块(BC4格式)，channel为0-3
+		static void EncodeAlphaBlock(const uint8_t block[64], uint32_t channel, uint8_t* dst);
+		static void EncodeColorBlock(const uint8_t block[64], uint8_t* dst);
+
+		static uint16_t PackRGB565(const uint8_t color[3]);
+		static void UnpackRGB565(uint16_t packed, int color[3]);
+	};
+
+	std::vector<uint8_t> BlockCompressor::Compress(VkFormat format, const uint8_t* pixels, uint32_t width, uint32_t height) {
+		size_t blockBytes = 0;
+		void (*encode)(const uint8_t*, uint8_t*) = nullptr;
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			blockBytes = 8;
+			encode = EncodeBC1Block;
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			blockBytes = 16;
+			encode = EncodeBC3Block;
+			break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			blockBytes = 16;
+			encode = EncodeBC5Block;
+			break;
+		default:
+			throw std::runtime_error("Error: block compressor does not support this format");
+		}
+
+		const uint32_t blocksX = (width + 3) / 4;
+		const uint32_t blocksY = (height + 3) / 4;
+		std::vector<uint8_t> out(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+
+		uint8_t block[64];
+		uint8_t* dst = out.data();
+		for (uint32_t by = 0; by < blocksY; ++by) {
+			for (uint32_t bx = 0; bx < blocksX; ++bx) {
+				FetchBlock(pixels, width, height, bx, by, block);
+				encode(block, dst);
+				dst += blockBytes;
+			}
+		}
+		return out;
+	}
+
+	void BlockCompressor::FetchBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t block[64]) {
+		for (uint32_t y = 0; y < 4; ++y) {
+			uint32_t srcY = std::min(blockY * 4 + y, height - 1);
+			for (uint32_t x = 0; x < 4; ++x) {
+				uint32_t srcX = std::min(blockX * 4 + x, width - 1);
+				memcpy(block + (y * 4 + x) * 4, pixels + (static_cast<size_t>(srcY) * width + srcX) * 4, 4);
+			}
+		}
+	}
+
+	uint16_t BlockCompressor::PackRGB565(const uint8_t color[3]) {
+		return static_cast<uint16_t>(((color[0] * 31 + 127) / 255) << 11 |
+			((color[1] * 63 + 127) / 255) << 5 |
+			((color[2] * 31 + 127) / 255));
+	}
+
+	void BlockCompressor::UnpackRGB565(uint16_t packed, int color[3]) {
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// 4色模式：color0 > color1，索引 0=c0 1=c1 2=2/3c0+1/3c1 3=1/3c0+2/3c1
+	void BlockCompressor::EncodeColorBlock(const uint8_t block[64], uint8_t* dst) {
+		uint8_t minColor[3] = { 255, 255, 255 };
+		uint8_t maxColor[3] = { 0, 0, 0 };
+		for (uint32_t i = 0; i < 16; ++i) {
+			for (uint32_t c = 0; c < 3; ++c) {
+				minColor[c] = std::min(minColor[c], block[i * 4 + c]);
+				maxColor[c] = std::max(maxColor[c], block[i * 4 + c]);
+			}
+		}
+
+		// 包围盒向内收缩，端点落在极值上时误差会集中在中间色
+		for (uint32_t c = 0; c < 3; ++c) {
+			int inset = (maxColor[c] - minColor[c]) >> 4;
+			minColor[c] = static_cast<uint8_t>(std::min(255, minColor[c] + inset));
+			maxColor[c] = static_cast<uint8_t>(std::max(0, maxColor[c] - inset));
+		}
+
+		uint16_t color0 = PackRGB565(maxColor);
+		uint16_t color1 = PackRGB565(minColor);
+		uint32_t indices = 0;
+
+		if (color0 != color1) {
+			if (color0 < color1) {
+				std::swap(color0, color1);
+			}
+
+			int palette[4][3];
+			UnpackRGB565(color0, palette[0]);
+			UnpackRGB565(color1, palette[1]);
+			for (uint32_t c = 0; c < 3; ++c) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+			}
+
+			for (uint32_t i = 0; i < 16; ++i) {
+				uint32_t best = 0;
+				int bestDistance = INT32_MAX;
+				for (uint32_t p = 0; p < 4; ++p) {
+					int dr = block[i * 4 + 0] - palette[p][0];
+					int dg = block[i * 4 + 1] - palette[p][1];
+					int db = block[i * 4 + 2] - palette[p][2];
+					int distance = dr * dr + dg * dg + db * db;
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= best << (i * 2);
+			}
+		}
+
+		dst[0] = static_cast<uint8_t>(color0 & 0xFF);
+		dst[1] = static_cast<uint8_t>(color0 >> 8);
+		dst[2] = static_cast<uint8_t>(color1 & 0xFF);
+		dst[3] = static_cast<uint8_t>(color1 >> 8);
+		memcpy(dst + 4, &indices, 4);
+	}
+
+	// 8值模式：a0 > a1，端点之间插6个值
+	void BlockCompressor::EncodeAlphaBlock(const uint8_t block[64], uint32_t channel, uint8_t* dst) {
+		uint8_t minValue = 255;
+		uint8_t maxValue = 0;
+		for (uint32_t i = 0; i < 16; ++i) {
+			minValue = std::min(minValue, block[i * 4 + channel]);
+			maxValue = std::max(maxValue, block[i * 4 + channel]);
+		}
+
+		dst[0] = maxValue;
+		dst[1] = minValue;
+
+		uint64_t indices = 0;
+		if (maxValue != minValue) {
+			// 按在[min,max]上的位置取最近的插值点，再换成BC4的索引顺序
+			static const uint8_t remap[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+			const int range = maxValue - minValue;
+			for (uint32_t i = 0; i < 16; ++i) {
+				int step = ((block[i * 4 + channel] - minValue) * 7 + range / 2) / range;
+				indices |= static_cast<uint64_t>(remap[step]) << (i * 3);
+			}
+		}
+
+		for (uint32_t i = 0; i < 6; ++i) {
+			dst[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+		}
+	}
+
+	void BlockCompressor::EncodeBC1Block(const uint8_t block[64], uint8_t* dst) {
+		EncodeColorBlock(block, dst);
+	}
+
+	void BlockCompressor::EncodeBC3Block(const uint8_t block[64], uint8_t* dst) {
+		EncodeAlphaBlock(block, 3, dst);
+		EncodeColorBlock(block, dst + 8);
+	}
+
+	// 法线贴图用，只保留rg两个通道
+	void BlockCompressor::EncodeBC5Block(const uint8_t block[64], uint8_t* dst) {
+		EncodeAlphaBlock(block, 0, dst);
+		EncodeAlphaBlock(block, 1, dst + 8);
+	}
+
+}
@@ -0,0 +1,197 @@
+#pragma once
+#include "../base.h"
+#include <array>
+#include <fstream>
+
+namespace VK {
+
+	// 回读帧的写出，给无窗口模式和录制用
+	// png用不压缩的deflate块(只有store)，exr用不压缩的scanline，都不依赖外部库
+	// 文件比正常编码器大，换来的是写出几乎没有cpu开销
+	class ImageWriter {
+	public:
+		// rgba8，按行紧密排列
+		static void WritePNG(const std::string& path, uint32_t width, uint32_t height, const uint8_t* pixels);
+
+		// rgba half float，按行紧密排列
+		static void WriteEXR(const std::string& path, uint32_t width, uint32_t height, const uint16_t* pixels);
+
+	private:
+		static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+		static uint32_t Adler32(const uint8_t* data, size_t size);
+		static void AppendChunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data);
+		static void WriteFile(const std::string& path, const std::vector<uint8_t>& data);
+
+		template <typename T>
+		static void AppendLE(std::vector<uint8_t>& out, T value) {
+			for (size_t i = 0; i < sizeof(T); ++i) {
+				out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8)));
+			}
+		}
+
+		static void AppendBE32(std::vector<uint8_t>& out, uint32_t value) {
+			for (int i = 3; i >= 0; --i) {
+				out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+			}
+		}
+
+		static void AppendString(std::vector<uint8_t>& out, const char* value) {
+			out.insert(out.end(), value, value + strlen(value) + 1);
+		}
+	};
+
+	uint32_t ImageWriter::Crc32(const uint8_t* data, size_t size, uint32_t crc) {
+		// 局部静态变量的初始化是线程安全的，多个线程同时截图也不会重复构建
+		static const std::array<uint32_t, 256> table = [] {
+			std::array<uint32_t, 256> result{};
+			for (uint32_t i = 0; i < 256; ++i) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; ++k) {
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				result[i] = c;
+			}
+			return result;
+		}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	uint32_t ImageWriter::Adler32(const uint8_t* data, size_t size) {
+		uint32_t a = 1;
+		uint32_t b = 0;
+		for (size_t i = 0; i < size; ++i) {
+			a = (a + data[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	void ImageWriter::AppendChunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data) {
+		AppendBE32(out, static_cast<uint32_t>(data.size()));
+		const size_t crcStart = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data.begin(), data.end());
+		AppendBE32(out, Crc32(out.data() + crcStart, out.size() - crcStart));
+	}
+
+	void ImageWriter::WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+		std::ofstream file(path, std::ios::binary);
+		if (!file) {
+			throw std::runtime_error("Error: failed to write image file " + path);
+		}
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	}
+
+	void ImageWriter::WritePNG(const std::string& path, uint32_t width, uint32_t height, const uint8_t* pixels) {
+		// 每行前面加一个filter字节(0 = None)
+		const size_t rowBytes = static_cast<size_t>(width) * 4;
+		std::vector<uint8_t> raw{};
+		raw.reserve((rowBytes + 1) * height);
+		for (uint32_t y = 0; y < height; ++y) {
+			raw.push_back(0);
+			raw.insert(raw.end(), pixels + y * rowBytes, pixels + (y + 1) * rowBytes);
+		}
+
+		// zlib头 + store块(每块最多65535字节) + adler32
+		std::vector<uint8_t> zlib{ 0x78, 0x01 };
+		size_t offset = 0;
+		do {
+			const size_t blockSize = std::min<size_t>(65535, raw.size() - offset);
+			const bool last = offset + blockSize == raw.size();
+			zlib.push_back(last ? 1 : 0);
+			AppendLE<uint16_t>(zlib, static_cast<uint16_t>(blockSize));
+			AppendLE<uint16_t>(zlib, static_cast<uint16_t>(~blockSize));
+			zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+			offset += blockSize;
+		} while (offset < raw.size());
+		AppendBE32(zlib, Adler32(raw.data(), raw.size()));
+
+		std::vector<uint8_t> header{};
+		AppendBE32(header, width);
+		AppendBE32(header, height);
+		// 8bit、rgba、默认压缩/filter、不隔行
+		header.insert(header.end(), { 8, 6, 0, 0, 0 });
+
+		std::vector<uint8_t> out{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		AppendChunk(out, "IHDR", header);
+		AppendChunk(out, "IDAT", zlib);
+		AppendChunk(out, "IEND", {});
+		WriteFile(path, out);
+	}
+
+	void ImageWriter::WriteEXR(const std::string& path, uint32_t width, uint32_t height, const uint16_t* pixels) {
+		std::vector<uint8_t> out{};
+		// magic和版本2(单part scanline)
+		AppendLE<uint32_t>(out, 20000630);
+		AppendLE<uint32_t>(out, 2);
+
+		auto appendAttribute = [&](const char* name, const char* type, const std::vector<uint8_t>& value) {
+			AppendString(out, name);
+			AppendString(out, type);
+			AppendLE<uint32_t>(out, static_cast<uint32_t>(value.size()));
+			out.insert(out.end(), value.begin(), value.end());
+		};
+
+		// 通道必须按名字排序，像素数据也按这个顺序存
+		static const char* channelNames[4] = { "A", "B", "G", "R" };
+		static const uint32_t channelSource[4] = { 3, 2, 1, 0 };
+		std::vector<uint8_t> channels{};
+		for (auto name : channelNames) {
+			AppendString(channels, name);
+			AppendLE<uint32_t>(channels, 1); // HALF
+			AppendLE<uint32_t>(channels, 0); // pLinear + 3个保留字节
+			AppendLE<uint32_t>(channels, 1);
+			AppendLE<uint32_t>(channels, 1);
+		}
+		channels.push_back(0);
+		appendAttribute("channels", "chlist", channels);
+
+		appendAttribute("compression", "compression", { 0 });
+
+		std::vector<uint8_t> window{};
+		AppendLE<int32_t>(window, 0);
+		AppendLE<int32_t>(window, 0);
+		AppendLE<int32_t>(window, static_cast<int32_t>(width) - 1);
+		AppendLE<int32_t>(window, static_cast<int32_t>(height) - 1);
+		appendAttribute("dataWindow", "box2i", window);
+		appendAttribute("displayWindow", "box2i", window);
+
+		appendAttribute("lineOrder", "lineOrder", { 0 });
+
+		std::vector<uint8_t> one{};
+		float value = 1.0f;
+		uint32_t bits = 0;
+		memcpy(&bits, &value, 4);
+		AppendLE<uint32_t>(one, bits);
+		appendAttribute("pixelAspectRatio", "float", one);
+		appendAttribute("screenWindowCenter", "v2f", std::vector<uint8_t>(8, 0));
+		appendAttribute("screenWindowWidth", "float", one);
+		out.push_back(0);
+
+		// 每行一个块，先写偏移表
+		const size_t lineBytes = static_cast<size_t>(width) * 4 * sizeof(uint16_t);
+		const size_t tableOffset = out.size();
+		const size_t dataStart = tableOffset + static_cast<size_t>(height) * 8;
+		for (uint32_t y = 0; y < height; ++y) {
+			AppendLE<uint64_t>(out, dataStart + y * (8 + lineBytes));
+		}
+
+		for (uint32_t y = 0; y < height; ++y) {
+			AppendLE<int32_t>(out, static_cast<int32_t>(y));
+			AppendLE<uint32_t>(out, static_cast<uint32_t>(lineBytes));
+			const uint16_t* row = pixels + static_cast<size_t>(y) * width * 4;
+			for (auto source : channelSource) {
+				for (uint32_t x = 0; x < width; ++x) {
+					AppendLE<uint16_t>(out, row[x * 4 + source]);
+				}
+			}
+		}
+		WriteFile(path, out);
+	}
+
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include "../base.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VK_MIPMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace VK {
+
+	struct MipLevel {
+		uint32_t mWidth{ 0 };
+		uint32_t mHeight{ 0 };
+		std::vector<uint8_t> mPixels{};
+	};
+
+	// cpu端的mip生成，用于格式不支持线性blit的情况
+	// 2x2 box滤波，奇数尺寸时边缘像素重复使用
+	// srgb数据先转到线性空间再平均，否则缩小后整体会偏暗
+	class MipmapGenerator {
+	public:
+		// 输入第0级rgba8数据，返回第1级到最后一级
+		static std::vector<MipLevel> Generate(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb);
+
+		// 缩小一级，dst大小为 max(1,w/2) * max(1,h/2) * 4
+		static void Downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, bool srgb);
+
+	private:
+		static void DownsampleUnorm(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst);
+		static void DownsampleSrgb(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst);
+
+		static const float* SrgbToLinearTable();
+		static const uint8_t* LinearToSrgbTable();
+		static constexpr uint32_t LINEAR_TABLE_SIZE{ 4096 };
+	};
+
+	std::vector<MipLevel> MipmapGenerator::Generate(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb) {
+		std::vector<MipLevel> levels{};
+
+		const uint8_t* src = pixels;
+		uint32_t srcWidth = width;
+		uint32_t srcHeight = height;
+		while (srcWidth > 1 || srcHeight > 1) {
+			MipLevel level{};
+			level.mWidth = std::max(1u, srcWidth / 2);
+			level.mHeight = std::max(1u, srcHeight / 2);
+			level.mPixels.resize(static_cast<size_t>(level.mWidth) * level.mHeight * 4);
+
+			Downsample(src, srcWidth, srcHeight, level.mPixels.data(), srgb);
+			levels.push_back(std::move(level));
+
+			src = levels.back().mPixels.data();
+			srcWidth = levels.back().mWidth;
+			srcHeight = levels.back().mHeight;
+		}
+
+		return levels;
+	}
+
+	void MipmapGenerator::Downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, bool srgb) {
+		if (srgb) {
+			DownsampleSrgb(src, srcWidth, srcHeight, dst);
+		}
+		else {
+			DownsampleUnorm(src, srcWidth, srcHeight, dst);
+		}
+	}
+
+	void MipmapGenerator::DownsampleUnorm(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst) {
+		const uint32_t dstWidth = std::max(1u, srcWidth / 2);
+		const uint32_t dstHeight = std::max(1u, srcHeight / 2);
+		const size_t srcPitch = static_cast<size_t>(srcWidth) * 4;
+
+		for (uint32_t y = 0; y < dstHeight; ++y) {
+			const uint8_t* row0 = src + std::min(2 * y, srcHeight - 1) * srcPitch;
+			const uint8_t* row1 = src + std::min(2 * y + 1, srcHeight - 1) * srcPitch;
+			uint8_t* dstRow = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+			uint32_t x = 0;
+#ifdef VK_MIPMAP_SSE2
+			// 每次读两行各4个像素(16字节)，输出2个像素
+			if (srcWidth % 2 == 0) {
+				const __m128i zero = _mm_setzero_si128();
+				const __m128i rounding = _mm_set1_epi16(2);
+				for (; x + 2 <= dstWidth; x += 2) {
+					__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+					__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+
+					// 扩展到16位后上下两行相加
+					__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+					__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+					// 相邻两个像素相加，结果在低64位
+					lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+					hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+					__m128i sum = _mm_unpacklo_epi64(lo, hi);
+					sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(dstRow + x * 4), _mm_packus_epi16(sum, zero));
+				}
+			}
+#endif
+			for (; x < dstWidth; ++x) {
+				const uint32_t x0 = std::min(2 * x, srcWidth - 1) * 4;
+				const uint32_t x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+				for (uint32_t c = 0; c < 4; ++c) {
+					uint32_t sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+					dstRow[x * 4 + c] = static_cast<uint8_t>((sum + 2) >> 2);
+				}
+			}
+		}
+	}
+
+	void MipmapGenerator::DownsampleSrgb(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst) {
+		const float* toLinear = SrgbToLinearTable();
+		const uint8_t* toSrgb = LinearToSrgbTable();
+
+		const uint32_t dstWidth = std::max(1u, srcWidth / 2);
+		const uint32_t dstHeight = std::max(1u, srcHeight / 2);
+		const size_t srcPitch = static_cast<size_t>(srcWidth) * 4;
+
+		for (uint32_t y = 0; y < dstHeight; ++y) {
+			const uint8_t* row0 = src + std::min(2 * y, srcHeight - 1) * srcPitch;
+			const uint8_t* row1 = src + std::min(2 * y + 1, srcHeight - 1) * srcPitch;
+			uint8_t* dstRow = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+			for (uint32_t x = 0; x < dstWidth; ++x) {
+				const uint32_t x0 = std::min(2 * x, srcWidth - 1) * 4;
+				const uint32_t x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+				for (uint32_t c = 0; c < 3; ++c) {
+					float sum = toLinear[row0[x0 + c]] + toLinear[row0[x1 + c]] +
+						toLinear[row1[x0 + c]] + toLinear[row1[x1 + c]];
+					uint32_t index = static_cast<uint32_t>(sum * 0.25f * (LINEAR_TABLE_SIZE - 1) + 0.5f);
+					dstRow[x * 4 + c] = toSrgb[std::min(index, LINEAR_TABLE_SIZE - 1)];
+				}
+				// alpha本来就是线性的
+				uint32_t alpha = row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3];
+				dstRow[x * 4 + 3] = static_cast<uint8_t>((alpha + 2) >> 2);
+			}
+		}
+	}
+
+	const float* MipmapGenerator::SrgbToLinearTable() {
+		static const auto table = [] {
+			std::array<float, 256> values{};
+			for (uint32_t i = 0; i < 256; ++i) {
+				float c = i / 255.0f;
+				values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return values;
+		}();
+		return table.data();
+	}
+
+	const uint8_t* MipmapGenerator::LinearToSrgbTable() {
+		static const auto table = [] {
+			std::array<uint8_t, LINEAR_TABLE_SIZE> values{};
+			for (uint32_t i = 0; i < LINEAR_TABLE_SIZE; ++i) {
+				float l = i / float(LINEAR_TABLE_SIZE - 1);
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				values[i] = static_cast<uint8_t>(std::min(255.0f, c * 255.0f + 0.5f));
+			}
+			return values;
+		}();
+		return table.data();
+	}
+
+}
@@ -1,9 +1,13 @@
 #pragma once
 #include "../base.h"
+#include "../VulkanWrapper/buffer.hpp"
+#include "../VulkanWrapper/commandBuffer.hpp"
 #include "../VulkanWrapper/device.hpp"
 #include "../VulkanWrapper/commandPool.hpp"
 #include "../VulkanWrapper/image.hpp"
 #include "../VulkanWrapper/sampler.hpp"
+#include "mipmapGenerator.hpp"
+#include "textureFile.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include "../stb_image.h"
 namespace VK {
@@ -14,6 +18,10 @@ namespace VK {
 		Wrapper::Image::Ptr mImage{ nullptr };
 		Wrapper::Sampler::Ptr mSampler{ nullptr };
 		VkDescriptorImageInfo mImageInfo{};
+		// 异步加载的纹理在上传完成前指向占位图
+		bool mReady{ true };
+		// 异步加载失败的原因，失败后一直停在占位图上
+		std::string mError{};
 
 	public:
 		using Ptr = std::shared_ptr<Texture>;
@@ -21,41 +29,78 @@ namespace VK {
 			return std::make_shared<Texture>(device, commandPool, imageFilePath);
 		}
 
+		// 包装一张已经上传好并处于SHADER_READ_ONLY的image
+		static Ptr create(const Wrapper::Device::Ptr& device, const Wrapper::Image::Ptr& image, bool ready = true) {
+			return std::make_shared<Texture>(device, image, ready);
+		}
+
 		Texture(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const std::string& imageFilePath);
 
+		Texture(const Wrapper::Device::Ptr& device, const Wrapper::Image::Ptr& image, bool ready);
+
 		~Texture() ;
 		[[nodiscard]] auto& GetImageInfo(){
 			return mImageInfo;
 		}
 
+		[[nodiscard]] auto& GetImage() const { return mImage; }
+		[[nodiscard]] bool IsReady() const { return mReady; }
+		[[nodiscard]] bool HasFailed() const { return !mError.empty(); }
+		[[nodiscard]] auto& GetError() const { return mError; }
+		void SetFailed(const std::string& error) { mError = error; }
 
+		// 替换image(比如异步上传完成)，已经写进descriptorSet的旧信息需要调用方自己刷新
+		void SetImage(const Wrapper::Image::Ptr& image);
+
+		// 解码图片或读取ktx2/dds，generateMips为true时png/jpg会在cpu上补齐整条mip链
+		// 可以在任意线程调用
+		static TextureFileData DecodeFile(const std::string& imageFilePath, bool generateMips);
 
 	};
+	// 布局转换、拷贝和mip生成录制在同一个commandBuffer里，只提交一次
 	Texture::Texture(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, const std::string& imageFilePath)
 	{
 
 		mDevice = device;
 
-		int texWidth, texHeight, texSize, texChannles;
-		stbi_uc* pixels = stbi_load(imageFilePath.c_str(), &texWidth, &texHeight, &texChannles, STBI_rgb_alpha);
+		auto data = DecodeFile(imageFilePath, false);
 		std::cout<<imageFilePath.c_str()<<std::endl;
-		if (!pixels) {
-			throw std::runtime_error("Error: failed to read image data");
+
+		if (!mDevice->IsFormatSupported(data.mFormat, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT)) {
+			throw std::runtime_error("Error: texture format is not supported by device " + imageFilePath);
 		}
 
-		texSize = texWidth * texHeight * 4;
+		// 文件里只有一级的非压缩图片需要补mip，ktx2/dds里带了几级就用几级
+		const bool generateMips = data.mLevels.size() == 1 && !TextureFile::IsCompressedFormat(data.mFormat);
+		const uint32_t mipLevels = generateMips
+			? Wrapper::Image::CalculateMipLevels(data.mWidth, data.mHeight)
+			: static_cast<uint32_t>(data.mLevels.size());
 
+		// blit生成mip时每一级既是源又是目标
 		mImage = Wrapper::Image::Create(
-			mDevice, texWidth, texHeight,
-			VK_FORMAT_R8G8B8A8_SRGB,
+			mDevice, data.mWidth, data.mHeight,
+			data.mFormat,
 			VK_IMAGE_TYPE_2D,
 			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 			VK_SAMPLE_COUNT_1_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			VK_IMAGE_ASPECT_COLOR_BIT
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			mipLevels,
+			Wrapper::MemoryCategory::Texture
 		);
 
+		// 优先在gpu上blit，格式不支持线性过滤时退回cpu生成，和第0级一起上传
+		const bool blitMips = generateMips && mImage->SupportsBlitMipmaps();
+		if (generateMips && !blitMips) {
+			for (auto& level : MipmapGenerator::Generate(data.mData.data(), data.mWidth, data.mHeight, true)) {
+				data.mLevels.push_back({ level.mWidth, level.mHeight, data.mData.size(), level.mPixels.size() });
+				data.mData.insert(data.mData.end(), level.mPixels.begin(), level.mPixels.end());
+			}
+		}
+
+		auto stageBuffer = Wrapper::Buffer::CreateStageBuffer(mDevice, data.mData.size(), data.mData.data());
+
 		VkImageSubresourceRange region{};
 		region.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 
@@ -63,35 +108,91 @@ namespace VK {
 		region.layerCount = 1;
 
 		region.baseMipLevel = 0;
-		region.levelCount = 1;
+		region.levelCount = mipLevels;
+
+		auto commandBuffer = Wrapper::CommandBuffer::Create(mDevice, commandPool);
+		commandBuffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
 		mImage->SetImageLayout(
+			commandBuffer,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			region,
-			commandPool
+			region
 		);
 
-		mImage->FillImageData(texSize, (void*)pixels, commandPool);
+		mImage->CopyFromBuffer(commandBuffer, stageBuffer->getBuffer(), TextureFile::GetCopyRegions(data.mLevels));
 
-		mImage->SetImageLayout(
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			region,
-			commandPool
-		);
+		if (blitMips) {
+			mImage->GenerateMipmaps(commandBuffer);
+		}
+		else {
+			mImage->SetImageLayout(
+				commandBuffer,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				region
+			);
+		}
 
-		stbi_image_free(pixels);
+		commandBuffer->End();
+		commandBuffer->SubmitSync(mDevice->GetGraphicQueue());
 
-		mSampler = Wrapper::Sampler::create(mDevice);
+		mSampler = Wrapper::Sampler::create(mDevice, static_cast<float>(mImage->GetMipLevels()));
 
 		mImageInfo.imageLayout = mImage->GetLayout();
 		mImageInfo.imageView = mImage->GetImageView();
 		mImageInfo.sampler = mSampler->getSampler();
 
 	}
+
+	Texture::Texture(const Wrapper::Device::Ptr& device, const Wrapper::Image::Ptr& image, bool ready) {
+		mDevice = device;
+		SetImage(image);
+		mReady = ready;
+	}
+
+	void Texture::SetImage(const Wrapper::Image::Ptr& image) {
+		mImage = image;
+		// maxLod不限制，换image时sampler可以继续用，正在执行的帧里引用的sampler也不会被销毁
+		if (mSampler == nullptr) {
+			mSampler = Wrapper::Sampler::create(mDevice);
+		}
+
+		mImageInfo.imageLayout = mImage->GetLayout();
+		mImageInfo.imageView = mImage->GetImageView();
+		mImageInfo.sampler = mSampler->getSampler();
+		mReady = true;
+	}
+
+	TextureFileData Texture::DecodeFile(const std::string& imageFilePath, bool generateMips) {
+		if (TextureFile::IsContainerFile(imageFilePath)) {
+			return TextureFile::Load(imageFilePath);
+		}
+
+		int texWidth, texHeight, texChannles;
+		stbi_uc* pixels = stbi_load(imageFilePath.c_str(), &texWidth, &texHeight, &texChannles, STBI_rgb_alpha);
+		if (!pixels) {
+			throw std::runtime_error("Error: failed to read image data " + imageFilePath);
+		}
+
+		TextureFileData data{};
+		data.mFormat = VK_FORMAT_R8G8B8A8_SRGB;
+		data.mWidth = static_cast<uint32_t>(texWidth);
+		data.mHeight = static_cast<uint32_t>(texHeight);
+		data.mLevels.push_back({ data.mWidth, data.mHeight, 0, static_cast<size_t>(texWidth) * texHeight * 4 });
+		data.mData.assign(pixels, pixels + data.mLevels[0].mSize);
+		stbi_image_free(pixels);
+
+		if (generateMips) {
+			for (auto& level : MipmapGenerator::Generate(data.mData.data(), data.mWidth, data.mHeight, true)) {
+				data.mLevels.push_back({ level.mWidth, level.mHeight, data.mData.size(), level.mPixels.size() });
+				data.mData.insert(data.mData.end(), level.mPixels.begin(), level.mPixels.end());
+			}
+		}
+		return data;
+	}
 	Texture::~Texture() {
 
 	}
@@ -0,0 +1,553 @@
+#pragma once
+#include "../base.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <numeric>
+
+namespace VK {
+
+	// 压缩格式按块存储，BC/ETC2是4x4一块，ASTC的块大小随格式变化
+	struct FormatBlockInfo {
+		uint32_t mBlockWidth{ 1 };
+		uint32_t mBlockHeight{ 1 };
+		uint32_t mBlockBytes{ 0 };
+	};
+
+	struct TextureFileLevel {
+		uint32_t mWidth{ 0 };
+		uint32_t mHeight{ 0 };
+		size_t mOffset{ 0 };
+		size_t mSize{ 0 };
+	};
+
+	// 容器文件解析出来的数据，mLevels[0]是最大的一级，偏移都相对mData
+	struct TextureFileData {
+		VkFormat mFormat{ VK_FORMAT_UNDEFINED };
+		uint32_t mWidth{ 0 };
+		uint32_t mHeight{ 0 };
+		std::vector<TextureFileLevel> mLevels{};
+		std::vector<uint8_t> mData{};
+	};
+
+	// KTX2 / DDS 的读取，以及KTX2的写出(给离线转换工具用)
+	// 只支持单层2D纹理，不支持cubemap、数组和KTX2的supercompression
+	class TextureFile {
+	public:
+		static bool IsContainerFile(const std::string& path);
+
+		// 按扩展名选择格式
+		static TextureFileData Load(const std::string& path);
+		static TextureFileData LoadKTX2(const std::string& path);
+		static TextureFileData LoadDDS(const std::string& path);
+
+		// 只读文件头和各级的位置，mData为空，mLevels里的偏移是文件内的偏移
+		// 给流送用：启动时只读最小的几级，之后按需再从文件里读更精细的级别
+		static TextureFileData LoadHeader(const std::string& path);
+		// 把[firstLevel, 最后一级]从文件读进data，按级别从大到小紧密排列
+		// levels返回这些级别，偏移相对data
+		static void ReadLevels(const std::string& path, const TextureFileData& header, uint32_t firstLevel,
+			std::vector<uint8_t>& data, std::vector<TextureFileLevel>& levels);
+
+		static void WriteKTX2(const std::string& path, const TextureFileData& data);
+
+		static FormatBlockInfo GetBlockInfo(VkFormat format);
+		static bool IsCompressedFormat(VkFormat format);
+		static bool IsSrgbFormat(VkFormat format);
+		static size_t CalculateLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+		// 各级数据紧密排在一个stagingBuffer里时对应的拷贝区域
+		static std::vector<VkBufferImageCopy> GetCopyRegions(const std::vector<TextureFileLevel>& levels, size_t baseOffset = 0);
+
+	private:
+		static std::vector<uint8_t> ReadFile(const std::string& path);
+		// 读[offset, offset + size)，文件不够长时只读到结尾，fileSize返回整个文件的大小
+		static std::vector<uint8_t> ReadFileRange(const std::string& path, size_t offset, size_t size, size_t& fileSize);
+		static TextureFileData LoadKTX2Header(const std::string& path);
+		static TextureFileData LoadDDSHeader(const std::string& path);
+		// 整个文件一次读完，各级拷成从第0级开始的一整块
+		static TextureFileData LoadAll(const std::string& path, const TextureFileData& header);
+		static std::string GetExtension(const std::string& path);
+		static VkFormat DxgiToVkFormat(uint32_t dxgiFormat);
+		static void AppendDataFormatDescriptor(VkFormat format, std::vector<uint8_t>& out);
+
+		template<typename T>
+		static T Read(const std::vector<uint8_t>& bytes, size_t offset) {
+			if (offset + sizeof(T) > bytes.size()) {
+				throw std::runtime_error("Error: texture file is truncated");
+			}
+			T value{};
+			memcpy(&value, bytes.data() + offset, sizeof(T));
+			return value;
+		}
+
+		template<typename T>
+		static void Write(std::vector<uint8_t>& out, T value) {
+			auto bytes = reinterpret_cast<const uint8_t*>(&value);
+			out.insert(out.end(), bytes, bytes + sizeof(T));
+		}
+
+		static constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+		static constexpr size_t KTX2_HEADER_SIZE{ 80 };
+		static constexpr uint32_t DDS_MAGIC{ 0x20534444 };
+		static constexpr size_t DDS_HEADER_SIZE{ 124 };
+		static constexpr size_t DDS_DX10_HEADER_SIZE{ 20 };
+	};
+
+	inline constexpr uint32_t MakeFourCC(char a, char b, char c, char d) {
+		return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+	}
+
+	std::string TextureFile::GetExtension(const std::string& path) {
+		auto dot = path.find_last_of('.');
+		if (dot == std::string::npos) {
+			return "";
+		}
+		std::string ext = path.substr(dot + 1);
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return ext;
+	}
+
+	bool TextureFile::IsContainerFile(const std::string& path) {
+		auto ext = GetExtension(path);
+		return ext == "ktx2" || ext == "dds";
+	}
+
+	std::vector<uint8_t> TextureFile::ReadFile(const std::string& path) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file) {
+			throw std::runtime_error("Error: failed to open texture file " + path);
+		}
+
+		std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+		return bytes;
+	}
+
+	TextureFileData TextureFile::Load(const std::string& path) {
+		auto ext = GetExtension(path);
+		if (ext == "ktx2") {
+			return LoadKTX2(path);
+		}
+		if (ext == "dds") {
+			return LoadDDS(path);
+		}
+		throw std::runtime_error("Error: unknown texture container " + path);
+	}
+
+	std::vector<uint8_t> TextureFile::ReadFileRange(const std::string& path, size_t offset, size_t size, size_t& fileSize) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file) {
+			throw std::runtime_error("Error: failed to open texture file " + path);
+		}
+
+		fileSize = static_cast<size_t>(file.tellg());
+		const size_t end = std::min(fileSize, offset + size);
+		std::vector<uint8_t> bytes(end > offset ? end - offset : 0);
+		file.seekg(static_cast<std::streamoff>(offset));
+		file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+		return bytes;
+	}
+
+	TextureFileData TextureFile::LoadHeader(const std::string& path) {
+		auto ext = GetExtension(path);
+		if (ext == "ktx2") {
+			return LoadKTX2Header(path);
+		}
+		if (ext == "dds") {
+			return LoadDDSHeader(path);
+		}
+		throw std::runtime_error("Error: unknown texture container " + path);
+	}
+
+	TextureFileData TextureFile::LoadKTX2(const std::string& path) {
+		return LoadAll(path, LoadKTX2Header(path));
+	}
+
+	TextureFileData TextureFile::LoadDDS(const std::string& path) {
+		return LoadAll(path, LoadDDSHeader(path));
+	}
+
+	TextureFileData TextureFile::LoadKTX2Header(const std::string& path) {
+		size_t fileSize = 0;
+		auto bytes = ReadFileRange(path, 0, KTX2_HEADER_SIZE, fileSize);
+		if (bytes.size() < KTX2_HEADER_SIZE || memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+			throw std::runtime_error("Error: not a ktx2 file " + path);
+		}
+
+		TextureFileData data{};
+		data.mFormat = static_cast<VkFormat>(Read<uint32_t>(bytes, 12));
+		data.mWidth = Read<uint32_t>(bytes, 20);
+		data.mHeight = std::max(1u, Read<uint32_t>(bytes, 24));
+		uint32_t depth = Read<uint32_t>(bytes, 28);
+		uint32_t layerCount = Read<uint32_t>(bytes, 32);
+		uint32_t faceCount = Read<uint32_t>(bytes, 36);
+		// levelCount为0表示要求加载方自己生成mip
+		uint32_t levelCount = std::max(1u, Read<uint32_t>(bytes, 40));
+		uint32_t supercompression = Read<uint32_t>(bytes, 44);
+
+		if (data.mFormat == VK_FORMAT_UNDEFINED) {
+			throw std::runtime_error("Error: basis universal ktx2 is not supported " + path);
+		}
+		if (supercompression != 0) {
+			throw std::runtime_error("Error: ktx2 supercompression is not supported " + path);
+		}
+		if (depth > 1 || layerCount > 1 || faceCount != 1) {
+			throw std::runtime_error("Error: only single 2d ktx2 images are supported " + path);
+		}
+
+		// 索引里第0项是最大的一级，但文件里的数据是从小到大排的，按偏移取就行
+		auto index = ReadFileRange(path, KTX2_HEADER_SIZE, static_cast<size_t>(levelCount) * 24, fileSize);
+		data.mLevels.resize(levelCount);
+		for (uint32_t i = 0; i < levelCount; ++i) {
+			auto& level = data.mLevels[i];
+			level.mWidth = std::max(1u, data.mWidth >> i);
+			level.mHeight = std::max(1u, data.mHeight >> i);
+			level.mOffset = static_cast<size_t>(Read<uint64_t>(index, i * 24));
+			level.mSize = static_cast<size_t>(Read<uint64_t>(index, i * 24 + 8));
+			if (level.mOffset + level.mSize > fileSize) {
+				throw std::runtime_error("Error: ktx2 level data is out of range " + path);
+			}
+		}
+		return data;
+	}
+
+	TextureFileData TextureFile::LoadDDSHeader(const std::string& path) {
+		size_t fileSize = 0;
+		auto bytes = ReadFileRange(path, 0, 4 + DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE, fileSize);
+		if (bytes.size() < 4 + DDS_HEADER_SIZE || Read<uint32_t>(bytes, 0) != DDS_MAGIC) {
+			throw std::runtime_error("Error: not a dds file " + path);
+		}
+
+		TextureFileData data{};
+		data.mHeight = Read<uint32_t>(bytes, 12);
+		data.mWidth = Read<uint32_t>(bytes, 16);
+		uint32_t levelCount = std::max(1u, Read<uint32_t>(bytes, 28));
+		uint32_t fourCC = Read<uint32_t>(bytes, 84);
+
+		size_t dataOffset = 4 + DDS_HEADER_SIZE;
+		if (fourCC == MakeFourCC('D', 'X', '1', '0')) {
+			data.mFormat = DxgiToVkFormat(Read<uint32_t>(bytes, dataOffset));
+			if (Read<uint32_t>(bytes, dataOffset + 12) > 1) {
+				throw std::runtime_error("Error: dds texture arrays are not supported " + path);
+			}
+			dataOffset += DDS_DX10_HEADER_SIZE;
+		}
+		// 老格式的FourCC不区分srgb，一律按unorm处理
+		else if (fourCC == MakeFourCC('D', 'X', 'T', '1')) {
+			data.mFormat = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		}
+		else if (fourCC == MakeFourCC('D', 'X', 'T', '5')) {
+			data.mFormat = VK_FORMAT_BC3_UNORM_BLOCK;
+		}
+		else if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U')) {
+			data.mFormat = VK_FORMAT_BC5_UNORM_BLOCK;
+		}
+
+		if (data.mFormat == VK_FORMAT_UNDEFINED) {
+			throw std::runtime_error("Error: unsupported dds pixel format " + path);
+		}
+
+		// dds里各级从大到小紧密排列
+		size_t offset = dataOffset;
+		for (uint32_t i = 0; i < levelCount; ++i) {
+			TextureFileLevel level{};
+			level.mWidth = std::max(1u, data.mWidth >> i);
+			level.mHeight = std::max(1u, data.mHeight >> i);
+			level.mOffset = offset;
+			level.mSize = CalculateLevelSize(data.mFormat, level.mWidth, level.mHeight);
+			offset += level.mSize;
+			data.mLevels.push_back(level);
+		}
+
+		if (offset > fileSize) {
+			throw std::runtime_error("Error: dds level data is out of range " + path);
+		}
+		return data;
+	}
+
+	TextureFileData TextureFile::LoadAll(const std::string& path, const TextureFileData& header) {
+		auto bytes = ReadFile(path);
+
+		TextureFileData data{};
+		data.mFormat = header.mFormat;
+		data.mWidth = header.mWidth;
+		data.mHeight = header.mHeight;
+		data.mLevels = header.mLevels;
+
+		size_t totalSize = 0;
+		for (const auto& level : data.mLevels) {
+			totalSize += level.mSize;
+		}
+		data.mData.resize(totalSize);
+		size_t offset = 0;
+		for (auto& level : data.mLevels) {
+			if (level.mOffset + level.mSize > bytes.size()) {
+				throw std::runtime_error("Error: texture level data is out of range " + path);
+			}
+			memcpy(data.mData.data() + offset, bytes.data() + level.mOffset, level.mSize);
+			level.mOffset = offset;
+			offset += level.mSize;
+		}
+		return data;
+	}
+
+	void TextureFile::ReadLevels(const std::string& path, const TextureFileData& header, uint32_t firstLevel,
+		std::vector<uint8_t>& data, std::vector<TextureFileLevel>& levels) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			throw std::runtime_error("Error: failed to open texture file " + path);
+		}
+
+		levels.assign(header.mLevels.begin() + firstLevel, header.mLevels.end());
+		size_t totalSize = 0;
+		for (const auto& level : levels) {
+			totalSize += level.mSize;
+		}
+		data.resize(totalSize);
+
+		size_t offset = 0;
+		for (auto& level : levels) {
+			file.seekg(static_cast<std::streamoff>(level.mOffset));
+			file.read(reinterpret_cast<char*>(data.data() + offset), level.mSize);
+			if (static_cast<size_t>(file.gcount()) != level.mSize) {
+				throw std::runtime_error("Error: texture file is truncated " + path);
+			}
+			level.mOffset = offset;
+			offset += level.mSize;
+		}
+	}
+
+	void TextureFile::WriteKTX2(const std::string& path, const TextureFileData& data) {
+		const uint32_t levelCount = static_cast<uint32_t>(data.mLevels.size());
+		const auto blockInfo = GetBlockInfo(data.mFormat);
+
+		std::vector<uint8_t> dfd{};
+		AppendDataFormatDescriptor(data.mFormat, dfd);
+
+		const size_t levelIndexSize = levelCount * 24;
+		const size_t dfdOffset = KTX2_HEADER_SIZE + levelIndexSize;
+
+		// 每一级的起始位置要对齐到 lcm(块大小, 4)
+		const size_t alignment = std::lcm<size_t>(blockInfo.mBlockBytes, 4);
+		auto alignUp = [alignment](size_t value) { return (value + alignment - 1) / alignment * alignment; };
+
+		// 规范要求数据从最小的一级开始存
+		std::vector<uint64_t> fileOffsets(levelCount);
+		size_t cursor = dfdOffset + dfd.size();
+		for (uint32_t i = levelCount; i-- > 0;) {
+			cursor = alignUp(cursor);
+			fileOffsets[i] = cursor;
+			cursor += data.mLevels[i].mSize;
+		}
+
+		std::vector<uint8_t> out{};
+		out.reserve(cursor);
+		out.insert(out.end(), std::begin(KTX2_IDENTIFIER), std::end(KTX2_IDENTIFIER));
+		Write<uint32_t>(out, static_cast<uint32_t>(data.mFormat));
+		Write<uint32_t>(out, 1);                       // typeSize，压缩格式固定为1
+		Write<uint32_t>(out, data.mWidth);
+		Write<uint32_t>(out, data.mHeight);
+		Write<uint32_t>(out, 0);                       // pixelDepth
+		Write<uint32_t>(out, 0);                       // layerCount
+		Write<uint32_t>(out, 1);                       // faceCount
+		Write<uint32_t>(out, levelCount);
+		Write<uint32_t>(out, 0);                       // supercompressionScheme
+		Write<uint32_t>(out, static_cast<uint32_t>(dfdOffset));
+		Write<uint32_t>(out, static_cast<uint32_t>(dfd.size()));
+		Write<uint32_t>(out, 0);                       // kvd
+		Write<uint32_t>(out, 0);
+		Write<uint64_t>(out, 0);                       // sgd
+		Write<uint64_t>(out, 0);
+
+		for (uint32_t i = 0; i < levelCount; ++i) {
+			Write<uint64_t>(out, fileOffsets[i]);
+			Write<uint64_t>(out, data.mLevels[i].mSize);
+			Write<uint64_t>(out, data.mLevels[i].mSize);
+		}
+		out.insert(out.end(), dfd.begin(), dfd.end());
+
+		for (uint32_t i = levelCount; i-- > 0;) {
+			out.resize(fileOffsets[i], 0);
+			const auto& level = data.mLevels[i];
+			out.insert(out.end(), data.mData.begin() + level.mOffset, data.mData.begin() + level.mOffset + level.mSize);
+		}
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file) {
+			throw std::runtime_error("Error: failed to write texture file " + path);
+		}
+		file.write(reinterpret_cast<const char*>(out.data()), out.size());
+	}
+
+	// KTX2要求带一个Khronos Data Format描述块，这里只写转换工具会输出的那几种格式
+	void TextureFile::AppendDataFormatDescriptor(VkFormat format, std::vector<uint8_t>& out) {
+		enum : uint8_t { CHANNEL_RED = 0, CHANNEL_GREEN = 1, CHANNEL_COLOR = 0, CHANNEL_ALPHA = 15, CHANNEL_LINEAR = 0x10 };
+		struct Sample { uint16_t mBitOffset; uint8_t mChannel; };
+
+		uint8_t colorModel = 0;
+		std::vector<Sample> samples{};
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			colorModel = 128;
+			samples = { { 0, CHANNEL_COLOR } };
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			colorModel = 130;
+			samples = { { 0, CHANNEL_ALPHA }, { 64, CHANNEL_COLOR } };
+			break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			colorModel = 132;
+			samples = { { 0, CHANNEL_RED }, { 64, CHANNEL_GREEN } };
+			break;
+		default:
+			throw std::runtime_error("Error: no data format descriptor for this format");
+		}
+
+		const bool srgb = IsSrgbFormat(format);
+		const auto blockInfo = GetBlockInfo(format);
+		const uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+		Write<uint32_t>(out, 4 + blockSize);                 // dfdTotalSize
+		Write<uint32_t>(out, 0);                             // vendorId | descriptorType
+		Write<uint32_t>(out, 2 | (blockSize << 16));         // versionNumber | descriptorBlockSize
+		// colorModel, BT709, 传输函数(1线性/2sRGB), flags(alpha直通)
+		Write<uint32_t>(out, colorModel | (1u << 8) | ((srgb ? 2u : 1u) << 16));
+		Write<uint32_t>(out, (blockInfo.mBlockWidth - 1) | ((blockInfo.mBlockHeight - 1) << 8));
+		Write<uint32_t>(out, blockInfo.mBlockBytes);         // bytesPlane0..3
+		Write<uint32_t>(out, 0);                             // bytesPlane4..7
+		for (const auto& sample : samples) {
+			uint8_t channel = sample.mChannel;
+			// srgb格式的alpha仍然是线性的
+			if (srgb && channel == CHANNEL_ALPHA) {
+				channel |= CHANNEL_LINEAR;
+			}
+			Write<uint32_t>(out, sample.mBitOffset | (63u << 16) | (uint32_t(channel) << 24));
+			Write<uint32_t>(out, 0);                         // samplePosition
+			Write<uint32_t>(out, 0);                         // sampleLower
+			Write<uint32_t>(out, 0xFFFFFFFFu);               // sampleUpper
+		}
+	}
+
+	VkFormat TextureFile::DxgiToVkFormat(uint32_t dxgiFormat) {
+		switch (dxgiFormat) {
+		case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+		case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+		case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+		case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+		case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+		case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+		case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+		case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+		case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+		case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+		case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+		case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+		case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+		case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+		default: return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	FormatBlockInfo TextureFile::GetBlockInfo(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			return { 1, 1, 4 };
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+			return { 4, 4, 8 };
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+			return { 4, 4, 16 };
+		case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+			return { 4, 4, 16 };
+		case VK_FORMAT_ASTC_5x5_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:
+			return { 5, 5, 16 };
+		case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+			return { 6, 6, 16 };
+		case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+		case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+			return { 8, 8, 16 };
+		default:
+			throw std::runtime_error("Error: unsupported texture format");
+		}
+	}
+
+	bool TextureFile::IsCompressedFormat(VkFormat format) {
+		return GetBlockInfo(format).mBlockWidth > 1;
+	}
+
+	bool TextureFile::IsSrgbFormat(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+		case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	size_t TextureFile::CalculateLevelSize(VkFormat format, uint32_t width, uint32_t height) {
+		auto info = GetBlockInfo(format);
+		size_t blocksX = (width + info.mBlockWidth - 1) / info.mBlockWidth;
+		size_t blocksY = (height + info.mBlockHeight - 1) / info.mBlockHeight;
+		return blocksX * blocksY * info.mBlockBytes;
+	}
+
+	std::vector<VkBufferImageCopy> TextureFile::GetCopyRegions(const std::vector<TextureFileLevel>& levels, size_t baseOffset) {
+		std::vector<VkBufferImageCopy> regions{};
+		for (uint32_t i = 0; i < levels.size(); ++i) {
+			VkBufferImageCopy region{};
+			region.bufferOffset = levels[i].mOffset - baseOffset;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = i;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = { levels[i].mWidth, levels[i].mHeight, 1 };
+			regions.push_back(region);
+		}
+		return regions;
+	}
+
+}
@@ -0,0 +1,320 @@
+#pragma once
+#include "../base.h"
+#include "../VulkanWrapper/buffer.hpp"
+#include "../VulkanWrapper/commandBuffer.hpp"
+#include "../VulkanWrapper/commandPool.hpp"
+#include "../VulkanWrapper/device.hpp"
+#include "../VulkanWrapper/fence.hpp"
+#include "../VulkanWrapper/image.hpp"
+#include "../profiler.hpp"
+#include "texture.hpp"
+#include "textureFile.hpp"
+#include "textureUploadBatch.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace VK {
+
+	// 异步纹理加载
+	// 工作线程负责解码、生成mip、写入stagingBuffer；主线程在Update里把已解码的纹理
+	// 合到一个commandBuffer里上传，fence完成后把纹理从占位图切换到真正的image
+	// LoadAsync返回的纹理立刻可以绑定，上传完成前采样到的是占位图
+	class TextureLoader {
+	private:
+		struct DecodeJob {
+			Texture::Ptr mTexture{ nullptr };
+			std::string mPath{};
+		};
+
+		// 工作线程的产出，mStageBuffer里各级mip紧密排列
+		struct DecodedTexture {
+			Texture::Ptr mTexture{ nullptr };
+			std::string mPath{};
+			VkFormat mFormat{ VK_FORMAT_UNDEFINED };
+			uint32_t mWidth{ 0 };
+			uint32_t mHeight{ 0 };
+			std::vector<TextureFileLevel> mLevels{};
+			Wrapper::Buffer::Ptr mStageBuffer{ nullptr };
+			std::string mError{};
+		};
+
+		struct UploadBatch {
+			Wrapper::CommandBuffer::Ptr mCommandBuffer{ nullptr };
+			Wrapper::Fence::Ptr mFence{ nullptr };
+			TextureUploadBatch::Ptr mBatch{ nullptr };
+			std::vector<DecodedTexture> mTextures{};
+			std::vector<Wrapper::Image::Ptr> mImages{};
+		};
+
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		Wrapper::CommandPool::Ptr mCommandPool{ nullptr };
+		Wrapper::Image::Ptr mPlaceholderImage{ nullptr };
+
+		std::vector<std::thread> mWorkers{};
+		std::mutex mMutex{};
+		std::condition_variable mJobCondition{};
+		std::condition_variable mDecodedCondition{};
+		std::deque<DecodeJob> mJobs{};
+		std::vector<DecodedTexture> mDecoded{};
+		size_t mDecoding{ 0 };
+		bool mStop{ false };
+
+		// 只在主线程访问
+		std::vector<UploadBatch> mUploads{};
+		std::function<void(const Texture::Ptr&)> mOnLoaded{};
+		std::function<void(const Texture::Ptr&)> mOnFailed{};
+		VkDeviceSize mUploadedBytes{ 0 };
+
+	public:
+		using Ptr = std::shared_ptr<TextureLoader>;
+		static Ptr create(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, uint32_t threadCount = 0) {
+			return std::make_shared<TextureLoader>(device, commandPool, threadCount);
+		}
+
+		// threadCount为0时按cpu核数减一
+		TextureLoader(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, uint32_t threadCount);
+
+		~TextureLoader();
+
+		Texture::Ptr LoadAsync(const std::string& imageFilePath);
+
+		// 每帧在主线程调用一次：提交新解码好的纹理，处理已经上传完成的批次
+		void Update();
+
+		// 阻塞直到所有已请求的纹理都上传完成，用于关卡加载
+		void WaitIdle();
+
+		// 纹理切换到真正的image之后回调，bindless表和写着占位图imageView的descriptorSet都要在这里刷新
+		void SetOnLoaded(const std::function<void(const Texture::Ptr&)>& onLoaded) { mOnLoaded = onLoaded; }
+
+		// 解码或者格式检查失败时回调，失败原因在Texture::GetError里，纹理继续使用占位图
+		void SetOnFailed(const std::function<void(const Texture::Ptr&)>& onFailed) { mOnFailed = onFailed; }
+
+		[[nodiscard]] size_t GetPendingCount();
+		[[nodiscard]] auto GetThreadCount() const { return mWorkers.size(); }
+		// 累计提交上传的字节数，主线程访问
+		[[nodiscard]] auto GetUploadedBytes() const { return mUploadedBytes; }
+
+	private:
+		void WorkerLoop();
+		DecodedTexture Decode(const DecodeJob& job);
+		void SubmitUploads(std::vector<DecodedTexture>& decoded);
+		void FinishUploads(bool wait);
+		void CreatePlaceholder();
+	};
+
+	TextureLoader::TextureLoader(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, uint32_t threadCount) {
+		mDevice = device;
+		mCommandPool = commandPool;
+
+		CreatePlaceholder();
+
+		if (threadCount == 0) {
+			threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		}
+		for (uint32_t i = 0; i < threadCount; ++i) {
+			mWorkers.emplace_back(&TextureLoader::WorkerLoop, this);
+		}
+	}
+
+	TextureLoader::~TextureLoader() {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+		mJobCondition.notify_all();
+		for (auto& worker : mWorkers) {
+			worker.join();
+		}
+
+		FinishUploads(true);
+	}
+
+	// 1x1的灰色占位图
+	void TextureLoader::CreatePlaceholder() {
+		mPlaceholderImage = Wrapper::Image::Create(
+			mDevice, 1, 1,
+			VK_FORMAT_R8G8B8A8_SRGB,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			1,
+			Wrapper::MemoryCategory::Texture
+		);
+
+		VkImageSubresourceRange region{};
+		region.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.levelCount = 1;
+		region.layerCount = 1;
+
+		mPlaceholderImage->SetImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, region, mCommandPool);
+
+		uint8_t pixel[4] = { 128, 128, 128, 255 };
+		mPlaceholderImage->FillImageData(sizeof(pixel), pixel, mCommandPool);
+
+		mPlaceholderImage->SetImageLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, region, mCommandPool);
+	}
+
+	Texture::Ptr TextureLoader::LoadAsync(const std::string& imageFilePath) {
+		auto texture = Texture::create(mDevice, mPlaceholderImage, false);
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mJobs.push_back({ texture, imageFilePath });
+		}
+		mJobCondition.notify_one();
+		return texture;
+	}
+
+	void TextureLoader::WorkerLoop() {
+		while (true) {
+			DecodeJob job{};
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mJobCondition.wait(lock, [this] { return mStop || !mJobs.empty(); });
+				if (mStop) {
+					return;
+				}
+				job = std::move(mJobs.front());
+				mJobs.pop_front();
+				mDecoding++;
+			}
+
+			auto decoded = Decode(job);
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mDecoded.push_back(std::move(decoded));
+				mDecoding--;
+			}
+			mDecodedCondition.notify_all();
+		}
+	}
+
+	TextureLoader::DecodedTexture TextureLoader::Decode(const DecodeJob& job) {
+		VK_PROFILE_SCOPE("texture decode");
+		DecodedTexture decoded{};
+		decoded.mTexture = job.mTexture;
+		decoded.mPath = job.mPath;
+
+		try {
+			// png/jpg在工作线程上直接生成整条mip链，上传时不再需要blit
+			auto data = Texture::DecodeFile(job.mPath, true);
+			if (!mDevice->IsFormatSupported(data.mFormat, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT)) {
+				throw std::runtime_error("Error: texture format is not supported by device " + job.mPath);
+			}
+
+			decoded.mFormat = data.mFormat;
+			decoded.mWidth = data.mWidth;
+			decoded.mHeight = data.mHeight;
+			decoded.mLevels = std::move(data.mLevels);
+			// stagingBuffer的创建和拷贝也放在工作线程，主线程只录制命令
+			decoded.mStageBuffer = Wrapper::Buffer::CreateStageBuffer(mDevice, data.mData.size(), data.mData.data());
+		}
+		catch (const std::exception& e) {
+			decoded.mError = e.what();
+		}
+		return decoded;
+	}
+
+	void TextureLoader::Update() {
+		FinishUploads(false);
+
+		std::vector<DecodedTexture> decoded{};
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			decoded.swap(mDecoded);
+		}
+		if (!decoded.empty()) {
+			SubmitUploads(decoded);
+		}
+	}
+
+	// 本次拿到的所有纹理共用一个commandBuffer，一次提交
+	void TextureLoader::SubmitUploads(std::vector<DecodedTexture>& decoded) {
+		VK_PROFILE_SCOPE("texture upload");
+		UploadBatch batch{};
+		batch.mBatch = TextureUploadBatch::create(mDevice);
+
+		for (auto& texture : decoded) {
+			if (!texture.mError.empty()) {
+				texture.mTexture->SetFailed(texture.mError);
+				if (mOnFailed) {
+					mOnFailed(texture.mTexture);
+				}
+				continue;
+			}
+
+			batch.mImages.push_back(batch.mBatch->Add(texture.mFormat, texture.mWidth, texture.mHeight, texture.mLevels, texture.mStageBuffer));
+			batch.mTextures.push_back(std::move(texture));
+		}
+
+		if (batch.mBatch->IsEmpty()) {
+			return;
+		}
+
+		batch.mCommandBuffer = Wrapper::CommandBuffer::Create(mDevice, mCommandPool);
+		batch.mCommandBuffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		batch.mBatch->Record(batch.mCommandBuffer);
+		batch.mCommandBuffer->End();
+		mUploadedBytes += batch.mCommandBuffer->GetStats().mBytesUploaded;
+
+		batch.mFence = Wrapper::Fence::Create(mDevice, false);
+		batch.mCommandBuffer->Submit(mDevice->GetGraphicQueue(), batch.mFence->GetFence());
+		mUploads.push_back(std::move(batch));
+	}
+
+	void TextureLoader::FinishUploads(bool wait) {
+		for (auto it = mUploads.begin(); it != mUploads.end();) {
+			if (wait) {
+				it->mFence->Block();
+			}
+			else if (vkGetFenceStatus(mDevice->GetDevice(), it->mFence->GetFence()) != VK_SUCCESS) {
+				++it;
+				continue;
+			}
+
+			for (size_t i = 0; i < it->mTextures.size(); ++i) {
+				auto& texture = it->mTextures[i].mTexture;
+				texture->SetImage(it->mImages[i]);
+				if (mOnLoaded) {
+					mOnLoaded(texture);
+				}
+			}
+			// stagingBuffer和commandBuffer随批次一起释放
+			it = mUploads.erase(it);
+		}
+	}
+
+	size_t TextureLoader::GetPendingCount() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		size_t pending = mJobs.size() + mDecoding + mDecoded.size();
+		for (const auto& upload : mUploads) {
+			pending += upload.mTextures.size();
+		}
+		return pending;
+	}
+
+	void TextureLoader::WaitIdle() {
+		while (true) {
+			Update();
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				if (mJobs.empty() && mDecoding == 0 && mDecoded.empty()) {
+					break;
+				}
+				mDecodedCondition.wait(lock, [this] { return !mDecoded.empty(); });
+			}
+		}
+		Update();
+		FinishUploads(true);
+	}
+
+}
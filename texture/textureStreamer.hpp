@@ -0,0 +1,393 @@
+#pragma once
+#include "../base.h"
+#include "../VulkanWrapper/buffer.hpp"
+#include "../VulkanWrapper/commandBuffer.hpp"
+#include "../VulkanWrapper/commandPool.hpp"
+#include "../VulkanWrapper/device.hpp"
+#include "../VulkanWrapper/fence.hpp"
+#include "../VulkanWrapper/image.hpp"
+#include "texture.hpp"
+#include "textureFile.hpp"
+#include <deque>
+#include <functional>
+
+namespace VK {
+
+	struct TextureStreamerStats {
+		size_t mTextureCount{ 0 };
+		VkDeviceSize mResidentBytes{ 0 };
+		// 配置的预算和设备剩余可用量取较小值
+		VkDeviceSize mBudgetBytes{ 0 };
+		VkDeviceSize mUploadedBytes{ 0 };
+		// 本帧从文件里读的字节数
+		VkDeviceSize mReadBytes{ 0 };
+		uint32_t mUpgradeCount{ 0 };
+		uint32_t mEvictCount{ 0 };
+	};
+
+	// 纹理流送
+	// 启动时每张纹理只上传小于STARTUP_MAX_SIZE的几级mip，之后根据相机反馈的屏幕尺寸按需换成更精细的mip链
+	// 显存超出预算时按最近使用时间(LRU)把别的纹理降回它实际需要的级别，长期不用的降回启动级别
+	// ktx2/dds只常驻文件头，启动时只从文件读最小的几级，升级和降级时再从文件读[level, 最后一级]上传成一张新image
+	// png/jpg没法只读一部分，解码出的整条mip链留在内存里
+	// Application用它加载模型纹理(--stream-texture)，在SetOnImageChanged里刷新引用旧imageView的descriptorSet
+	class TextureStreamer {
+	private:
+		struct Entry {
+			Texture::Ptr mTexture{ nullptr };
+			std::string mPath{};
+			// 容器文件只有文件头，mData为空，各级偏移是文件内的偏移
+			bool mFromFile{ false };
+			TextureFileData mData{};
+			// 当前显存里最精细的一级，以及反馈希望的一级
+			uint32_t mResidentLevel{ 0 };
+			uint32_t mRequestedLevel{ 0 };
+			uint32_t mStartupLevel{ 0 };
+			uint64_t mLastUsedFrame{ 0 };
+			VkDeviceSize mResidentBytes{ 0 };
+		};
+
+		// 被替换下来的image和本次上传用的stagingBuffer，等到所有可能引用它们的帧结束再释放
+		struct Retired {
+			uint64_t mFrame{ 0 };
+			Wrapper::Fence::Ptr mFence{ nullptr };
+			Wrapper::CommandBuffer::Ptr mCommandBuffer{ nullptr };
+			std::vector<Wrapper::Image::Ptr> mImages{};
+			std::vector<Wrapper::Buffer::Ptr> mStageBuffers{};
+		};
+
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		Wrapper::CommandPool::Ptr mCommandPool{ nullptr };
+		std::vector<Entry> mEntries{};
+		std::deque<Retired> mRetired{};
+
+		VkDeviceSize mBudget{ 0 };
+		VkDeviceSize mMaxUploadBytesPerFrame{ 16 * 1024 * 1024 };
+		uint32_t mFramesInFlight{ 2 };
+		uint64_t mFrame{ 0 };
+		TextureStreamerStats mStats{};
+		std::function<void(const Texture::Ptr&, VkImageView)> mOnImageChanged{};
+
+		static constexpr uint32_t STARTUP_MAX_SIZE{ 64 };
+		// 超过这么多帧没有反馈的纹理在预算紧张时直接降回启动级别
+		static constexpr uint64_t STALE_FRAMES{ 120 };
+
+	public:
+		using Ptr = std::shared_ptr<TextureStreamer>;
+		static Ptr create(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, VkDeviceSize budget, uint32_t framesInFlight) {
+			return std::make_shared<TextureStreamer>(device, commandPool, budget, framesInFlight);
+		}
+
+		TextureStreamer(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, VkDeviceSize budget, uint32_t framesInFlight);
+
+		~TextureStreamer();
+
+		// 返回句柄，纹理立刻可用(只有低分辨率的几级)
+		uint32_t Add(const std::string& imageFilePath);
+
+		[[nodiscard]] const Texture::Ptr& GetTexture(uint32_t handle) const { return mEntries[handle].mTexture; }
+
+		// 相机反馈：该纹理在屏幕上大约占多少像素，同一帧多次调用取最精细的需求
+		void RequestScreenSize(uint32_t handle, float screenPixels);
+
+		// 每帧调用一次，在该帧的fence等待之后、录制commandBuffer之前
+		void Update();
+
+		void SetBudget(VkDeviceSize budget) { mBudget = budget; }
+		void SetMaxUploadBytesPerFrame(VkDeviceSize bytes) { mMaxUploadBytesPerFrame = bytes; }
+
+		// 纹理换了image之后立刻回调，参数是纹理和被换下来的imageView
+		// 旧image要等提交过的帧都结束才销毁，在这之前要让之后的帧不再用到旧imageView：
+		// 刷新bindless槽位，DescriptorSetCache::Invalidate掉旧imageView并重新取材质的set
+		void SetOnImageChanged(const std::function<void(const Texture::Ptr&, VkImageView)>& onImageChanged) { mOnImageChanged = onImageChanged; }
+		[[nodiscard]] auto& GetStats() const { return mStats; }
+
+		// 包围球投影到屏幕上的直径(像素)
+		static float CalculateScreenSize(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& center, float radius, uint32_t viewportHeight);
+
+	private:
+		uint32_t CalculateLevelForScreenSize(const Entry& entry, float screenPixels) const;
+		VkDeviceSize CalculateResidentBytes(const Entry& entry, uint32_t level) const;
+		VkDeviceSize CalculateEffectiveBudget() const;
+		void StreamLevels();
+		void MakeResident(Entry& entry, uint32_t level, const Wrapper::CommandBuffer::Ptr& commandBuffer, Retired& retired);
+		void ReleaseRetired(bool wait);
+	};
+
+	TextureStreamer::TextureStreamer(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, VkDeviceSize budget, uint32_t framesInFlight) {
+		mDevice = device;
+		mCommandPool = commandPool;
+		mBudget = budget;
+		mFramesInFlight = framesInFlight;
+	}
+
+	TextureStreamer::~TextureStreamer() {
+		ReleaseRetired(true);
+	}
+
+	uint32_t TextureStreamer::Add(const std::string& imageFilePath) {
+		Entry entry{};
+		entry.mPath = imageFilePath;
+		entry.mFromFile = TextureFile::IsContainerFile(imageFilePath);
+		entry.mData = entry.mFromFile
+			? TextureFile::LoadHeader(imageFilePath)
+			: Texture::DecodeFile(imageFilePath, true);
+
+		const uint32_t levelCount = static_cast<uint32_t>(entry.mData.mLevels.size());
+		entry.mStartupLevel = levelCount - 1;
+		for (uint32_t i = 0; i < levelCount; ++i) {
+			const auto& level = entry.mData.mLevels[i];
+			if (std::max(level.mWidth, level.mHeight) <= STARTUP_MAX_SIZE) {
+				entry.mStartupLevel = i;
+				break;
+			}
+		}
+		entry.mRequestedLevel = entry.mStartupLevel;
+		entry.mLastUsedFrame = mFrame;
+
+		// 启动级别同步上传，保证返回后立刻能用
+		Retired retired{};
+		auto commandBuffer = Wrapper::CommandBuffer::Create(mDevice, mCommandPool);
+		commandBuffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		MakeResident(entry, entry.mStartupLevel, commandBuffer, retired);
+		commandBuffer->End();
+		commandBuffer->SubmitSync(mDevice->GetGraphicQueue());
+
+		mEntries.push_back(std::move(entry));
+		return static_cast<uint32_t>(mEntries.size() - 1);
+	}
+
+	float TextureStreamer::CalculateScreenSize(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& center, float radius, uint32_t viewportHeight) {
+		glm::vec4 viewPos = view * glm::vec4(center, 1.0f);
+		float distance = std::max(-viewPos.z, 0.0001f);
+		// projection[1][1] = 1 / tan(fovY / 2)
+		return radius * std::abs(projection[1][1]) / distance * static_cast<float>(viewportHeight);
+	}
+
+	uint32_t TextureStreamer::CalculateLevelForScreenSize(const Entry& entry, float screenPixels) const {
+		const uint32_t maxLevel = static_cast<uint32_t>(entry.mData.mLevels.size()) - 1;
+		if (screenPixels <= 1.0f) {
+			return std::min(entry.mStartupLevel, maxLevel);
+		}
+		float texels = static_cast<float>(std::max(entry.mData.mWidth, entry.mData.mHeight));
+		float level = std::floor(std::log2(std::max(texels / screenPixels, 1.0f)));
+		return std::min(static_cast<uint32_t>(level), maxLevel);
+	}
+
+	void TextureStreamer::RequestScreenSize(uint32_t handle, float screenPixels) {
+		auto& entry = mEntries[handle];
+		uint32_t level = CalculateLevelForScreenSize(entry, screenPixels);
+		// 同一帧里取最精细的需求
+		if (entry.mLastUsedFrame != mFrame) {
+			entry.mRequestedLevel = level;
+		}
+		else {
+			entry.mRequestedLevel = std::min(entry.mRequestedLevel, level);
+		}
+		entry.mLastUsedFrame = mFrame;
+	}
+
+	VkDeviceSize TextureStreamer::CalculateResidentBytes(const Entry& entry, uint32_t level) const {
+		VkDeviceSize bytes = 0;
+		for (uint32_t i = level; i < entry.mData.mLevels.size(); ++i) {
+			bytes += entry.mData.mLevels[i].mSize;
+		}
+		return bytes;
+	}
+
+	VkDeviceSize TextureStreamer::CalculateEffectiveBudget() const {
+		if (!mDevice->IsMemoryBudgetSupported()) {
+			return mBudget;
+		}
+		// 驱动给的已用量里包含了我们自己的纹理，其它部分用掉的才是真正的占用
+		auto memory = mDevice->QueryMemoryBudget();
+		VkDeviceSize others = memory.m_Usage > mStats.mResidentBytes ? memory.m_Usage - mStats.mResidentBytes : 0;
+		VkDeviceSize available = memory.m_Budget > others ? memory.m_Budget - others : 0;
+		return std::min(mBudget, available);
+	}
+
+	// 新建一张只包含[level, 最后一级]的image，从文件或内存上传，录制进commandBuffer
+	// 纹理立刻切换到新image：同一队列上后提交的帧会被这里的barrier挡住，不会读到未完成的拷贝
+	void TextureStreamer::MakeResident(Entry& entry, uint32_t level, const Wrapper::CommandBuffer::Ptr& commandBuffer, Retired& retired) {
+		const auto& data = entry.mData;
+		const auto& baseLevel = data.mLevels[level];
+		const uint32_t levelCount = static_cast<uint32_t>(data.mLevels.size()) - level;
+
+		auto image = Wrapper::Image::Create(
+			mDevice, baseLevel.mWidth, baseLevel.mHeight,
+			data.mFormat,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			levelCount,
+			Wrapper::MemoryCategory::Texture
+		);
+
+		// 各级紧密排列，从baseLevel开始整段拷进stagingBuffer
+		const VkDeviceSize uploadBytes = CalculateResidentBytes(entry, level);
+		std::vector<TextureFileLevel> levels{};
+		Wrapper::Buffer::Ptr stageBuffer{ nullptr };
+		if (entry.mFromFile) {
+			std::vector<uint8_t> fileData{};
+			TextureFile::ReadLevels(entry.mPath, data, level, fileData, levels);
+			stageBuffer = Wrapper::Buffer::CreateStageBuffer(mDevice, fileData.size(), fileData.data());
+			mStats.mReadBytes += fileData.size();
+		}
+		else {
+			const size_t dataOffset = baseLevel.mOffset;
+			levels.assign(data.mLevels.begin() + level, data.mLevels.end());
+			for (auto& copyLevel : levels) {
+				copyLevel.mOffset -= dataOffset;
+			}
+			stageBuffer = Wrapper::Buffer::CreateStageBuffer(mDevice, uploadBytes, const_cast<uint8_t*>(data.mData.data() + dataOffset));
+		}
+
+		VkImageSubresourceRange region{};
+		region.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.baseMipLevel = 0;
+		region.levelCount = levelCount;
+		region.baseArrayLayer = 0;
+		region.layerCount = 1;
+
+		auto barrier = image->MakeLayoutBarrier(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, region);
+		commandBuffer->TransferImageLayout(barrier, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		image->CopyFromBuffer(commandBuffer, stageBuffer->getBuffer(), TextureFile::GetCopyRegions(levels));
+
+		barrier = image->MakeLayoutBarrier(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, region);
+		commandBuffer->TransferImageLayout(barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+		if (entry.mTexture == nullptr) {
+			entry.mTexture = Texture::create(mDevice, image);
+		}
+		else {
+			auto oldImage = entry.mTexture->GetImage();
+			const VkImageView oldView = oldImage->GetImageView();
+			retired.mImages.push_back(oldImage);
+			entry.mTexture->SetImage(image);
+			if (mOnImageChanged) {
+				mOnImageChanged(entry.mTexture, oldView);
+			}
+		}
+		retired.mStageBuffers.push_back(stageBuffer);
+
+		mStats.mResidentBytes -= entry.mResidentBytes;
+		entry.mResidentBytes = uploadBytes;
+		entry.mResidentLevel = level;
+		mStats.mResidentBytes += entry.mResidentBytes;
+		mStats.mUploadedBytes += uploadBytes;
+	}
+
+	// 本帧的反馈都已经通过RequestScreenSize记在mFrame上，处理完再进入下一帧
+	void TextureStreamer::Update() {
+		ReleaseRetired(false);
+		StreamLevels();
+		mFrame++;
+	}
+
+	void TextureStreamer::StreamLevels() {
+		mStats.mUploadedBytes = 0;
+		mStats.mReadBytes = 0;
+		mStats.mUpgradeCount = 0;
+		mStats.mEvictCount = 0;
+		mStats.mTextureCount = mEntries.size();
+		mStats.mBudgetBytes = CalculateEffectiveBudget();
+
+		// 需要更精细mip的纹理，差得越多越优先，其次是最近用过的
+		std::vector<uint32_t> upgrades{};
+		for (uint32_t i = 0; i < mEntries.size(); ++i) {
+			if (mEntries[i].mRequestedLevel < mEntries[i].mResidentLevel) {
+				upgrades.push_back(i);
+			}
+		}
+		if (upgrades.empty()) {
+			return;
+		}
+		std::sort(upgrades.begin(), upgrades.end(), [this](uint32_t a, uint32_t b) {
+			const auto& ea = mEntries[a];
+			const auto& eb = mEntries[b];
+			uint32_t gapA = ea.mResidentLevel - ea.mRequestedLevel;
+			uint32_t gapB = eb.mResidentLevel - eb.mRequestedLevel;
+			return gapA != gapB ? gapA > gapB : ea.mLastUsedFrame > eb.mLastUsedFrame;
+		});
+
+		// 降级的候选，最久没用的排在前面
+		std::vector<uint32_t> lru(mEntries.size());
+		for (uint32_t i = 0; i < lru.size(); ++i) {
+			lru[i] = i;
+		}
+		std::sort(lru.begin(), lru.end(), [this](uint32_t a, uint32_t b) {
+			return mEntries[a].mLastUsedFrame < mEntries[b].mLastUsedFrame;
+		});
+
+		Retired retired{};
+		retired.mFrame = mFrame;
+		retired.mCommandBuffer = Wrapper::CommandBuffer::Create(mDevice, mCommandPool);
+		retired.mCommandBuffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+		for (auto index : upgrades) {
+			auto& entry = mEntries[index];
+			VkDeviceSize newBytes = CalculateResidentBytes(entry, entry.mRequestedLevel);
+			VkDeviceSize growth = newBytes - entry.mResidentBytes;
+
+			// 每帧上传量有上限，避免一帧卡太久；但至少处理一张
+			if (mStats.mUploadedBytes > 0 && mStats.mUploadedBytes + newBytes > mMaxUploadBytesPerFrame) {
+				break;
+			}
+
+			// 超预算时从最久没用的纹理开始降级，腾出空间
+			for (auto victimIndex : lru) {
+				if (mStats.mResidentBytes + growth <= mStats.mBudgetBytes) {
+					break;
+				}
+				auto& victim = mEntries[victimIndex];
+				if (victimIndex == index || victim.mLastUsedFrame == mFrame) {
+					continue;
+				}
+				uint32_t target = mFrame - victim.mLastUsedFrame > STALE_FRAMES
+					? victim.mStartupLevel
+					: std::max(victim.mRequestedLevel, victim.mResidentLevel + 1);
+				target = std::min(target, static_cast<uint32_t>(victim.mData.mLevels.size()) - 1);
+				if (target <= victim.mResidentLevel) {
+					continue;
+				}
+				MakeResident(victim, target, retired.mCommandBuffer, retired);
+				mStats.mEvictCount++;
+			}
+
+			if (mStats.mResidentBytes + growth > mStats.mBudgetBytes) {
+				continue;
+			}
+			MakeResident(entry, entry.mRequestedLevel, retired.mCommandBuffer, retired);
+			mStats.mUpgradeCount++;
+		}
+
+		retired.mCommandBuffer->End();
+		if (mStats.mUpgradeCount == 0 && mStats.mEvictCount == 0) {
+			return;
+		}
+
+		retired.mFence = Wrapper::Fence::Create(mDevice, false);
+		retired.mCommandBuffer->Submit(mDevice->GetGraphicQueue(), retired.mFence->GetFence());
+		mRetired.push_back(std::move(retired));
+	}
+
+	// 旧image可能还被之前提交、尚未结束的帧引用，等够mFramesInFlight帧再释放
+	void TextureStreamer::ReleaseRetired(bool wait) {
+		while (!mRetired.empty()) {
+			auto& retired = mRetired.front();
+			if (wait) {
+				retired.mFence->Block();
+			}
+			else if (mFrame < retired.mFrame + mFramesInFlight ||
+				vkGetFenceStatus(mDevice->GetDevice(), retired.mFence->GetFence()) != VK_SUCCESS) {
+				break;
+			}
+			mRetired.pop_front();
+		}
+	}
+
+}
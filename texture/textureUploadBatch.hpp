@@ -0,0 +1,170 @@
+#pragma once
+#include "../base.h"
+#include "../VulkanWrapper/buffer.hpp"
+#include "../VulkanWrapper/commandBuffer.hpp"
+#include "../VulkanWrapper/commandPool.hpp"
+#include "../VulkanWrapper/device.hpp"
+#include "../VulkanWrapper/image.hpp"
+#include "../VulkanWrapper/resourceStateTracker.hpp"
+#include "texture.hpp"
+#include "textureFile.hpp"
+#include <atomic>
+#include <exception>
+#include <thread>
+
+namespace VK {
+
+	// 把多张纹理的上传录制进同一个commandBuffer
+	// 所有image的布局转换合成两次vkCmdPipelineBarrier(转TRANSFER_DST、转SHADER_READ_ONLY)，中间是各自的拷贝
+	// N张纹理只需要一次提交，而不是每张纹理3次同步提交
+	class TextureUploadBatch {
+	private:
+		struct Upload {
+			Wrapper::Image::Ptr mImage{ nullptr };
+			Wrapper::Buffer::Ptr mStageBuffer{ nullptr };
+			std::vector<VkBufferImageCopy> mRegions{};
+		};
+
+		Wrapper::Device::Ptr mDevice{ nullptr };
+		std::vector<Upload> mUploads{};
+
+	public:
+		using Ptr = std::shared_ptr<TextureUploadBatch>;
+		static Ptr create(const Wrapper::Device::Ptr& device) {
+			return std::make_shared<TextureUploadBatch>(device);
+		}
+
+		TextureUploadBatch(const Wrapper::Device::Ptr& device) { mDevice = device; }
+
+		~TextureUploadBatch() = default;
+
+		// stagingBuffer已经写好(比如在工作线程里)，各级按levels里的偏移排列
+		Wrapper::Image::Ptr Add(VkFormat format, uint32_t width, uint32_t height,
+			const std::vector<TextureFileLevel>& levels, const Wrapper::Buffer::Ptr& stageBuffer);
+
+		Wrapper::Image::Ptr Add(const TextureFileData& data);
+
+		// 录制所有barrier和拷贝，stagingBuffer要保留到commandBuffer执行完
+		void Record(const Wrapper::CommandBuffer::Ptr& commandBuffer);
+
+		[[nodiscard]] auto GetCount() const { return mUploads.size(); }
+		[[nodiscard]] bool IsEmpty() const { return mUploads.empty(); }
+
+		// 同步加载一组纹理：多线程解码(线程数不超过cpu核数)，所有上传一次提交
+		static std::vector<Texture::Ptr> LoadTextures(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool,
+			const std::vector<std::string>& imageFilePaths);
+	};
+
+	Wrapper::Image::Ptr TextureUploadBatch::Add(VkFormat format, uint32_t width, uint32_t height,
+		const std::vector<TextureFileLevel>& levels, const Wrapper::Buffer::Ptr& stageBuffer) {
+		Upload upload{};
+		upload.mImage = Wrapper::Image::Create(
+			mDevice, width, height,
+			format,
+			VK_IMAGE_TYPE_2D,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			static_cast<uint32_t>(levels.size()),
+			Wrapper::MemoryCategory::Texture
+		);
+		upload.mStageBuffer = stageBuffer;
+		upload.mRegions = TextureFile::GetCopyRegions(levels);
+
+		mUploads.push_back(upload);
+		return upload.mImage;
+	}
+
+	Wrapper::Image::Ptr TextureUploadBatch::Add(const TextureFileData& data) {
+		auto stageBuffer = Wrapper::Buffer::CreateStageBuffer(mDevice, data.mData.size(), const_cast<uint8_t*>(data.mData.data()));
+		return Add(data.mFormat, data.mWidth, data.mHeight, data.mLevels, stageBuffer);
+	}
+
+	void TextureUploadBatch::Record(const Wrapper::CommandBuffer::Ptr& commandBuffer) {
+		// 新建的image都是UNDEFINED，tracker把转换合并成一次barrier
+		Wrapper::ResourceStateTracker tracker{};
+		for (auto& upload : mUploads) {
+			tracker.Transition(upload.mImage, Wrapper::ResourceUsage::TransferDst);
+		}
+		tracker.Flush(commandBuffer);
+
+		for (auto& upload : mUploads) {
+			upload.mImage->CopyFromBuffer(commandBuffer, upload.mStageBuffer->getBuffer(), upload.mRegions);
+			commandBuffer->AddUploadedBytes(upload.mStageBuffer->GetSize());
+		}
+
+		for (auto& upload : mUploads) {
+			tracker.Transition(upload.mImage, Wrapper::ResourceUsage::FragmentShaderRead);
+		}
+		tracker.Flush(commandBuffer);
+	}
+
+	std::vector<Texture::Ptr> TextureUploadBatch::LoadTextures(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool,
+		const std::vector<std::string>& imageFilePaths) {
+		// 解码和mip生成是纯cpu工作，每个线程依次领下一个文件，调用线程自己也领
+		// 解码完立刻写进stagingBuffer并丢掉像素，内存里不会同时留着所有文件的mip链
+		struct Decoded {
+			VkFormat mFormat{ VK_FORMAT_UNDEFINED };
+			uint32_t mWidth{ 0 };
+			uint32_t mHeight{ 0 };
+			std::vector<TextureFileLevel> mLevels{};
+			Wrapper::Buffer::Ptr mStageBuffer{ nullptr };
+			std::exception_ptr mError{};
+		};
+		std::vector<Decoded> decoded(imageFilePaths.size());
+		std::atomic<size_t> next{ 0 };
+		auto decode = [&]() {
+			for (size_t i = next++; i < decoded.size(); i = next++) {
+				auto& result = decoded[i];
+				try {
+					auto data = Texture::DecodeFile(imageFilePaths[i], true);
+					if (!device->IsFormatSupported(data.mFormat, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT)) {
+						throw std::runtime_error("Error: texture format is not supported by device " + imageFilePaths[i]);
+					}
+					result.mFormat = data.mFormat;
+					result.mWidth = data.mWidth;
+					result.mHeight = data.mHeight;
+					result.mLevels = std::move(data.mLevels);
+					result.mStageBuffer = Wrapper::Buffer::CreateStageBuffer(device, data.mData.size(), data.mData.data());
+				}
+				catch (...) {
+					result.mError = std::current_exception();
+				}
+			}
+		};
+
+		const size_t threadCount = std::min<size_t>(decoded.size(), std::max(1u, std::thread::hardware_concurrency()));
+		std::vector<std::thread> workers{};
+		for (size_t i = 1; i < threadCount; ++i) {
+			workers.emplace_back(decode);
+		}
+		decode();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+
+		auto batch = TextureUploadBatch::create(device);
+		std::vector<Wrapper::Image::Ptr> images{};
+		for (auto& result : decoded) {
+			if (result.mError) {
+				std::rethrow_exception(result.mError);
+			}
+			images.push_back(batch->Add(result.mFormat, result.mWidth, result.mHeight, result.mLevels, result.mStageBuffer));
+		}
+
+		auto commandBuffer = Wrapper::CommandBuffer::Create(device, commandPool);
+		commandBuffer->Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		batch->Record(commandBuffer);
+		commandBuffer->End();
+		commandBuffer->SubmitSync(device->GetGraphicQueue());
+
+		std::vector<Texture::Ptr> textures{};
+		for (auto& image : images) {
+			textures.push_back(Texture::create(device, image));
+		}
+		return textures;
+	}
+
+}
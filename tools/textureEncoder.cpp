@@ -0,0 +1,98 @@
+// 离线纹理转换：png/jpg -> 带完整mip链的BC压缩ktx2
+// 用法: textureEncoder <输入图片> <输出.ktx2> [bc1|bc3|bc5] [--linear]
+// 颜色贴图默认按srgb编码，法线/粗糙度等数据贴图加 --linear
+#include "../texture/blockCompressor.hpp"
+#include "../texture/mipmapGenerator.hpp"
+#include "../texture/textureFile.hpp"
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+using namespace VK;
+
+static VkFormat SelectFormat(const std::string &name, bool linear) {
+  if (name == "bc1") {
+    return linear ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+  }
+  if (name == "bc3") {
+    return linear ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC3_SRGB_BLOCK;
+  }
+  if (name == "bc5") {
+    return VK_FORMAT_BC5_UNORM_BLOCK;
+  }
+  throw std::runtime_error("Error: unknown output format " + name);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cout << "usage: textureEncoder <input> <output.ktx2> [bc1|bc3|bc5] "
+                 "[--linear]"
+              << std::endl;
+    return 1;
+  }
+
+  std::string input = argv[1];
+  std::string output = argv[2];
+  std::string formatName = "bc1";
+  bool linear = false;
+  for (int i = 3; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--linear") {
+      linear = true;
+    } else {
+      formatName = arg;
+    }
+  }
+
+  try {
+    VkFormat format = SelectFormat(formatName, linear);
+
+    int width, height, channels;
+    stbi_uc *pixels =
+        stbi_load(input.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels) {
+      throw std::runtime_error("Error: failed to read image data " + input);
+    }
+
+    // mip在压缩前生成，srgb数据在线性空间里平均
+    bool srgb = TextureFile::IsSrgbFormat(format);
+    auto levels = MipmapGenerator::Generate(pixels, width, height, srgb);
+
+    TextureFileData data{};
+    data.mFormat = format;
+    data.mWidth = static_cast<uint32_t>(width);
+    data.mHeight = static_cast<uint32_t>(height);
+
+    auto appendLevel = [&data, format](const uint8_t *levelPixels, uint32_t w,
+                                       uint32_t h) {
+      auto blocks = BlockCompressor::Compress(format, levelPixels, w, h);
+      TextureFileLevel level{};
+      level.mWidth = w;
+      level.mHeight = h;
+      level.mOffset = data.mData.size();
+      level.mSize = blocks.size();
+      data.mData.insert(data.mData.end(), blocks.begin(), blocks.end());
+      data.mLevels.push_back(level);
+    };
+
+    appendLevel(pixels, data.mWidth, data.mHeight);
+    for (const auto &level : levels) {
+      appendLevel(level.mPixels.data(), level.mWidth, level.mHeight);
+    }
+    stbi_image_free(pixels);
+
+    TextureFile::WriteKTX2(output, data);
+
+    size_t sourceSize = 0;
+    sourceSize += static_cast<size_t>(width) * height * 4;
+    for (const auto &level : levels) {
+      sourceSize += level.mPixels.size();
+    }
+    std::cout << input << " -> " << output << " (" << formatName << ", "
+              << data.mLevels.size() << " levels, " << sourceSize << " -> "
+              << data.mData.size() << " bytes)" << std::endl;
+  } catch (const std::exception &e) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
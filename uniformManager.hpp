@@ -1,9 +1,10 @@
 #pragma once
 #include "VulkanWrapper/description.h"
-#include "VulkanWrapper/descriptorPool.hpp"
 #include "VulkanWrapper/descriptorSet.hpp"
+#include "VulkanWrapper/descriptorSetCache.hpp"
 #include "VulkanWrapper/descriptorSetLayout.hpp"
 #include "VulkanWrapper/device.hpp"
+#include "VulkanWrapper/frameAllocator.hpp"
 #include "base.h"
 
 namespace VK::Wrapper {
@@ -13,9 +14,17 @@ namespace VK::Wrapper {
 		std::vector<Wrapper::UniformParameter::Ptr> m_UniformParams;
 
 		Wrapper::DescriptorSetLayout::Ptr m_DescriptorSetLayout{ nullptr };
-		Wrapper::DescriptorPool::Ptr m_DescriptorPool{ nullptr };
+		Wrapper::DescriptorSetCache::Ptr m_DescriptorSetCache{ nullptr };
 		Wrapper::DescriptorSet::Ptr m_DescriptorSet{ nullptr };
 		Wrapper::Device::Ptr m_Device{ nullptr };
+		Wrapper::FrameAllocator::Ptr m_FrameAllocator{ nullptr };
+		int m_FrameCount{ 0 };
+		// 按binding顺序排列的dynamic offset，每帧Update时填写
+		std::vector<uint32_t> m_DynamicOffsets{};
+		// 材质的纹理参数和它在descriptor数据里的槽位(前面所有参数的mCount之和)，以及查询缓存用的临时数据
+		Wrapper::UniformParameter::Ptr m_TextureParam{ nullptr };
+		size_t m_TextureSlot{ 0 };
+		std::vector<Wrapper::DescriptorData> m_MaterialData{};
 
 	public:
 		using Ptr = std::shared_ptr<UniformManager>;
@@ -24,10 +33,11 @@ namespace VK::Wrapper {
 		UniformManager() = default;
 
 		~UniformManager() = default;
-		void Init(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, int frameCount);
+		// texture是材质默认的纹理，路径由调用方决定
+		void Init(const Wrapper::Device::Ptr& device, const Wrapper::FrameAllocator::Ptr& frameAllocator,
+			int frameCount, const Texture::Ptr& texture);
 
-		void Update(const VPMatrices& vpMatrices, const ObjectUniform& objectUniform,
-			const int& frameCount);
+		void Update(const VPMatrices& vpMatrices, const ObjectUniform& objectUniform);
 		[[nodiscard]] auto& GetDescriptorLayout() const {
 			return m_DescriptorSetLayout;
 		}
@@ -35,21 +45,46 @@ namespace VK::Wrapper {
 		[[nodiscard]] auto GetDescriptorSet(int frameCount) const {
 			return m_DescriptorSet->GetDescriptorSet(frameCount);
 		}
+
+		// 使用同一张纹理的材质共享同一个descriptorSet
+		// 纹理换了image之后要重新取，旧的set里还是原来的imageView
+		VkDescriptorSet GetDescriptorSet(const Texture::Ptr& texture);
+
+		// 默认纹理换了image之后调用，按新的imageView重新取每帧的set
+		// 旧的set不回收，正在执行的帧可以继续用
+		void RefreshDescriptorSets();
+
+		[[nodiscard]] auto& GetTexture() const {
+			return m_TextureParam->mTexture;
+		}
+
+		[[nodiscard]] auto& GetDescriptorSetCache() const {
+			return m_DescriptorSetCache;
+		}
+
+		[[nodiscard]] auto& GetDynamicOffsets() const {
+			return m_DynamicOffsets;
+		}
 	};
 
-	void UniformManager::Init(const Wrapper::Device::Ptr& device, const Wrapper::CommandPool::Ptr& commandPool, int frameCount) {
+	void UniformManager::Init(const Wrapper::Device::Ptr& device, const Wrapper::FrameAllocator::Ptr& frameAllocator,
+		int frameCount, const Texture::Ptr& texture) {
+		if (texture == nullptr) {
+			throw std::runtime_error("Error: uniform manager needs a default texture");
+		}
 		m_Device = device;
+		m_FrameAllocator = frameAllocator;
+		m_FrameCount = frameCount;
+		// uniform数据每帧从frameAllocator里切出来，descriptor只指向那块大buffer
 		auto vpParam = Wrapper::UniformParameter::create();
 		vpParam->mBinding = 0;
 		vpParam->mCount = 1;
-		vpParam->mDescriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		vpParam->mDescriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		vpParam->mSize = sizeof(VPMatrices);
 		vpParam->mStage = VK_SHADER_STAGE_VERTEX_BIT;
 
 		for (int i = 0; i < frameCount; ++i) {
-			auto buffer =
-				Wrapper::Buffer::CreateUniformBuffer(device, vpParam->mSize, nullptr);
-			vpParam->m_Buffers.push_back(buffer);
+			vpParam->m_Buffers.push_back(m_FrameAllocator->GetBuffer());
 		}
 
 		m_UniformParams.push_back(vpParam);
@@ -57,25 +92,29 @@ namespace VK::Wrapper {
 		auto objectParam = Wrapper::UniformParameter::create();
 		objectParam->mBinding = 1;
 		objectParam->mCount = 1;
-		objectParam->mDescriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		objectParam->mDescriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		objectParam->mSize = sizeof(ObjectUniform);
 		objectParam->mStage = VK_SHADER_STAGE_VERTEX_BIT;
 
 		for (int i = 0; i < frameCount; ++i) {
-			auto buffer = Wrapper::Buffer::CreateUniformBuffer(
-				device, objectParam->mSize, nullptr);
-			objectParam->m_Buffers.push_back(buffer);
+			objectParam->m_Buffers.push_back(m_FrameAllocator->GetBuffer());
 		}
 
 		m_UniformParams.push_back(objectParam);
+		m_DynamicOffsets.resize(2, 0);
 
 		auto textureParam = Wrapper::UniformParameter::create();
 		textureParam->mBinding = 2;
 		textureParam->mCount = 1;
 		textureParam->mDescriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		textureParam->mStage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		textureParam->mTexture = Texture::create(m_Device, commandPool, "D:\\cpp\\vk\\assets\\jqm.png");
+		textureParam->mTexture = texture;
 
+		m_TextureSlot = 0;
+		for (const auto& param : m_UniformParams) {
+			m_TextureSlot += param->mCount;
+		}
+		m_TextureParam = textureParam;
 		m_UniformParams.push_back(textureParam);
 
 
@@ -84,22 +123,33 @@ namespace VK::Wrapper {
 		m_DescriptorSetLayout->Build(m_UniformParams);
 
 
-		m_DescriptorPool = Wrapper::DescriptorPool::Create(device);
-		m_DescriptorPool->Build(m_UniformParams, frameCount);
+		m_DescriptorSetCache = Wrapper::DescriptorSetCache::Create(device);
+
+		RefreshDescriptorSets();
+	}
 
+	void UniformManager::RefreshDescriptorSets() {
 		m_DescriptorSet = Wrapper::DescriptorSet::Create(
-			device, m_UniformParams, m_DescriptorSetLayout, m_DescriptorPool,
-			frameCount);
+			m_Device, m_UniformParams, m_DescriptorSetLayout, m_DescriptorSetCache,
+			m_FrameCount);
+	}
+
+	VkDescriptorSet UniformManager::GetDescriptorSet(const Texture::Ptr& texture) {
+		// uniform部分每帧都指向同一块frameAllocator，所以用第0帧的数据即可
+		Wrapper::BuildDescriptorData(m_UniformParams, 0, m_MaterialData);
+		m_MaterialData[m_TextureSlot].m_ImageInfo = texture->GetImageInfo();
+
+		return m_DescriptorSetCache->GetOrCreate(m_DescriptorSetLayout, m_MaterialData);
 	}
 
 	void UniformManager::Update(const VPMatrices& vpMatrices,
-		const ObjectUniform& objectUniform,
-		const int& frameCount) {
-		m_UniformParams[0]->m_Buffers[frameCount]->UpdateBufferByMap(
-			(void*)(&vpMatrices), sizeof(VPMatrices));
+		const ObjectUniform& objectUniform) {
+		// frameAllocator已经在该帧的fence之后BeginFrame过，这里只是顺序写入
+		m_DynamicOffsets[0] = static_cast<uint32_t>(
+			m_FrameAllocator->Push(vpMatrices).m_Offset);
 
 		// update object uniform
-		m_UniformParams[1]->m_Buffers[frameCount]->UpdateBufferByMap(
-			(void*)(&objectUniform), sizeof(ObjectUniform));
+		m_DynamicOffsets[1] = static_cast<uint32_t>(
+			m_FrameAllocator->Push(objectUniform).m_Offset);
 	}
 } // namespace VK::Wrapper
\ No newline at end of file